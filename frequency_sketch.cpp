@@ -0,0 +1,112 @@
+#include "frequency_sketch.hpp"
+
+#include <algorithm>
+
+namespace {
+
+constexpr std::uint64_t kSeeds[4] = {0xc3a5c85c97cb3127ull,
+                                     0xb492b66fbe98f273ull,
+                                     0x9ae16a3b2f90404full,
+                                     0xcbf29ce484222325ull};
+
+/** Capacity beyond which the sketch stops growing, 32 MiB of counters. */
+constexpr int kMaxCapacity = 1 << 22;
+
+/** Add two words of 4-bit counters, saturating each counter at 15. */
+std::uint64_t addSaturating(std::uint64_t a, std::uint64_t b) {
+  constexpr std::uint64_t kLowBits = 0x7777777777777777ull;
+  constexpr std::uint64_t kHighBits = 0x8888888888888888ull;
+  // The low three bits of two counters add up without carrying out of the
+  // counter, and the high bit of the sum follows from it
+  auto low = (a & kLowBits) + (b & kLowBits);
+  auto sum = low ^ ((a ^ b) & kHighBits);
+  auto overflow = ((a & b) | ((a | b) & low)) & kHighBits;
+  return sum | ((overflow >> 3) * 0xf);
+}
+
+/** Mix the bits of a page ID, so consecutive page IDs use unrelated counters. */
+std::uint32_t spread(unsigned pageId) {
+  std::uint32_t hash = pageId;
+  hash = ((hash >> 16) ^ hash) * 0x45d9f3bu;
+  hash = ((hash >> 16) ^ hash) * 0x45d9f3bu;
+  return (hash >> 16) ^ hash;
+}
+
+} // namespace
+
+FrequencySketch::FrequencySketch(int capacity)
+    : mask_(0), numSamples_(0), sampleLimit_(0) {
+  resize(capacity);
+}
+
+void FrequencySketch::resize(int capacity) {
+  capacity = std::min(std::max(capacity, 16), kMaxCapacity);
+  sampleLimit_ = 10 * capacity;
+  std::size_t numWords = 1;
+  while (numWords < (std::size_t)capacity) {
+    numWords *= 2;
+  }
+  if (numWords == table_.size()) {
+    return;
+  }
+  // A page's word is its hash masked to the size of the table, and its
+  // counters sit at the same place in the word whatever the size
+  auto numOldWords = table_.size();
+  if (numWords > numOldWords) {
+    table_.resize(numWords);
+    for (auto i = numOldWords; i < numWords && numOldWords != 0; ++i) {
+      table_[i] = table_[i & (numOldWords - 1)];
+    }
+  }
+  else {
+    for (auto i = numWords; i < numOldWords; ++i) {
+      table_[i & (numWords - 1)] =
+          addSaturating(table_[i & (numWords - 1)], table_[i]);
+    }
+    table_.resize(numWords);
+    table_.shrink_to_fit();
+  }
+  mask_ = numWords - 1;
+}
+
+void FrequencySketch::increment(unsigned pageId) {
+  // Each row picks a word, and the low two bits of the hash pick which four
+  // of the word's counters the rows use. Saturated counters are left alone
+  // without a branch.
+  auto hash = spread(pageId);
+  auto start = (hash & 3) << 2;
+  for (int row = 0; row < 4; ++row) {
+    auto &word = table_[indexOf(hash, row)];
+    auto offset = (start + row) << 2;
+    std::uint64_t notSaturated = ((word >> offset) & 0xf) != 0xf;
+    word += notSaturated << offset;
+  }
+  if (++numSamples_ >= sampleLimit_) {
+    age();
+  }
+}
+
+unsigned FrequencySketch::frequency(unsigned pageId) const {
+  auto hash = spread(pageId);
+  auto start = (hash & 3) << 2;
+  unsigned estimate = 0xf;
+  for (int row = 0; row < 4; ++row) {
+    auto offset = (start + row) << 2;
+    estimate = std::min(
+        estimate, (unsigned)(table_[indexOf(hash, row)] >> offset) & 0xf);
+  }
+  return estimate;
+}
+
+void FrequencySketch::age() {
+  for (auto &word : table_) {
+    word = (word >> 1) & 0x7777777777777777ull;
+  }
+  numSamples_ /= 2;
+}
+
+std::size_t FrequencySketch::indexOf(std::uint32_t hash, int row) const {
+  auto mixed = (hash + kSeeds[row]) * kSeeds[row];
+  mixed += mixed >> 32;
+  return (std::size_t)mixed & mask_;
+}
@@ -0,0 +1,64 @@
+#ifndef FREQUENCY_SKETCH_HPP
+#define FREQUENCY_SKETCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Count-min sketch of page access frequencies with 4-bit saturating counters,
+ * sixteen to a 64-bit word. Each page ID maps to four counters in four words,
+ * and its estimate is the smallest of them. Once the number of recorded
+ * accesses reaches ten times the capacity, every counter is halved, so old
+ * popularity fades. Memory depends only on the capacity: one word per page of
+ * capacity, rounded up to a power of two.
+ */
+class FrequencySketch {
+public:
+  /**
+   * Construct a FrequencySketch.
+   * @param capacity Number of pages the estimates should cover.
+   */
+  explicit FrequencySketch(int capacity);
+
+  /**
+   * Size the sketch for a new capacity, keeping the frequencies seen so far.
+   * The table only changes when its power-of-two number of words does: a
+   * larger table repeats the words of the old one, and a smaller one adds up
+   * the counters that come to share a word, saturating, as a count-min sketch
+   * of that size would have counted them.
+   * @param capacity Number of pages the estimates should cover.
+   */
+  void resize(int capacity);
+
+  /**
+   * Record an access to a page.
+   * @param pageId Page ID.
+   */
+  void increment(unsigned pageId);
+
+  /**
+   * Estimate how often a page was accessed recently.
+   * @param pageId Page ID.
+   * @return Estimated frequency, at most 15.
+   */
+  [[nodiscard]] unsigned frequency(unsigned pageId) const;
+
+private:
+  /** Halve every counter. */
+  void age();
+
+  /** Index of the word that row `row` uses for a hash. */
+  [[nodiscard]] std::size_t indexOf(std::uint32_t hash, int row) const;
+
+  std::vector<std::uint64_t> table_;
+
+  std::size_t mask_;
+
+  /** Accesses recorded since the last aging. */
+  int numSamples_;
+
+  int sampleLimit_;
+};
+
+#endif
@@ -0,0 +1,175 @@
+#include "miss_ratio_curve.hpp"
+
+#include <algorithm>
+
+namespace {
+
+/** Hashes are taken modulo this, so the sampling rate is threshold / this. */
+constexpr std::uint32_t kModulus = 1u << 24;
+
+/** Sizes of the miss ratio curve, relative to the maximum number of pages. */
+constexpr double kCurveScales[] = {0.25, 0.5, 0.75, 1, 1.5, 2, 3, 4};
+
+/** Smallest Fenwick tree, in access times. */
+constexpr unsigned kMinTreeSize = 64;
+
+/**
+ * Hash a page ID. Differs from the mixing in `FrequencySketch`, so that the
+ * sampled pages are not also the ones whose counters collide.
+ */
+std::uint32_t hashPageId(unsigned pageId) {
+  std::uint64_t hash = pageId * 0x9e3779b97f4a7c15ull;
+  hash ^= hash >> 29;
+  hash *= 0xbf58476d1ce4e5b9ull;
+  hash ^= hash >> 32;
+  return (std::uint32_t)hash & (kModulus - 1);
+}
+
+} // namespace
+
+int ReuseDistanceHistogram::getBucket(unsigned long long distance) {
+  if (distance < 4) {
+    return (int)distance;
+  }
+  auto exponent = 63 - __builtin_clzll(distance);
+  auto quarter = (int)(distance >> (exponent - 2)) & 3;
+  return std::min(4 * (exponent - 1) + quarter, kNumBuckets - 1);
+}
+
+unsigned long long ReuseDistanceHistogram::getLowerBound(int bucket) {
+  if (bucket < 4) {
+    return (unsigned long long)bucket;
+  }
+  auto exponent = bucket / 4 + 1;
+  return (4ull + (unsigned long long)(bucket % 4)) << (exponent - 2);
+}
+
+double ReuseDistanceHistogram::estimateHitRatio(double numPages) const {
+  if (numAccesses == 0) {
+    return 0;
+  }
+  // Sampled accesses beyond or short of the expected are taken as hits
+  auto numHits = (double)numAccesses - (double)numSampledAccesses;
+  for (int bucket = 0; bucket < kNumBuckets; ++bucket) {
+    auto lowerBound = (double)getLowerBound(bucket);
+    auto upperBound = (double)getLowerBound(bucket + 1);
+    if (upperBound <= numPages) {
+      numHits += (double)counts[bucket];
+    }
+    else {
+      if (lowerBound < numPages) {
+        numHits += (double)counts[bucket] * (numPages - lowerBound) /
+                   (upperBound - lowerBound);
+      }
+      break;
+    }
+  }
+  return std::clamp(numHits / (double)numAccesses, 0.0, 1.0);
+}
+
+std::vector<MissRatioCurvePoint>
+ReuseDistanceHistogram::getMissRatioCurve(int maxNumPages,
+                                          std::size_t numBytesPerPage) const {
+  std::vector<MissRatioCurvePoint> curve;
+  if (numAccesses == 0 || maxNumPages <= 0) {
+    return curve;
+  }
+  for (auto scale : kCurveScales) {
+    auto numPages = std::max((int)(scale * maxNumPages + 0.5), 1);
+    curve.push_back({scale, numPages, (std::size_t)numPages * numBytesPerPage,
+                     estimateHitRatio(numPages)});
+  }
+  return curve;
+}
+
+ReuseDistanceSampler::ReuseDistanceSampler()
+    : tree_(kMinTreeSize + 1), nextTime_(0), threshold_(kModulus) {}
+
+bool ReuseDistanceSampler::sample(unsigned pageId,
+                                  unsigned long long &distance) {
+  auto hash = hashPageId(pageId);
+  if (hash >= threshold_) {
+    return false;
+  }
+  if (nextTime_ + 1 >= tree_.size()) {
+    compact();
+  }
+  auto time = nextTime_++;
+  auto sample = samples_.find(pageId);
+  if (sample != nullptr) {
+    // Sampled pages accessed after this one, scaled up by the sampling rate
+    auto numAfter = (unsigned long long)(samples_.size() -
+                                         countUpTo(sample->time));
+    distance = numAfter * kModulus / threshold_;
+    addToTree(sample->time, -1);
+    sample->time = time;
+    addToTree(time, 1);
+    return true;
+  }
+  distance = kNoDistance;
+  if (freeSamples_.empty()) {
+    sampleStorage_.push_back({});
+    sample = &sampleStorage_.back();
+  }
+  else {
+    sample = freeSamples_.back();
+    freeSamples_.pop_back();
+  }
+  *sample = {pageId, hash, time};
+  samples_.insert(pageId, sample);
+  hashes_.emplace(hash, pageId);
+  addToTree(time, 1);
+  if ((int)samples_.size() > kMaxNumSamples) {
+    lowerThreshold();
+  }
+  return true;
+}
+
+unsigned long long ReuseDistanceSampler::getWeight() const {
+  return ReuseDistanceHistogram::kAccessWeight * kModulus / threshold_;
+}
+
+void ReuseDistanceSampler::addToTree(unsigned time, int delta) {
+  for (auto index = time + 1; index < tree_.size(); index += index & -index) {
+    tree_[index] += delta;
+  }
+}
+
+unsigned ReuseDistanceSampler::countUpTo(unsigned time) const {
+  unsigned count = 0;
+  for (auto index = time + 1; index > 0; index -= index & -index) {
+    count += tree_[index];
+  }
+  return count;
+}
+
+void ReuseDistanceSampler::compact() {
+  std::vector<Sample *> bySampleTime;
+  bySampleTime.reserve(samples_.size());
+  samples_.forEach(
+      [&](unsigned, Sample *sample) { bySampleTime.push_back(sample); });
+  std::sort(bySampleTime.begin(), bySampleTime.end(),
+            [](const Sample *a, const Sample *b) { return a->time < b->time; });
+  // Keep at least half of the tree free for new access times
+  auto treeSize = kMinTreeSize;
+  while (treeSize < 2 * bySampleTime.size() + 2) {
+    treeSize *= 2;
+  }
+  tree_.assign(treeSize + 1, 0);
+  nextTime_ = 0;
+  for (auto sample : bySampleTime) {
+    sample->time = nextTime_++;
+    addToTree(sample->time, 1);
+  }
+}
+
+void ReuseDistanceSampler::lowerThreshold() {
+  threshold_ = hashes_.top().first;
+  while (!hashes_.empty() && hashes_.top().first >= threshold_) {
+    auto sample = samples_.find(hashes_.top().second);
+    hashes_.pop();
+    addToTree(sample->time, -1);
+    samples_.erase(sample->pageId);
+    freeSamples_.push_back(sample);
+  }
+}
@@ -0,0 +1,167 @@
+#ifndef MISS_RATIO_CURVE_HPP
+#define MISS_RATIO_CURVE_HPP
+
+#include "page_table.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <queue>
+#include <utility>
+#include <vector>
+
+/**
+ * One point of a miss ratio curve.
+ */
+struct MissRatioCurvePoint {
+  /** Size relative to the maximum number of pages. */
+  double scale;
+
+  /** Maximum number of pages of the cache. */
+  int numPages;
+
+  /** Memory the pages would take. */
+  std::size_t numBytes;
+
+  /** Estimated hit ratio, between 0 and 1. */
+  double hitRatio;
+};
+
+/**
+ * Reuse distances in quarter-octave buckets. A reuse distance is the number
+ * of distinct other pages accessed since the last access to a page, so an LRU
+ * cache of `n` pages hits exactly the accesses with a distance below `n`.
+ * Bucket `i` counts distances of at least `getLowerBound(i)` and less than
+ * `getLowerBound(i + 1)`. Every count is in units of `1 / kAccessWeight`
+ * accesses, so that a sampled access can stand for a fraction of the others.
+ */
+struct ReuseDistanceHistogram {
+  static constexpr int kNumBuckets = 124;
+
+  /** Weight of one access. */
+  static constexpr unsigned long long kAccessWeight = 256;
+
+  /**
+   * Get the bucket of a reuse distance.
+   * @param distance Reuse distance.
+   * @return Index of the bucket.
+   */
+  static int getBucket(unsigned long long distance);
+
+  /**
+   * Get the smallest reuse distance of a bucket.
+   * @param bucket Index of a bucket, up to `kNumBuckets`.
+   * @return Smallest reuse distance.
+   */
+  static unsigned long long getLowerBound(int bucket);
+
+  /**
+   * Estimate the hit ratio of an LRU cache, assuming the distances are spread
+   * evenly within each bucket. The accesses the sample over- or undercounts
+   * are taken as distance 0, the correction of SHARDS-adj, which offsets the
+   * weight of a hot page that happens to be sampled or not.
+   * @param numPages Maximum number of pages of the cache.
+   * @return Estimated hit ratio, or 0 if no access was counted.
+   */
+  [[nodiscard]] double estimateHitRatio(double numPages) const;
+
+  /**
+   * Estimate the hit ratios of LRU caches of 0.25 to 4 times a size.
+   * @param maxNumPages Maximum number of pages the curve is centred on.
+   * @param numBytesPerPage Memory a page takes.
+   * @return Points of the curve in order of size, or none if no access was
+   * counted.
+   */
+  [[nodiscard]] std::vector<MissRatioCurvePoint>
+  getMissRatioCurve(int maxNumPages, std::size_t numBytesPerPage) const;
+
+  /** Weighted sampled accesses with a reuse distance. */
+  unsigned long long counts[kNumBuckets] = {};
+
+  /** Weighted sampled accesses, with a reuse distance or not. */
+  unsigned long long numSampledAccesses = 0;
+
+  /** All accesses, sampled or not. */
+  unsigned long long numAccesses = 0;
+};
+
+/**
+ * Measures the reuse distances of a sample of page accesses with fixed-size
+ * SHARDS (Waldspurger et al., "Efficient MRC Construction with SHARDS"). A
+ * page is sampled if the hash of its page ID is below a threshold, so all
+ * accesses to a sampled page are seen, and a distance between sampled pages
+ * divided by the sampling rate estimates the full distance. The sampled pages
+ * are ordered by last access in a Fenwick tree over access times. Once more
+ * than `kMaxNumSamples` pages are sampled, the one with the largest hash is
+ * dropped and the threshold lowered to its hash, which bounds memory however
+ * many pages the database has.
+ */
+class ReuseDistanceSampler {
+public:
+  /** Largest number of sampled pages. */
+  static constexpr int kMaxNumSamples = 4096;
+
+  /** Distance of the first access to a page. */
+  static constexpr unsigned long long kNoDistance = ~0ull;
+
+  ReuseDistanceSampler();
+
+  ReuseDistanceSampler(const ReuseDistanceSampler &) = delete;
+  ReuseDistanceSampler &operator=(const ReuseDistanceSampler &) = delete;
+
+  /**
+   * Record an access to a page if the page is sampled.
+   * @param pageId Page ID.
+   * @param distance Set to the estimated reuse distance of the access, or to
+   * `kNoDistance` if it is the first access to the page.
+   * @return True if the page is sampled, false if the access was ignored.
+   */
+  bool sample(unsigned pageId, unsigned long long &distance);
+
+  /**
+   * Get the number of accesses a sampled access currently stands for.
+   * @return Inverse of the sampling rate, in units of
+   * `1 / ReuseDistanceHistogram::kAccessWeight`.
+   */
+  [[nodiscard]] unsigned long long getWeight() const;
+
+private:
+  struct Sample {
+    unsigned pageId;
+    std::uint32_t hash;
+
+    /** Time of the last access, an index into `tree_`. */
+    unsigned time;
+  };
+
+  /** Mark or unmark an access time. */
+  void addToTree(unsigned time, int delta);
+
+  /** Number of sampled pages last accessed at or before a time. */
+  [[nodiscard]] unsigned countUpTo(unsigned time) const;
+
+  /** Give the sampled pages consecutive times, growing the tree if full. */
+  void compact();
+
+  /** Stop sampling the pages with the largest hashes. */
+  void lowerThreshold();
+
+  PageTable<Sample> samples_;
+
+  std::deque<Sample> sampleStorage_;
+
+  std::vector<Sample *> freeSamples_;
+
+  /** Hashes and page IDs of the sampled pages, largest hash on top. */
+  std::priority_queue<std::pair<std::uint32_t, unsigned>> hashes_;
+
+  /** Fenwick tree with a one at the time of each sampled page's last access. */
+  std::vector<unsigned> tree_;
+
+  unsigned nextTime_;
+
+  /** Pages are sampled if the hash of their page ID is below this. */
+  std::uint32_t threshold_;
+};
+
+#endif
@@ -0,0 +1,271 @@
+#include "page_allocator.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+/** Slots are cache-line aligned, so page buffers are too. */
+constexpr std::size_t kSlotAlignment = 64;
+
+/** Alignment of the page object and the extra space. */
+constexpr std::size_t kFieldAlignment = alignof(std::max_align_t);
+
+/** Number of slots in the first chunk. Later chunks double up to the cap. */
+constexpr std::size_t kMinSlotsPerChunk = 16;
+
+constexpr std::size_t kMaxSlotsPerChunk = 1024;
+
+/** Size and alignment of the chunks of the huge page layout. */
+constexpr std::size_t kHugeChunkSize = 2 << 20;
+
+std::atomic<std::size_t> numMappedBytes(0);
+
+std::atomic<bool> useHugePages(false);
+
+/** Cleared once mapping explicit huge pages fails, to stop trying. */
+std::atomic<bool> explicitHugePagesAvailable(true);
+
+std::size_t alignUp(std::size_t size, std::size_t alignment) {
+  return (size + alignment - 1) & ~(alignment - 1);
+}
+
+/**
+ * Map a chunk of the huge page layout, aligned to its size. Uses explicit
+ * huge pages if the system has some reserved, and otherwise asks for
+ * transparent huge pages, which the kernel may or may not provide.
+ */
+char *mapHugeChunk() {
+#ifdef MAP_HUGETLB
+  if (explicitHugePagesAvailable) {
+    auto memory = mmap(nullptr, kHugeChunkSize, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (memory != MAP_FAILED) {
+      return (char *)memory;
+    }
+    explicitHugePagesAvailable = false;
+  }
+#endif
+  // Map twice the size and unmap what lies outside an aligned chunk
+  auto memory = (char *)mmap(nullptr, 2 * kHugeChunkSize,
+                             PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+  auto chunk = (char *)alignUp((std::uintptr_t)memory, kHugeChunkSize);
+  if (chunk != memory) {
+    munmap(memory, (std::size_t)(chunk - memory));
+  }
+  munmap(chunk + kHugeChunkSize,
+         kHugeChunkSize - (std::size_t)(chunk - memory));
+#ifdef MADV_HUGEPAGE
+  madvise(chunk, kHugeChunkSize, MADV_HUGEPAGE);
+#endif
+  return chunk;
+}
+
+} // namespace
+
+std::size_t PageAllocator::getNumMappedBytes() { return numMappedBytes; }
+
+void PageAllocator::setUseHugePages(bool enabled) { useHugePages = enabled; }
+
+bool PageAllocator::getUseHugePages() { return useHugePages; }
+
+PageAllocator::PageAllocator(int pageSize, int extraSize,
+                             std::size_t pageObjectSize)
+    : hugePages_(useHugePages), pageSize_((std::size_t)pageSize),
+      numFreshSlots_(0), freeList_(nullptr) {
+  separateBuffers_ =
+      hugePages_ || pageSize_ % (std::size_t)sysconf(_SC_PAGESIZE) == 0;
+  // The extra space is never smaller than a pointer, because the start of it
+  // is cleared whenever a slot is handed out under a new page ID.
+  std::size_t extraBytes = (std::size_t)extraSize < sizeof(void *)
+                               ? sizeof(void *)
+                               : (std::size_t)extraSize;
+  if (separateBuffers_) {
+    // A slot is the page object, the extra space and a pointer to its page
+    // buffer, which sits apart in the buffer area of the chunk
+    pageObjectOffset_ = 0;
+    extraOffset_ = alignUp(pageObjectSize, kFieldAlignment);
+    bufferPointerOffset_ = alignUp(extraOffset_ + extraBytes, sizeof(void *));
+    metadataSize_ =
+        alignUp(bufferPointerOffset_ + sizeof(void *), kFieldAlignment);
+    slotSize_ = pageSize_ + metadataSize_;
+  }
+  else {
+    pageObjectOffset_ = alignUp(pageSize_, kFieldAlignment);
+    extraOffset_ =
+        alignUp(pageObjectOffset_ + pageObjectSize, kFieldAlignment);
+    bufferPointerOffset_ = 0;
+    slotSize_ = alignUp(extraOffset_ + extraBytes, kSlotAlignment);
+    metadataSize_ = slotSize_;
+  }
+}
+
+PageAllocator::~PageAllocator() {
+  for (auto &chunk : chunks_) {
+    munmap(chunk.memory, chunk.numBytes);
+    numMappedBytes -= chunk.numBytes;
+  }
+}
+
+void *PageAllocator::allocate() {
+  char *slot;
+  if (freeList_ != nullptr) {
+    slot = (char *)freeList_;
+    freeList_ = *(void **)freeList_;
+  }
+  else {
+    if (numFreshSlots_ == 0) {
+      addChunk();
+    }
+    auto &chunk = chunks_.back();
+    auto index = chunk.numSlots - numFreshSlots_;
+    slot = chunk.slots + index * metadataSize_;
+    if (separateBuffers_) {
+      *(char **)(slot + bufferPointerOffset_) =
+          chunk.memory + index * pageSize_;
+    }
+    --numFreshSlots_;
+  }
+  return slot + pageObjectOffset_;
+}
+
+void PageAllocator::deallocate(void *pageObject) {
+  auto slot = (char *)pageObject - pageObjectOffset_;
+  *(void **)slot = freeList_;
+  freeList_ = slot;
+}
+
+std::size_t PageAllocator::releaseFreeChunks() {
+  if (chunks_.empty()) {
+    return 0;
+  }
+  std::vector<char *> freeSlots;
+  for (auto slot = freeList_; slot != nullptr; slot = *(void **)slot) {
+    freeSlots.push_back((char *)slot);
+  }
+  std::sort(freeSlots.begin(), freeSlots.end());
+  std::vector<std::size_t> byAddress(chunks_.size());
+  for (std::size_t i = 0; i < chunks_.size(); ++i) {
+    byAddress[i] = i;
+  }
+  std::sort(byAddress.begin(), byAddress.end(),
+            [&](std::size_t a, std::size_t b) {
+              return chunks_[a].memory < chunks_[b].memory;
+            });
+
+  // Find the chunk of each free slot. Both lists are in address order.
+  // Slots of other allocators, freed here by a sharded cache after a page
+  // changed shard, belong to no chunk.
+  constexpr auto kNoChunk = ~(std::size_t)0;
+  std::vector<std::size_t> slotChunks(freeSlots.size(), kNoChunk);
+  std::vector<std::size_t> numFreeSlots(chunks_.size(), 0);
+  numFreeSlots.back() = numFreshSlots_;
+  std::size_t position = 0;
+  for (std::size_t i = 0; i < freeSlots.size(); ++i) {
+    while (position < byAddress.size() &&
+           freeSlots[i] >= chunks_[byAddress[position]].memory +
+                               chunks_[byAddress[position]].numBytes) {
+      ++position;
+    }
+    if (position < byAddress.size() &&
+        freeSlots[i] >= chunks_[byAddress[position]].memory) {
+      slotChunks[i] = byAddress[position];
+      ++numFreeSlots[slotChunks[i]];
+    }
+  }
+
+  std::size_t numReleasedBytes = 0;
+  std::vector<bool> released(chunks_.size(), false);
+  std::vector<Chunk> keptChunks;
+  for (std::size_t i = 0; i < chunks_.size(); ++i) {
+    auto &chunk = chunks_[i];
+    if (numFreeSlots[i] < chunk.numSlots) {
+      keptChunks.push_back(chunk);
+      continue;
+    }
+    munmap(chunk.memory, chunk.numBytes);
+    numMappedBytes -= chunk.numBytes;
+    numReleasedBytes += chunk.numBytes;
+    released[i] = true;
+  }
+  if (released.back()) {
+    numFreshSlots_ = 0;
+  }
+  chunks_ = std::move(keptChunks);
+
+  // The lowest address ends up at the head of the list
+  freeList_ = nullptr;
+  for (auto i = freeSlots.size(); i-- > 0;) {
+    if (slotChunks[i] == kNoChunk || !released[slotChunks[i]]) {
+      *(void **)freeSlots[i] = freeList_;
+      freeList_ = freeSlots[i];
+    }
+  }
+  return numReleasedBytes;
+}
+
+void PageAllocator::addChunk() {
+  std::size_t numSlots;
+  std::size_t numBytes;
+  char *memory;
+  if (hugePages_) {
+    numSlots = kHugeChunkSize / slotSize_;
+    numBytes = kHugeChunkSize;
+    memory = mapHugeChunk();
+  }
+  else {
+    numSlots = chunks_.empty() ? kMinSlotsPerChunk
+                               : chunks_.back().numSlots * 2;
+    if (numSlots > kMaxSlotsPerChunk) {
+      numSlots = kMaxSlotsPerChunk;
+    }
+    // Mappings are aligned to pages of the system, so slots and buffers are
+    // aligned
+    numBytes =
+        alignUp(numSlots * slotSize_, (std::size_t)sysconf(_SC_PAGESIZE));
+    auto mapping = mmap(nullptr, numBytes, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    memory = (char *)mapping;
+  }
+  auto slots = separateBuffers_ ? memory + numSlots * pageSize_ : memory;
+  chunks_.push_back({memory, slots, numSlots, numBytes});
+  numMappedBytes += numBytes;
+  numFreshSlots_ = numSlots;
+}
+
+std::size_t PageAllocator::releaseBuffer(void *pageObject) {
+  if (!canReleaseBuffers() ||
+      madvise(getBuffer(pageObject), pageSize_, MADV_DONTNEED) != 0) {
+    return 0;
+  }
+  return pageSize_;
+}
+
+bool PageAllocator::canReleaseBuffers() const {
+  return separateBuffers_ && !hugePages_;
+}
+
+std::size_t PageAllocator::getSlotSize() const { return slotSize_; }
+
+void *PageAllocator::getBuffer(void *pageObject) const {
+  auto slot = (char *)pageObject - pageObjectOffset_;
+  if (!separateBuffers_) {
+    return slot;
+  }
+  return *(char **)(slot + bufferPointerOffset_);
+}
+
+void *PageAllocator::getExtra(void *pageObject) const {
+  return (char *)pageObject - pageObjectOffset_ + extraOffset_;
+}
@@ -0,0 +1,177 @@
+#ifndef PAGE_ALLOCATOR_HPP
+#define PAGE_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Slab allocator for page slots. Each slot holds a page buffer, the page
+ * object and the extra space, carved out of large contiguous chunks mapped
+ * straight from the operating system, so that a chunk can be given back
+ * whole. Freed slots are recycled through an intrusive free list, so new
+ * chunks are only mapped when the cache grows beyond every slot allocated so
+ * far.
+ *
+ * When the page size is a multiple of the page size of the system, a chunk
+ * holds every page buffer first, contiguous and aligned to the page size,
+ * followed by the page objects and extra spaces, so that no buffer straddles
+ * two pages of the system and the memory of one buffer can be released on
+ * its own. Otherwise a slot is the page buffer followed by the page object
+ * and the extra space. Chunks double from 16 up to 1024 slots.
+ *
+ * With huge pages, chunks are 2 MB, aligned to their size and laid out with
+ * the buffers first. They are backed by explicit huge pages when the system
+ * has some reserved, or else by transparent huge pages where the kernel
+ * provides them, or else by normal pages, so that the buffers a B-tree walk
+ * reads share few TLB entries.
+ */
+class PageAllocator {
+public:
+  /**
+   * Get the memory mapped for chunks by every allocator in the process.
+   * @return Number of bytes.
+   */
+  static std::size_t getNumMappedBytes();
+
+  /**
+   * Choose whether allocators constructed afterwards use the huge page
+   * layout. Off by default.
+   * @param enabled True to use huge pages.
+   */
+  static void setUseHugePages(bool enabled);
+
+  /**
+   * Whether allocators constructed now use the huge page layout.
+   * @return True if huge pages are used.
+   */
+  static bool getUseHugePages();
+
+  /**
+   * Construct a PageAllocator.
+   * @param pageSize Size in bytes of a page buffer.
+   * @param extraSize Size in bytes of the extra space.
+   * @param pageObjectSize Size in bytes of the page object.
+   */
+  PageAllocator(int pageSize, int extraSize, std::size_t pageObjectSize);
+
+  PageAllocator(const PageAllocator &) = delete;
+  PageAllocator &operator=(const PageAllocator &) = delete;
+
+  /**
+   * Destroy the PageAllocator, unmapping every chunk. Page objects still
+   * living in the chunks are not destroyed.
+   */
+  ~PageAllocator();
+
+  /**
+   * Allocate a slot. The page buffer and the extra space are not zeroed.
+   * @return Pointer to the storage for the page object.
+   */
+  void *allocate();
+
+  /**
+   * Return a slot to the free list.
+   * @param pageObject Pointer returned by `allocate`.
+   */
+  void deallocate(void *pageObject);
+
+  /**
+   * Unmap every chunk none of whose slots is allocated. The free list is then
+   * rebuilt in address order, so that the next allocations fill the chunks at
+   * the lowest addresses first and the others are more likely to be empty at
+   * the next call.
+   * @return Number of bytes returned to the operating system.
+   */
+  std::size_t releaseFreeChunks();
+
+  /**
+   * Release the memory of the page buffer of an allocated slot to the
+   * operating system, keeping its address. The buffer reads as zeros
+   * afterwards, until it is written again.
+   * @param pageObject Pointer returned by `allocate`.
+   * @return Number of bytes released, zero if the buffer cannot be released.
+   */
+  std::size_t releaseBuffer(void *pageObject);
+
+  /**
+   * Whether `releaseBuffer` releases anything. Needs buffers apart from the
+   * metadata and the size of whole pages of the system, and no huge pages,
+   * which cannot be released piecemeal.
+   * @return True if buffers can be released.
+   */
+  [[nodiscard]] bool canReleaseBuffers() const;
+
+  /**
+   * Get the size of a slot, the memory taken by one page.
+   * @return Size in bytes of a slot.
+   */
+  [[nodiscard]] std::size_t getSlotSize() const;
+
+  /**
+   * Get the page buffer of a slot.
+   * @param pageObject Pointer returned by `allocate`.
+   * @return Pointer to the page buffer.
+   */
+  [[nodiscard]] void *getBuffer(void *pageObject) const;
+
+  /**
+   * Get the extra space of a slot.
+   * @param pageObject Pointer returned by `allocate`.
+   * @return Pointer to the extra space.
+   */
+  [[nodiscard]] void *getExtra(void *pageObject) const;
+
+private:
+  struct Chunk {
+    char *memory;
+
+    /** First slot. Past the page buffers when they are apart. */
+    char *slots;
+
+    std::size_t numSlots;
+
+    /** Size of the mapping, rounded up to whole pages of the system. */
+    std::size_t numBytes;
+  };
+
+  /** Map a new chunk and make its slots the fresh ones. */
+  void addChunk();
+
+  /** Whether the allocator uses the huge page layout. */
+  bool hugePages_;
+
+  /** Whether page buffers sit apart from the slots, first in each chunk. */
+  bool separateBuffers_;
+
+  /** Size in bytes of a page buffer. */
+  std::size_t pageSize_;
+
+  /** Memory in bytes taken by one page. */
+  std::size_t slotSize_;
+
+  /**
+   * Distance in bytes between two slots. With separate buffers, slots hold
+   * only the page object, the extra space and a pointer to their buffer.
+   */
+  std::size_t metadataSize_;
+
+  /** Offset in bytes of the page object within a slot. */
+  std::size_t pageObjectOffset_;
+
+  /** Offset in bytes of the extra space within a slot. */
+  std::size_t extraOffset_;
+
+  /** Offset in bytes of the pointer to the page buffer within a slot. */
+  std::size_t bufferPointerOffset_;
+
+  /** Chunks allocated so far, oldest first. */
+  std::vector<Chunk> chunks_;
+
+  /** Number of never used slots at the end of the newest chunk. */
+  std::size_t numFreshSlots_;
+
+  /** Head of the list of freed slots. */
+  void *freeList_;
+};
+
+#endif
@@ -1,23 +1,71 @@
 #include "page_cache.hpp"
 
-#include <cstdint>
-#include <cstdlib>
-
-Page::Page(int pageSize, int extraSize) : sqlite3_pcache_page() {
-  pBufInner_ = calloc(pageSize + 7, 1);
-  pBuf = (void *)(((uintptr_t)pBufInner_ + 7) & ~(uintptr_t)0x3);
-  pExtra = calloc(extraSize, 1);
+Page::Page(void *buffer, void *extra, unsigned pageId)
+    : sqlite3_pcache_page(), pageId(pageId) {
+  pBuf = buffer;
+  pExtra = extra;
 }
 
-Page::~Page() {
-  free(pBufInner_);
-  free(pExtra);
+void Page::reset() { *(void **)pExtra = nullptr; }
+
+PageCache::PageCache(int pageSize, int extraSize, std::size_t pageObjectSize)
+    : maxNumPages_(0), pageSize_(pageSize), extraSize_(extraSize),
+      numPinnedPages_(0), pageObjectSize_(pageObjectSize),
+      privatePageAllocator_(pageSize, extraSize, pageObjectSize),
+      pageAllocator_(&privatePageAllocator_), pagePool_(nullptr),
+      victimTier_(pageSize), lastPoolUse_(0) {}
+
+PageCache::~PageCache() {
+  victimTier_.clear(*pageAllocator_);
+  if (pagePool_ != nullptr) {
+    pagePool_->detach(this);
+  }
 }
 
-PageCache::PageCache(int pageSize, int extraSize)
-    : pageSize_(pageSize), extraSize_(extraSize), maxNumPages_(0),
-      numFetches_(0), numHits_(0) {}
+std::size_t PageCache::releaseMemory() {
+  // Evicted pages would only go to the victim tier to be dropped with it
+  victimTier_.clear(*pageAllocator_);
+  recordVictimTierSize();
+  victimTier_.setPaused(true);
+  while (evictPage()) {
+  }
+  victimTier_.setPaused(false);
+  return pageAllocator_->releaseFreeChunks();
+}
 
 unsigned long long PageCache::getNumFetches() const { return numFetches_; }
 
 unsigned long long PageCache::getNumHits() const { return numHits_; }
+
+unsigned long long PageCache::getNumRestores() const { return numRestores_; }
+
+PageCacheStatistics PageCache::getStatistics() const {
+  PageCacheStatistics statistics;
+  statistics.pageSize = pageSize_;
+  statistics.numBytesPerPage =
+      (std::size_t)pageSize_ + (std::size_t)extraSize_ + pageObjectSize_;
+  statistics.numOverheadBytesPerPage = pageAllocator_->getSlotSize() -
+                                       (std::size_t)pageSize_ -
+                                       (std::size_t)extraSize_;
+  statistics.numFetches = numFetches_;
+  statistics.numHits = numHits_;
+  statistics.numRestores = numRestores_;
+  counters_.addTo(statistics);
+  return statistics;
+}
+
+PageCacheCounters &PageCache::getCounters() { return counters_; }
+
+PageCacheTuner &PageCache::getTuner() { return tuner_; }
+
+std::vector<MissRatioCurvePoint> PageCache::getMissRatioCurve() const {
+  return getStatistics().getMissRatioCurve();
+}
+
+PagePool *PageCache::getPagePool() const { return pagePool_; }
+
+std::size_t PageCache::getNumBytesPerSlot() const {
+  return pageAllocator_->getSlotSize();
+}
+
+bool PageCache::canJoinPagePool() const { return true; }
@@ -2,23 +2,43 @@
 #define PAGE_CACHE_HPP
 
 #include "dependencies/sqlite/sqlite3.h"
+#include "page_allocator.hpp"
+#include "page_cache_statistics.hpp"
+#include "page_cache_trace.hpp"
+#include "page_cache_tuner.hpp"
+#include "page_pool.hpp"
+#include "victim_tier.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
 
 class Page : sqlite3_pcache_page {
 public:
   /**
-   * Construct a Page.
-   * @param pageSize Size in bytes of the page.
-   * @param extraSize Size in bytes of the buffer to store extra information.
+   * Construct a Page. The buffers are owned by the cache's `PageAllocator`.
+   * @param buffer Buffer to store the page.
+   * @param extra Buffer to store extra information. At least the size of a
+   * pointer.
+   * @param pageId Page ID.
    */
-  Page(int pageSize, int extraSize);
+  Page(void *buffer, void *extra, unsigned pageId);
 
   Page(const Page &) = delete;
   Page &operator=(const Page &) = delete;
 
-  ~Page();
+  /**
+   * Prepare the page to be handed out under a new page ID. The start of the
+   * extra space is cleared, which is how SQLite tells that it has not set up
+   * the page yet. The page buffer is left as is, since SQLite overwrites it.
+   */
+  void reset();
 
-private:
-  void *pBufInner_;
+  /** Page ID. */
+  unsigned pageId;
 };
 
 class PageCache {
@@ -27,13 +47,14 @@ public:
    * Construct a PageCache.
    * @param pageSize Page size in bytes. Assumed to be a power of two.
    * @param extraSize Extra space in bytes. Assumed to be less than 250.
+   * @param pageObjectSize Size in bytes of the implementation's page object.
    */
-  PageCache(int pageSize, int extraSize);
+  PageCache(int pageSize, int extraSize, std::size_t pageObjectSize);
 
   /**
-   * Destroy the PageCache.
+   * Destroy the PageCache. Leaves the page pool, if the cache is in one.
    */
-  virtual ~PageCache() = default;
+  virtual ~PageCache();
 
   /**
    * Set the maximum number of pages in the cache. Discard unpinned pages until
@@ -54,18 +75,19 @@ public:
   /**
    * Fetch and pin a page. If the page is already in the cache, return a
    * pointer to the page. If the page is not already in the cache, use the
-   * `allocate` parameter to determine how to proceed. If `allocate` is false,
-   * return a null pointer. If `allocate` is true, examine the number of pages
-   * in the cache. If the number of pages in the cache is less than the maximum,
-   * allocate and return a pointer to a new page. If the number of pages in the
-   * cache is greater than or equal to the maximum, return a pointer to an
-   * existing unpinned page. If all pages are pinned, return a null pointer.
+   * `createFlag` parameter to determine how to proceed. If `createFlag` is 0,
+   * return a null pointer. Otherwise, examine the number of pages in the cache.
+   * If the number of pages in the cache is less than the maximum, allocate and
+   * return a pointer to a new page. If the number of pages in the cache is
+   * greater than or equal to the maximum, return a pointer to an existing
+   * unpinned page. If all pages are pinned, return a null pointer if
+   * `createFlag` is 1, or allocate a page beyond the maximum if it is 2.
    * @param pageId Page ID.
-   * @param allocate Allocate new page on miss.
+   * @param createFlag 0, 1 or 2, as passed to `xFetch`.
    * @param hit True if the request was a hit and false otherwise.
    * @return Pointer to a page. May be null.
    */
-  virtual Page *fetchPage(unsigned pageId, bool allocate) = 0;
+  virtual Page *fetchPage(unsigned pageId, int createFlag) = 0;
 
   /**
    * Unpin a page. The page is unpinned regardless of the number of prior
@@ -95,19 +117,250 @@ public:
    */
   virtual void discardPages(unsigned pageIdLimit) = 0;
 
+  /**
+   * Discard the unpinned page that the replacement policy would replace next.
+   * @return True if a page was discarded, false if all pages are pinned.
+   */
+  virtual bool evictPage() = 0;
+
+  /**
+   * Evict every unpinned page, empty the victim tier, and return the chunks
+   * of page slots left without pages to the operating system. In a page
+   * pool, the chunks are shared with the other caches, whose pages may keep
+   * some of them.
+   * @return Number of bytes returned to the operating system.
+   */
+  virtual std::size_t releaseMemory();
+
   /**
    * Get the number of fetches since creation.
    * @return Number of fetches since creation.
    */
-  [[nodiscard]] unsigned long long getNumFetches() const;
+  [[nodiscard]] virtual unsigned long long getNumFetches() const;
 
   /**
    * Get the number of hits since creation.
    * @return Number of hits since creation.
    */
-  [[nodiscard]] unsigned long long getNumHits() const;
+  [[nodiscard]] virtual unsigned long long getNumHits() const;
+
+  /**
+   * Get the number of fetches that restored a page from the victim tier
+   * since creation. These are not hits.
+   * @return Number of restores since creation.
+   */
+  [[nodiscard]] virtual unsigned long long getNumRestores() const;
+
+  /**
+   * Take a snapshot of the statistics of the cache. May be called from any
+   * thread while the cache is in use.
+   * @return Statistics of the cache, without its cache ID.
+   */
+  [[nodiscard]] virtual PageCacheStatistics getStatistics() const;
+
+  /**
+   * Get the counters of the cache, for the callers that record its calls.
+   * @return Reference to the counters.
+   */
+  PageCacheCounters &getCounters();
+
+  /**
+   * Get the tuner of the cache's capacity.
+   * @return Reference to the tuner.
+   */
+  PageCacheTuner &getTuner();
+
+  /**
+   * Estimate the hit ratio the cache would have at other sizes, from the
+   * reuse distances of a sample of the fetches made through
+   * `PageCacheMethods`. The estimates are for LRU, which other policies
+   * usually beat somewhat, so they are best read relative to each other.
+   * @return Points at 0.25 to 4 times the maximum number of pages, in order of
+   * size, or none if no fetch was sampled.
+   */
+  [[nodiscard]] std::vector<MissRatioCurvePoint> getMissRatioCurve() const;
+
+  /**
+   * Get the page pool the cache allocates its pages from.
+   * @return Pointer to the page pool, or null if the cache is not in one.
+   */
+  [[nodiscard]] PagePool *getPagePool() const;
+
+  /**
+   * Get the memory a page of the cache takes: the size of a slot of its
+   * allocator, which is what the page pool counts for it.
+   * @return Size in bytes.
+   */
+  [[nodiscard]] std::size_t getNumBytesPerSlot() const;
+
+  /**
+   * Whether the cache synchronizes its own calls, so that `PageCacheMethods`
+   * may make them from several threads at once. Such a cache provides
+   * `fetchAndRecordPage`, which records a fetch in the counters of the part of
+   * the cache that holds the page, under the lock of that part.
+   */
+  static constexpr bool kSynchronizesItself = false;
 
 protected:
+  friend class PagePool;
+
+  /**
+   * Whether the cache can allocate its pages from a page pool. A cache that
+   * does not allocate through `newPage` or synchronizes itself opts out.
+   * @return True if the cache can join a page pool.
+   */
+  [[nodiscard]] virtual bool canJoinPagePool() const;
+
+  /**
+   * Allocate and construct a page object in a slot of the cache's
+   * `PageAllocator`. The page buffer is not zeroed. If the victim tier has
+   * the page, its slot is taken back with the page as it was evicted.
+   * @param pageId Page ID.
+   * @param args Arguments forwarded after the page ID.
+   * @return Pointer to the new page, or null if the cache is in a page pool
+   * that is out of memory and has no unpinned page left to evict.
+   */
+  template <typename PageType, typename... Args>
+  PageType *newPage(unsigned pageId, Args &&...args) {
+    if (pagePool_ != nullptr && !pagePool_->reservePage(this, false)) {
+      return nullptr;
+    }
+    return constructPage<PageType>(pageId, std::forward<Args>(args)...);
+  }
+
+  /**
+   * Like `newPage`, but exceed the memory limit of the page pool rather than
+   * fail. Used for fetches with `createFlag` 2 that find every page pinned,
+   * which SQLite can only satisfy by growing the cache, and for pages that
+   * take the place of a victim the victim tier kept.
+   * @param pageId Page ID.
+   * @param args Arguments forwarded after the page ID.
+   * @return Pointer to the new page.
+   */
+  template <typename PageType, typename... Args>
+  PageType *newPageBeyondLimit(unsigned pageId, Args &&...args) {
+    if (pagePool_ != nullptr) {
+      pagePool_->reservePage(this, true);
+    }
+    return constructPage<PageType>(pageId, std::forward<Args>(args)...);
+  }
+
+  /**
+   * Destroy a page created by `newPage` and recycle its slot.
+   * @param page Pointer to the page.
+   */
+  template <typename PageType> void deletePage(PageType *page) {
+    page->~PageType();
+    pageAllocator_->deallocate(page);
+    countDeletedPage();
+  }
+
+  /**
+   * Destroy a page the policy evicted. The victim tier may keep its slot and
+   * a compressed image of it, to restore if the page is fetched again.
+   * @param page Pointer to the page.
+   */
+  template <typename PageType> void deleteVictim(PageType *page) {
+    auto pageId = page->pageId;
+    page->~PageType();
+    if (victimTier_.keep(pageId, page, *pageAllocator_)) {
+      counters_.recordCompression();
+      recordVictimTierSize();
+    }
+    else {
+      pageAllocator_->deallocate(page);
+    }
+    countDeletedPage();
+  }
+
+  /**
+   * Whether evicted pages may go to the victim tier. If so, the slot of a
+   * victim cannot be reused for the page that replaces it, which needs a
+   * slot of its own.
+   * @return True if the cache has a victim tier.
+   */
+  [[nodiscard]] bool keepsVictims() const { return victimTier_.isEnabled(); }
+
+  /**
+   * Drop the page of the victim tier with the given page ID, if there is one,
+   * because SQLite may have written the page elsewhere. Called for fetches
+   * with `createFlag` 0 that miss, since SQLite then takes the page as not
+   * cached, and for the new page ID of a page that changes page ID.
+   * @param pageId Page ID.
+   */
+  void forgetVictim(unsigned pageId) {
+    if (victimTier_.getNumPages() != 0) {
+      victimTier_.forget(pageId, *pageAllocator_);
+      recordVictimTierSize();
+    }
+  }
+
+  /**
+   * Drop the pages of the victim tier with page IDs greater than or equal to
+   * `pageIdLimit`, for truncations.
+   * @param pageIdLimit Page ID limit.
+   */
+  void forgetVictims(unsigned pageIdLimit) {
+    if (victimTier_.getNumPages() != 0) {
+      victimTier_.forgetFrom(pageIdLimit, *pageAllocator_);
+      recordVictimTierSize();
+    }
+  }
+
+  /** Count a page that was unpinned before and is pinned now. */
+  void countPin() {
+    ++numPinnedPages_;
+    counters_.recordNumPinnedPages(numPinnedPages_);
+  }
+
+  /** Count a pinned page that was unpinned or discarded. */
+  void countUnpin() { --numPinnedPages_; }
+
+  /**
+   * Construct a page object in the slot the victim tier kept for the page,
+   * or else in a newly allocated slot.
+   */
+  template <typename PageType, typename... Args>
+  PageType *constructPage(unsigned pageId, Args &&...args) {
+    void *pageObject = nullptr;
+    if (victimTier_.getNumPages() != 0) {
+      pageObject = victimTier_.restore(pageId, *pageAllocator_);
+    }
+    auto restored = pageObject != nullptr;
+    if (!restored) {
+      pageObject = pageAllocator_->allocate();
+    }
+    auto page = new (pageObject)
+        PageType(pageAllocator_->getBuffer(pageObject),
+                 pageAllocator_->getExtra(pageObject), pageId,
+                 std::forward<Args>(args)...);
+    // A restored page keeps the extra space SQLite set up, so that SQLite
+    // finds it as it left it
+    if (restored) {
+      ++numRestores_;
+      recordVictimTierSize();
+    }
+    else {
+      page->reset();
+    }
+    counters_.recordNewPage();
+    return page;
+  }
+
+  /** Count a page that left the cache. */
+  void countDeletedPage() {
+    counters_.recordDeletedPage();
+    if (pagePool_ != nullptr) {
+      pagePool_->releasePage(this);
+    }
+  }
+
+  /** Copy the size of the victim tier to the counters. */
+  void recordVictimTierSize() {
+    counters_.recordTierSize(victimTier_.getNumPages(),
+                             victimTier_.getNumBytes());
+  }
+
   /** Maximum number of pages in the cache. */
   int maxNumPages_;
 
@@ -118,63 +371,215 @@ protected:
   int extraSize_;
 
   /** Number of fetches since creation. */
-  unsigned long long numFetches_;
+  StatisticsCounter numFetches_;
 
   /** Number of hits since creation. */
-  unsigned long long numHits_;
+  StatisticsCounter numHits_;
+
+  /** Number of restores from the victim tier since creation. */
+  StatisticsCounter numRestores_;
+
+  /** Number of pinned pages, kept with `countPin` and `countUnpin`. */
+  int numPinnedPages_;
+
+  /** Counters beyond fetches and hits. */
+  PageCacheCounters counters_;
+
+  /** Tunes the capacity when autotuning is enabled. */
+  PageCacheTuner tuner_;
+
+  /** Size in bytes of the implementation's page object. */
+  std::size_t pageObjectSize_;
+
+  /** Storage for the pages of the cache when it is not in a page pool. */
+  PageAllocator privatePageAllocator_;
+
+  /** Storage the pages of the cache are allocated from. */
+  PageAllocator *pageAllocator_;
+
+  /** Page pool the cache is in, or null. */
+  PagePool *pagePool_;
+
+  /** Evicted pages kept compressed, in slots of `pageAllocator_`. */
+  VictimTier victimTier_;
+
+  /** Time of the last use of the cache, on the clock of its page pool. */
+  unsigned long long lastPoolUse_;
 };
 
+/**
+ * The `sqlite3_pcache_methods2` of a `PageCache` implementation. The methods
+ * call the cache through `PageCacheImplementation` rather than `PageCache`,
+ * so when the implementation is final the calls are not virtual, and what it
+ * defines in its header can be inlined.
+ */
 template <typename PageCacheImplementation>
 struct PageCacheMethods : sqlite3_pcache_methods2 {
   explicit PageCacheMethods() : sqlite3_pcache_methods2() {
-    xInit = [](void *) { return SQLITE_OK; };
+    xInit = [](void *) {
+      PagePool::initialize();
+      return SQLITE_OK;
+    };
 
-    xShutdown = nullptr;
+    xShutdown = [](void *) {
+      PagePool::shutdown();
+      TraceRecorder::stop();
+    };
 
-    xCreate = [](int pageSize, int extraSize, int) {
-      return (sqlite3_pcache *)new PageCacheImplementation(pageSize, extraSize);
+    xCreate = [](int pageSize, int extraSize, int purgeable) {
+      auto pageCache = new PageCacheImplementation(pageSize, extraSize);
+      // Pages of non-purgeable caches cannot be read back, so they never
+      // share the pool with caches that may evict them.
+      auto pagePool = PagePool::get();
+      if (purgeable && pagePool != nullptr) {
+        std::lock_guard<std::mutex> lock(pagePool->getMutex());
+        pagePool->attach(pageCache);
+      }
+      if (auto recorder = TraceRecorder::get()) {
+        recorder->recordCreate(pageCache, pageSize, extraSize, purgeable);
+      }
+      PageCacheRegistry::add(pageCache, purgeable);
+      return (sqlite3_pcache *)pageCache;
     };
 
     xCachesize = [](sqlite3_pcache *pageCacheBase, int maxNumPages) {
-      auto pageCache = (PageCache *)pageCacheBase;
-      pageCache->setMaxNumPages(maxNumPages);
+      auto pageCache = (PageCacheImplementation *)pageCacheBase;
+      PagePoolLock lock(pageCache);
+      if (auto recorder = TraceRecorder::get()) {
+        recorder->recordCachesize(pageCache, maxNumPages);
+      }
+      if constexpr (PageCacheImplementation::kSynchronizesItself) {
+        pageCache->setMaxNumPages(maxNumPages);
+      }
+      else {
+        pageCache->getTuner().setRequestedMaxNumPages(*pageCache, maxNumPages);
+      }
+      pageCache->getCounters().recordMaxNumPages(maxNumPages);
     };
 
     xPagecount = [](sqlite3_pcache *pageCacheBase) {
-      auto pageCache = (PageCache *)pageCacheBase;
+      auto pageCache = (PageCacheImplementation *)pageCacheBase;
+      PagePoolLock lock(pageCache);
       return pageCache->getNumPages();
     };
 
     xFetch = [](sqlite3_pcache *pageCacheBase, unsigned pageId,
                 int createFlag) {
-      auto pageCache = (PageCache *)pageCacheBase;
-      return (sqlite3_pcache_page *)pageCache->fetchPage(pageId, createFlag);
+      auto pageCache = (PageCacheImplementation *)pageCacheBase;
+      PagePoolLock lock(pageCache);
+      Page *page;
+      // The tuner has no lock of its own, so a cache that synchronizes
+      // itself keeps the size SQLite set
+      if constexpr (PageCacheImplementation::kSynchronizesItself) {
+        page = pageCache->fetchAndRecordPage(pageId, createFlag);
+      }
+      else {
+        page = fetchAndRecordPage(*pageCache, pageId, createFlag);
+        pageCache->getTuner().recordFetch(*pageCache);
+      }
+      if (auto recorder = TraceRecorder::get()) {
+        recorder->recordFetch(pageCache, pageId, createFlag, page != nullptr);
+      }
+      return (sqlite3_pcache_page *)page;
     };
 
     xUnpin = [](sqlite3_pcache *pageCacheBase, sqlite3_pcache_page *pageBase,
                 int discard) {
-      auto pageCache = (PageCache *)pageCacheBase;
+      auto pageCache = (PageCacheImplementation *)pageCacheBase;
       auto page = (Page *)pageBase;
+      PagePoolLock lock(pageCache);
+      if (auto recorder = TraceRecorder::get()) {
+        recorder->recordUnpin(pageCache, page->pageId, discard);
+      }
       pageCache->unpinPage(page, discard);
     };
 
     xRekey = [](sqlite3_pcache *pageCacheBase, sqlite3_pcache_page *pageBase,
-                unsigned, unsigned newPageId) {
-      auto pageCache = (PageCache *)pageCacheBase;
+                unsigned oldPageId, unsigned newPageId) {
+      auto pageCache = (PageCacheImplementation *)pageCacheBase;
       auto page = (Page *)pageBase;
+      PagePoolLock lock(pageCache);
+      if (auto recorder = TraceRecorder::get()) {
+        recorder->recordRekey(pageCache, oldPageId, newPageId);
+      }
+      pageCache->getCounters().recordRekey();
       pageCache->changePageId(page, newPageId);
     };
 
     xTruncate = [](sqlite3_pcache *pageCacheBase, unsigned pageIdLimit) {
-      auto pageCache = (PageCache *)pageCacheBase;
+      auto pageCache = (PageCacheImplementation *)pageCacheBase;
+      PagePoolLock lock(pageCache);
+      if (auto recorder = TraceRecorder::get()) {
+        recorder->recordTruncate(pageCache, pageIdLimit);
+      }
+      auto numPages = pageCache->getNumPages();
       pageCache->discardPages(pageIdLimit);
+      pageCache->getCounters().recordTruncation(
+          (unsigned long long)(numPages - pageCache->getNumPages()));
+    };
+
+    xShrink = [](sqlite3_pcache *pageCacheBase) {
+      auto pageCache = (PageCacheImplementation *)pageCacheBase;
+      PagePoolLock lock(pageCache);
+      if (auto recorder = TraceRecorder::get()) {
+        recorder->recordShrink(pageCache);
+      }
+      pageCache->getCounters().recordShrink(pageCache->releaseMemory());
     };
 
     xDestroy = [](sqlite3_pcache *pageCacheBase) {
-      auto pageCache = (PageCache *)pageCacheBase;
+      auto pageCache = (PageCacheImplementation *)pageCacheBase;
+      PageCacheRegistry::remove(pageCache);
+      PagePoolLock lock(pageCache);
+      if (auto recorder = TraceRecorder::get()) {
+        recorder->recordDestroy(pageCache);
+      }
       delete pageCache;
     };
   }
+
+  /**
+   * Fetch a page and record the fetch in the counters of the cache, as
+   * `xFetch` does. The caller serializes the calls on the cache.
+   * @param pageCache Cache to fetch from.
+   * @param pageId Page ID.
+   * @param createFlag 0, 1 or 2, as passed to `xFetch`.
+   * @return Pointer to a page. May be null.
+   */
+  static Page *fetchAndRecordPage(PageCacheImplementation &pageCache,
+                                  unsigned pageId, int createFlag) {
+    auto &counters = pageCache.getCounters();
+    Page *page;
+    // Time a sample of the fetches, telling hits, restores and misses apart
+    // by their counts
+    if (counters.shouldSampleLatency()) {
+      auto numHits = pageCache.getNumHits();
+      auto numRestores = pageCache.getNumRestores();
+      auto start = std::chrono::steady_clock::now();
+      page = pageCache.fetchPage(pageId, createFlag);
+      auto latency = std::chrono::steady_clock::now() - start;
+      auto outcome = FetchOutcome::Miss;
+      if (pageCache.getNumHits() != numHits) {
+        outcome = FetchOutcome::Hit;
+      }
+      else if (pageCache.getNumRestores() != numRestores) {
+        outcome = FetchOutcome::Restore;
+      }
+      counters.recordFetchLatency(outcome, latency);
+    }
+    else {
+      page = pageCache.fetchPage(pageId, createFlag);
+    }
+    if (page == nullptr && createFlag != 0) {
+      counters.recordFailedFetch();
+    }
+    // A fetch that returns no page leaves the cache as it was, and SQLite
+    // fetches the page again if it needs it
+    if (page != nullptr) {
+      counters.recordAccess(pageId);
+    }
+    return page;
+  }
 };
 
 #endif
@@ -0,0 +1,361 @@
+#include "page_cache_arc.hpp"
+
+#include <algorithm>
+
+/**
+ * Consruct an ARC replacement policy Page.
+ * @param argBuffer - Page buffer.
+ * @param argExtra - Extra space.
+ * @param argPageId - Page ID.
+ * @param argPinned - The page's pin status.
+ */
+ARCReplacementPageCache::ARCReplacementPage::ARCReplacementPage(
+    void *argBuffer, void *argExtra, unsigned argPageId, bool argPinned)
+    : Page(argBuffer, argExtra, argPageId), pinned(argPinned), inT2(false),
+      prev(nullptr), next(nullptr) {}
+
+/**
+ * Construct a PageCache.
+ * @param pageSize - Page size in bytes. Assumed to be a power of two.
+ * @param extraSize - Extra space in bytes. Assumed to be less than 250.
+ */
+ARCReplacementPageCache::ARCReplacementPageCache(int pageSize, int extraSize)
+    : PageCache(pageSize, extraSize, sizeof(ARCReplacementPage)),
+      targetT1Size(0) {}
+
+/**
+ * Destructor of PageCache.
+ */
+ARCReplacementPageCache::~ARCReplacementPageCache() {
+  cachedPages.forEach(
+      [this](unsigned, ARCReplacementPage *page) { deletePage(page); });
+  cachedPages.clear();
+}
+
+/**
+ * Set the maximum number of pages in the cache. Discard unpinned pages until
+ * either the number of pages in the cache is less than or equal to
+ * `maxNumPages` or all the pages in the cache are pinned. If there are still
+ * too many pages after discarding all unpinned pages, pages will continue to
+ * be discarded after being unpinned in the `unpinPage` function. The ghost
+ * lists are trimmed to the new size as well.
+ * @param maxNumPages - Maximum number of pages in the cache.
+ */
+void ARCReplacementPageCache::setMaxNumPages(int maxNumPages) {
+  maxNumPages_ = maxNumPages;
+  targetT1Size = std::min(targetT1Size, std::max(maxNumPages, 0));
+  while (getNumPages() > maxNumPages && evictPage()) {
+  }
+  trimGhosts();
+}
+
+/**
+ * Get the number of pages in the cache, both pinned and unpinned.
+ * @return Number of pages in the cache.
+ */
+int ARCReplacementPageCache::getNumPages() const {
+  return (int)cachedPages.size();
+}
+
+/**
+ * Fetch and pin a page. If the page is already in the cache, return a
+ * pointer to the page. If the page is not already in the cache, use the
+ * `createFlag` parameter to determine how to proceed. If `createFlag` is 0,
+ * return a null pointer. Otherwise, examine the number of pages in the cache.
+ * If the number of pages in the cache is less than the maximum, allocate and
+ * return a pointer to a new page. If the number of pages in the cache is
+ * greater than or equal to the maximum, return a pointer to an existing
+ * unpinned page. If all pages are pinned, return a null pointer if
+ * `createFlag` is 1, or allocate a page beyond the maximum if it is 2.
+ * A hit moves the page to T2. A miss on a page ID in B1 grows the target size
+ * of T1, a miss on one in B2 shrinks it, and either kind of page enters T2;
+ * any other missed page enters T1.
+ * @param pageId - Page ID.
+ * @param createFlag - 0, 1 or 2, as passed to `xFetch`.
+ * @return Pointer to a page. May be null.
+ */
+Page *ARCReplacementPageCache::fetchPage(unsigned pageId, int createFlag) {
+  ++numFetches_;
+  auto page = cachedPages.find(pageId);
+  // Page already in cache
+  if (page != nullptr) {
+    (page->inT2 ? t2 : t1).remove(page);
+    page->inT2 = true;
+    t2.pushMostRecent(page);
+    if (!page->pinned) {
+      countPin();
+    }
+    page->pinned = true;
+    ++numHits_;
+    return page;
+  }
+  // 'createFlag' 0, SQLite takes the page as not cached
+  if (createFlag == 0) {
+    forgetVictim(pageId);
+    return nullptr;
+  }
+  // Adapt the target size of T1 if the page was evicted recently
+  auto ghost = ghostEntries.find(pageId);
+  bool missInB2 = false;
+  if (ghost != nullptr) {
+    missInB2 = ghost->inB2;
+    if (missInB2) {
+      auto delta = std::max(b1.size / b2.size, 1);
+      targetT1Size = std::max(targetT1Size - delta, 0);
+    }
+    else {
+      auto delta = std::max(b2.size / b1.size, 1);
+      targetT1Size = std::min(targetT1Size + delta, maxNumPages_);
+    }
+    removeGhost(ghost);
+  }
+  // Number of pages < maximum
+  if (getNumPages() < maxNumPages_) {
+    page = newPage<ARCReplacementPage>(pageId, true);
+  }
+  // Number of pages >= maximum, or the page pool is out of memory. Replace a
+  // page from T1 or T2 depending on the target size of T1.
+  if (page == nullptr) {
+    page = selectVictim(missInB2);
+    if (page != nullptr) {
+      retirePage(page);
+      counters_.recordEviction();
+      // The victim tier may keep the slot of the victim, so the page gets
+      // its own
+      if (keepsVictims()) {
+        deleteVictim(page);
+        page = newPageBeyondLimit<ARCReplacementPage>(pageId, true);
+      }
+      else {
+        page->pinned = true;
+        page->reset();
+        page->pageId = pageId;
+      }
+    }
+    // All pages pinned, grow beyond the maximum if SQLite insists
+    else if (createFlag == 2) {
+      page = newPageBeyondLimit<ARCReplacementPage>(pageId, true);
+    }
+    else {
+      return nullptr;
+    }
+  }
+  countPin();
+  page->inT2 = ghost != nullptr;
+  (page->inT2 ? t2 : t1).pushMostRecent(page);
+  cachedPages.insert(pageId, page);
+  trimGhosts();
+  return page;
+}
+
+/**
+ * Unpin a page. The page is unpinned regardless of the number of prior
+ * fetches, meaning it can be safely discarded. If `discard` is true, discard
+ * the page. If `discard` is false, examine the number of pages in the cache.
+ * If the number of pages in the cache is greater than the maximum, discard
+ * the page.
+ * @param page - Pointer to a page.
+ * @param discard - Discard the page.
+ */
+void ARCReplacementPageCache::unpinPage(Page *page, bool discard) {
+  auto *thisPage = (ARCReplacementPage *)page;
+  // Discard page if 'discard' true or number of pages grater than maximum
+  if (discard || getNumPages() > maxNumPages_) {
+    removePage(thisPage);
+    if (discard) {
+      deletePage(thisPage);
+    }
+    else {
+      counters_.recordEviction();
+      deleteVictim(thisPage);
+    }
+  }
+  // Unpin, the page keeps its place in T1 or T2
+  else {
+    thisPage->pinned = false;
+    countUnpin();
+  }
+}
+
+/**
+ * Change the page ID associated with a page. If a page with page ID
+ * `newPageId` is already in the cache, it is assumed that the page is
+ * unpinned, and the page is discarded. A ghost entry for `newPageId` is
+ * dropped, since it describes a page that no longer exists.
+ * @param page - Pointer to a page.
+ * @param newPageId - New page ID.
+ */
+void ARCReplacementPageCache::changePageId(Page *page, unsigned newPageId) {
+  auto *thisPage = (ARCReplacementPage *)page;
+  auto searchedPage = cachedPages.find(newPageId);
+  // Page found, already in cache, having 'newPageId' as its page ID. Discard.
+  if (searchedPage != nullptr) {
+    removePage(searchedPage);
+    deletePage(searchedPage);
+  }
+  // The victim tier's image of the new page ID is out of date
+  forgetVictim(newPageId);
+  auto ghost = ghostEntries.find(newPageId);
+  if (ghost != nullptr) {
+    removeGhost(ghost);
+  }
+  cachedPages.erase(thisPage->pageId);
+  thisPage->pageId = newPageId;
+  cachedPages.insert(newPageId, thisPage);
+}
+
+/**
+ * Discard all pages with page IDs greater than or equal to `pageIdLimit`. If
+ * any of these pages are pinned, then they are implicitly unpinned, meaning
+ * they can be safely discarded. Ghost entries for these page IDs are dropped
+ * as well.
+ * @param pageIdLimit - Page ID limit.
+ */
+void ARCReplacementPageCache::discardPages(unsigned pageIdLimit) {
+  forgetVictims(pageIdLimit);
+  cachedPages.eraseFrom(
+      pageIdLimit, [this](unsigned, ARCReplacementPage *page) {
+        if (page->pinned) {
+          countUnpin();
+        }
+        (page->inT2 ? t2 : t1).remove(page);
+        deletePage(page);
+      });
+  ghostEntries.eraseFrom(
+      pageIdLimit, [this](unsigned, GhostEntry *ghost) {
+        (ghost->inB2 ? b2 : b1).remove(ghost);
+        freeGhosts.push_back(ghost);
+      });
+}
+
+/**
+ * Discard the unpinned page that the replacement policy would replace next.
+ * Its page ID is remembered in the matching ghost list.
+ * @return True if a page was discarded, false if all pages are pinned.
+ */
+bool ARCReplacementPageCache::evictPage() {
+  auto victim = selectVictim(false);
+  if (victim == nullptr) {
+    return false;
+  }
+  retirePage(victim);
+  deleteVictim(victim);
+  trimGhosts();
+  counters_.recordEviction();
+  return true;
+}
+
+/**
+ * Select the page to replace. Take the least recently used unpinned page of
+ * T1 if T1 is larger than its target size, or exactly at it when the miss hit
+ * B2, otherwise that of T2. If the preferred list only holds pinned pages,
+ * fall back to the other one.
+ * @param missInB2 - The page being fetched has a ghost entry in B2.
+ * @return Pointer to an unpinned page, or null if all pages are pinned.
+ */
+ARCReplacementPageCache::ARCReplacementPage *
+ARCReplacementPageCache::selectVictim(bool missInB2) const {
+  // All pages pinned
+  if (numPinnedPages_ >= getNumPages()) {
+    return nullptr;
+  }
+  bool preferT1 = t1.size > 0 && (t1.size > targetT1Size ||
+                                  (missInB2 && t1.size == targetT1Size));
+  auto victim = leastRecentUnpinned(preferT1 ? t1 : t2);
+  if (victim == nullptr) {
+    victim = leastRecentUnpinned(preferT1 ? t2 : t1);
+  }
+  return victim;
+}
+
+/**
+ * Find the least recently used unpinned page of a resident list. Pinned pages
+ * are rare, so the walk is short in practice.
+ * @param list - T1 or T2.
+ * @return Pointer to an unpinned page, or null if all pages are pinned.
+ */
+ARCReplacementPageCache::ARCReplacementPage *
+ARCReplacementPageCache::leastRecentUnpinned(
+    const RecencyList<ARCReplacementPage> &list) {
+  auto page = list.leastRecent;
+  while (page != nullptr && page->pinned) {
+    page = page->next;
+  }
+  return page;
+}
+
+/**
+ * Take an unpinned page out of T1 or T2 and the page table, remembering its
+ * page ID at the most recently used end of B1 or B2 respectively. The page
+ * itself is left for the caller to reuse or delete.
+ * @param page - Pointer to an unpinned page.
+ */
+void ARCReplacementPageCache::retirePage(ARCReplacementPage *page) {
+  (page->inT2 ? t2 : t1).remove(page);
+  cachedPages.erase(page->pageId);
+  addGhost(page->pageId, page->inT2);
+}
+
+/**
+ * Remove a page from T1 or T2 and the page table, without remembering it in a
+ * ghost list. The page is left for the caller to delete.
+ * @param page - Pointer to a page.
+ */
+void ARCReplacementPageCache::removePage(ARCReplacementPage *page) {
+  if (page->pinned) {
+    countUnpin();
+  }
+  (page->inT2 ? t2 : t1).remove(page);
+  cachedPages.erase(page->pageId);
+}
+
+/**
+ * Add a ghost entry at the most recently used end of B1 or B2.
+ * @param pageId - Page ID of an evicted page.
+ * @param inB2 - Add to B2 rather than B1.
+ */
+void ARCReplacementPageCache::addGhost(unsigned pageId, bool inB2) {
+  GhostEntry *ghost;
+  if (!freeGhosts.empty()) {
+    ghost = freeGhosts.back();
+    freeGhosts.pop_back();
+  }
+  else {
+    ghostStorage.emplace_back();
+    ghost = &ghostStorage.back();
+  }
+  *ghost = {nullptr, nullptr, pageId, inB2};
+  (inB2 ? b2 : b1).pushMostRecent(ghost);
+  ghostEntries.insert(pageId, ghost);
+}
+
+/**
+ * Remove a ghost entry from its list and the ghost table and recycle it.
+ * @param ghost - Pointer to a ghost entry.
+ */
+void ARCReplacementPageCache::removeGhost(GhostEntry *ghost) {
+  (ghost->inB2 ? b2 : b1).remove(ghost);
+  ghostEntries.erase(ghost->pageId);
+  freeGhosts.push_back(ghost);
+}
+
+/**
+ * Drop the least recently used ghost entries until T1 and B1 together hold at
+ * most the maximum number of pages and all four lists together hold at most
+ * twice that.
+ */
+void ARCReplacementPageCache::trimGhosts() {
+  auto maxNumPages = std::max(maxNumPages_, 0);
+  while (b1.size > 0 && t1.size + b1.size > maxNumPages) {
+    removeGhost(b1.leastRecent);
+  }
+  auto directorySize = [this] {
+    return t1.size + t2.size + b1.size + b2.size;
+  };
+  while (b2.size > 0 && directorySize() > 2 * maxNumPages) {
+    removeGhost(b2.leastRecent);
+  }
+  while (b1.size > 0 && directorySize() > 2 * maxNumPages) {
+    removeGhost(b1.leastRecent);
+  }
+}
@@ -0,0 +1,95 @@
+#ifndef PAGE_CACHE_ARC_HPP
+#define PAGE_CACHE_ARC_HPP
+
+#include "page_cache.hpp"
+#include "page_table.hpp"
+#include "recency_list.hpp"
+
+#include <deque>
+#include <vector>
+
+/**
+ * Adaptive Replacement Cache (Megiddo and Modha, 2003). Resident pages seen
+ * once recently are in T1 and pages seen at least twice are in T2. The page
+ * IDs of pages evicted from them are remembered in the ghost lists B1 and B2.
+ * A miss that hits B1 means T1 was too small, one that hits B2 means T2 was
+ * too small, and the target size of T1 moves accordingly on every such miss,
+ * so the cache shifts between favouring recency and frequency as the
+ * workload changes. Pinned pages stay in their lists but are never chosen as
+ * victims.
+ */
+class ARCReplacementPageCache final : public PageCache {
+public:
+  ARCReplacementPageCache(int pageSize, int extraSize);
+
+  ~ARCReplacementPageCache() override;
+
+  void setMaxNumPages(int maxNumPages) override;
+
+  [[nodiscard]] int getNumPages() const override;
+
+  Page *fetchPage(unsigned pageId, int createFlag) override;
+
+  void unpinPage(Page *page, bool discard) override;
+
+  void changePageId(Page *page, unsigned newPageId) override;
+
+  void discardPages(unsigned pageIdLimit) override;
+
+  bool evictPage() override;
+
+private:
+  struct ARCReplacementPage : public Page {
+    ARCReplacementPage(void *buffer, void *extra, unsigned pageId,
+                       bool pinned);
+
+    bool pinned;
+    bool inT2;
+    ARCReplacementPage *prev;
+    ARCReplacementPage *next;
+  };
+
+  struct GhostEntry {
+    GhostEntry *prev;
+    GhostEntry *next;
+    unsigned pageId;
+    bool inB2;
+  };
+
+  ARCReplacementPage *selectVictim(bool missInB2) const;
+
+  static ARCReplacementPage *
+  leastRecentUnpinned(const RecencyList<ARCReplacementPage> &list);
+
+  void retirePage(ARCReplacementPage *page);
+
+  void removePage(ARCReplacementPage *page);
+
+  void addGhost(unsigned pageId, bool inB2);
+
+  void removeGhost(GhostEntry *ghost);
+
+  void trimGhosts();
+
+  PageTable<ARCReplacementPage> cachedPages;
+
+  PageTable<GhostEntry> ghostEntries;
+
+  /** Storage for ghost entries. Freed entries are kept in `freeGhosts`. */
+  std::deque<GhostEntry> ghostStorage;
+
+  std::vector<GhostEntry *> freeGhosts;
+
+  RecencyList<ARCReplacementPage> t1;
+
+  RecencyList<ARCReplacementPage> t2;
+
+  RecencyList<GhostEntry> b1;
+
+  RecencyList<GhostEntry> b2;
+
+  /** Target size of T1, between zero and the maximum number of pages. */
+  int targetT1Size;
+};
+
+#endif
@@ -0,0 +1,261 @@
+#include "page_cache_array_lru.hpp"
+
+#include <algorithm>
+
+/**
+ * Construct an array LRU replacement policy Page.
+ * @param argBuffer - Page buffer.
+ * @param argExtra - Extra space.
+ * @param argPageId - Page ID.
+ */
+ArrayLRUReplacementPageCache::ArrayLRUPage::ArrayLRUPage(void *argBuffer,
+                                                         void *argExtra,
+                                                         unsigned argPageId)
+    : Page(argBuffer, argExtra, argPageId), slot(0) {}
+
+/**
+ * Construct a PageCache.
+ * @param pageSize - Page size in bytes. Assumed to be a power of two.
+ * @param extraSize - Extra space in bytes. Assumed to be less than 250.
+ */
+ArrayLRUReplacementPageCache::ArrayLRUReplacementPageCache(int pageSize,
+                                                           int extraSize)
+    : PageCache(pageSize, extraSize, sizeof(ArrayLRUPage)), nextStamp(0) {}
+
+/**
+ * Destructor of PageCache.
+ */
+ArrayLRUReplacementPageCache::~ArrayLRUReplacementPageCache() {
+  for (auto page : pages) {
+    deletePage(page);
+  }
+  pages.clear();
+  cachedPages.clear();
+}
+
+/**
+ * Set the maximum number of pages in the cache. Discard unpinned pages until
+ * either the number of pages in the cache is less than or equal to
+ * `maxNumPages` or all the pages in the cache are pinned. If there are still
+ * too many pages after discarding all unpinned pages, pages will continue to
+ * be discarded after being unpinned in the `unpinPage` function.
+ * @param maxNumPages - Maximum number of pages in the cache.
+ */
+void ArrayLRUReplacementPageCache::setMaxNumPages(int maxNumPages) {
+  maxNumPages_ = maxNumPages;
+  while (getNumPages() > maxNumPages && evictPage()) {
+  }
+}
+
+/**
+ * Fetch and pin a page that is not in the cache. If `createFlag` is 0,
+ * return a null pointer. Otherwise, examine the number of pages in the cache.
+ * If the number of pages in the cache is less than the maximum, allocate and
+ * return a pointer to a new page. If the number of pages in the cache is
+ * greater than or equal to the maximum, return a pointer to an existing
+ * unpinned page. If all pages are pinned, return a null pointer if
+ * `createFlag` is 1, or allocate a page beyond the maximum if it is 2.
+ * @param pageId - Page ID.
+ * @param createFlag - 0, 1 or 2, as passed to `xFetch`.
+ * @return Pointer to a page. May be null.
+ */
+Page *ArrayLRUReplacementPageCache::fetchMissingPage(unsigned pageId,
+                                                     int createFlag) {
+  // 'createFlag' 0, SQLite takes the page as not cached
+  if (createFlag == 0) {
+    forgetVictim(pageId);
+    return nullptr;
+  }
+  // Number of pages < maximum
+  if (getNumPages() < maxNumPages_) {
+    auto page = newPage<ArrayLRUPage>(pageId);
+    // Null if the page pool is out of memory, replace a page instead
+    if (page != nullptr) {
+      addSlot(page);
+      return page;
+    }
+  }
+  // Number of pages >= maximum, replace the least recently unpinned page
+  auto replacement = selectVictim();
+  // All pages pinned, grow beyond the maximum if SQLite insists
+  if (replacement == nullptr) {
+    if (createFlag != 2) {
+      return nullptr;
+    }
+    auto page = newPageBeyondLimit<ArrayLRUPage>(pageId);
+    addSlot(page);
+    return page;
+  }
+  counters_.recordEviction();
+  // The victim tier may keep the slot of the victim, so the page gets its own.
+  // The victim leaves the arrays first: allocating the slot may evict from
+  // this cache, which must neither pick the victim again nor find it moved.
+  if (keepsVictims()) {
+    removePage(replacement);
+    deleteVictim(replacement);
+    auto page = newPageBeyondLimit<ArrayLRUPage>(pageId);
+    addSlot(page);
+    return page;
+  }
+  auto slot = replacement->slot;
+  cachedPages.erase(pageIds[slot]);
+  replacement->reset();
+  replacement->pageId = pageId;
+  stamps[slot] = kPinnedStamp;
+  pageIds[slot] = pageId;
+  cachedPages.insert(pageId, replacement);
+  countPin();
+  return replacement;
+}
+
+/**
+ * Remove a page that is being unpinned from the cache.
+ * @param page - Pointer to a page.
+ * @param discard - Whether SQLite discarded the page. If not, the page is
+ * evicted, and the victim tier may keep it.
+ */
+void ArrayLRUReplacementPageCache::dropUnpinnedPage(ArrayLRUPage *page,
+                                                    bool discard) {
+  removePage(page);
+  if (discard) {
+    deletePage(page);
+  }
+  else {
+    counters_.recordEviction();
+    deleteVictim(page);
+  }
+}
+
+/**
+ * Change the page ID associated with a page. If a page with page ID
+ * `newPageId` is already in the cache, it is assumed that the page is
+ * unpinned, and the page is discarded.
+ * @param page - Pointer to a page.
+ * @param newPageId - New page ID.
+ */
+void ArrayLRUReplacementPageCache::changePageId(Page *page,
+                                                unsigned newPageId) {
+  auto *thisPage = (ArrayLRUPage *)page;
+  auto searchedPage = cachedPages.find(newPageId);
+  // Page found, already in cache, having 'newPageId' as its page ID. Discard.
+  if (searchedPage != nullptr && searchedPage != thisPage) {
+    removePage(searchedPage);
+    deletePage(searchedPage);
+  }
+  // The victim tier's image of the new page ID is out of date
+  forgetVictim(newPageId);
+  // Change page ID
+  cachedPages.erase(thisPage->pageId);
+  thisPage->pageId = newPageId;
+  pageIds[thisPage->slot] = newPageId;
+  cachedPages.insert(newPageId, thisPage);
+}
+
+/**
+ * Discard all pages with page IDs greater than or equal to `pageIdLimit`. If
+ * any of these pages are pinned, then they are implicitly unpinned, meaning
+ * they can be safely discarded.
+ * @param pageIdLimit - Page ID limit.
+ */
+void ArrayLRUReplacementPageCache::discardPages(unsigned pageIdLimit) {
+  forgetVictims(pageIdLimit);
+  cachedPages.eraseFrom(pageIdLimit, [this](unsigned, ArrayLRUPage *page) {
+    if (stamps[page->slot] == kPinnedStamp) {
+      countUnpin();
+    }
+    removeSlot(page);
+    deletePage(page);
+  });
+}
+
+/**
+ * Discard the unpinned page that the replacement policy would replace next.
+ * @return True if a page was discarded, false if all pages are pinned.
+ */
+bool ArrayLRUReplacementPageCache::evictPage() {
+  auto victim = selectVictim();
+  if (victim == nullptr) {
+    return false;
+  }
+  removePage(victim);
+  deleteVictim(victim);
+  counters_.recordEviction();
+  return true;
+}
+
+/**
+ * Append a new pinned page to the arrays and the page table.
+ * @param page - Pointer to a page not in the cache.
+ */
+void ArrayLRUReplacementPageCache::addSlot(ArrayLRUPage *page) {
+  page->slot = (std::uint32_t)pages.size();
+  stamps.push_back(kPinnedStamp);
+  pageIds.push_back(page->pageId);
+  pages.push_back(page);
+  cachedPages.insert(page->pageId, page);
+  countPin();
+}
+
+/**
+ * Find the least recently unpinned page.
+ * @return Pointer to an unpinned page, or null if all pages are pinned.
+ */
+ArrayLRUReplacementPageCache::ArrayLRUPage *
+ArrayLRUReplacementPageCache::selectVictim() {
+  // All pages pinned
+  if (numPinnedPages_ >= getNumPages()) {
+    return nullptr;
+  }
+  auto slot = findOldestSlot(stamps.data(), stamps.size());
+  return slot < pages.size() ? pages[slot] : nullptr;
+}
+
+/**
+ * Remove a page from the cache, leaving it to the caller to destroy.
+ * @param page - Pointer to a page in the cache.
+ */
+void ArrayLRUReplacementPageCache::removePage(ArrayLRUPage *page) {
+  if (stamps[page->slot] == kPinnedStamp) {
+    countUnpin();
+  }
+  cachedPages.erase(page->pageId);
+  removeSlot(page);
+}
+
+/**
+ * Remove a page from the arrays by moving the last slot into its slot, so the
+ * arrays stay dense.
+ * @param page - Pointer to a page in the arrays.
+ */
+void ArrayLRUReplacementPageCache::removeSlot(ArrayLRUPage *page) {
+  auto slot = page->slot;
+  auto last = pages.back();
+  last->slot = slot;
+  pages[slot] = last;
+  stamps[slot] = stamps.back();
+  pageIds[slot] = pageIds.back();
+  pages.pop_back();
+  stamps.pop_back();
+  pageIds.pop_back();
+}
+
+/**
+ * Renumber the stamps of the unpinned pages from zero, keeping their order,
+ * once the stamps run out. Happens once in four billion unpinnings.
+ */
+void ArrayLRUReplacementPageCache::renumberStamps() {
+  std::vector<std::uint32_t> unpinnedSlots;
+  for (std::uint32_t slot = 0; slot < stamps.size(); ++slot) {
+    if (stamps[slot] != kPinnedStamp) {
+      unpinnedSlots.push_back(slot);
+    }
+  }
+  std::sort(unpinnedSlots.begin(), unpinnedSlots.end(),
+            [this](std::uint32_t a, std::uint32_t b) {
+              return stamps[a] < stamps[b];
+            });
+  nextStamp = 0;
+  for (auto slot : unpinnedSlots) {
+    stamps[slot] = nextStamp++;
+  }
+}
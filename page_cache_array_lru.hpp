@@ -0,0 +1,133 @@
+#ifndef PAGE_CACHE_ARRAY_LRU_HPP
+#define PAGE_CACHE_ARRAY_LRU_HPP
+
+#include "page_cache.hpp"
+#include "page_table.hpp"
+#include "victim_search.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * LRU replacement with its metadata in dense parallel arrays rather than in
+ * the page objects: for each slot, the stamp of the page's last unpinning and
+ * its page ID. A pinned page has the stamp `kPinnedStamp`, so the pin flag
+ * needs no array of its own. The victim is the slot with the smallest stamp,
+ * found by a vectorized search over the stamps, which reads them 32 at a time
+ * without touching a page object. Hits and unpins write one stamp. The
+ * choices are those of a list-based LRU without scan detection, but a miss
+ * on a full cache searches every slot, so past a few hundred pages the list
+ * replaces pages faster.
+ */
+class ArrayLRUReplacementPageCache final : public PageCache {
+public:
+  ArrayLRUReplacementPageCache(int pageSize, int extraSize);
+
+  ~ArrayLRUReplacementPageCache() override;
+
+  void setMaxNumPages(int maxNumPages) override;
+
+  /**
+   * Get the number of pages in the cache, both pinned and unpinned.
+   * @return Number of pages in the cache.
+   */
+  [[nodiscard]] int getNumPages() const override { return (int)pages.size(); }
+
+  /**
+   * Fetch and pin a page. If the page is already in the cache, mark its slot
+   * pinned and return a pointer to it. Otherwise, proceed as
+   * `fetchMissingPage` does.
+   * @param pageId - Page ID.
+   * @param createFlag - 0, 1 or 2, as passed to `xFetch`.
+   * @return Pointer to a page. May be null.
+   */
+  Page *fetchPage(unsigned pageId, int createFlag) override {
+    ++numFetches_;
+    auto page = cachedPages.find(pageId);
+    if (page == nullptr) {
+      return fetchMissingPage(pageId, createFlag);
+    }
+    auto &stamp = stamps[page->slot];
+    if (stamp != kPinnedStamp) {
+      countPin();
+      stamp = kPinnedStamp;
+    }
+    ++numHits_;
+    return page;
+  }
+
+  /**
+   * Unpin a page. The page is unpinned regardless of the number of prior
+   * fetches, meaning it can be safely discarded. If `discard` is true, discard
+   * the page. If `discard` is false, examine the number of pages in the cache.
+   * If the number of pages in the cache is greater than the maximum, discard
+   * the page.
+   * @param page - Pointer to a page.
+   * @param discard - Discard the page.
+   */
+  void unpinPage(Page *page, bool discard) override {
+    auto *thisPage = (ArrayLRUPage *)page;
+    // Discard page if 'discard' true or number of pages greater than maximum
+    if (discard || getNumPages() > maxNumPages_) {
+      dropUnpinnedPage(thisPage, discard);
+    }
+    else {
+      if (nextStamp == kPinnedStamp) {
+        renumberStamps();
+      }
+      stamps[thisPage->slot] = nextStamp++;
+      countUnpin();
+    }
+  }
+
+  void changePageId(Page *page, unsigned newPageId) override;
+
+  void discardPages(unsigned pageIdLimit) override;
+
+  bool evictPage() override;
+
+  /**
+   * Set the stamp of the next unpinning, so that tests can run the stamps out
+   * and make the cache renumber them.
+   * @param stamp - Stamp, less than `kPinnedStamp`.
+   */
+  void setNextStamp(std::uint32_t stamp) { nextStamp = stamp; }
+
+private:
+  struct ArrayLRUPage : public Page {
+    ArrayLRUPage(void *buffer, void *extra, unsigned pageId);
+
+    /** Index of the page in the arrays of the cache. */
+    std::uint32_t slot;
+  };
+
+  Page *fetchMissingPage(unsigned pageId, int createFlag);
+
+  void dropUnpinnedPage(ArrayLRUPage *page, bool discard);
+
+  void addSlot(ArrayLRUPage *page);
+
+  ArrayLRUPage *selectVictim();
+
+  void removePage(ArrayLRUPage *page);
+
+  void removeSlot(ArrayLRUPage *page);
+
+  void renumberStamps();
+
+  PageTable<ArrayLRUPage> cachedPages;
+
+  /** Stamp of each slot: `kPinnedStamp`, or when the page was unpinned. */
+  std::vector<std::uint32_t> stamps;
+
+  /** Page ID of each slot. */
+  std::vector<std::uint32_t> pageIds;
+
+  /** Page of each slot. */
+  std::vector<ArrayLRUPage *> pages;
+
+  /** Stamp of the next unpinning. */
+  std::uint32_t nextStamp;
+};
+
+#endif
@@ -0,0 +1,842 @@
+/**
+ * Microbenchmarks for the `PageCache` implementations. Each result is printed
+ * as one JSON object per line, so runs on different commits can be compared
+ * with standard tools.
+ *
+ *   page_cache_bench [--policies p,...] [--scenarios s,...]
+ *                    [--distributions d,...] [--sizes n,...] [--ops n]
+ *                    [--threads n,...] [--page-size n]
+ *
+ * Scenarios, each timed per operation:
+ *   hit        fetchPage and unpinPage of a resident page
+ *   miss       fetchPage and unpinPage over four times as many page IDs as
+ *              fit, so most fetches evict
+ *   pinned     fetchPage of a new page while every page is pinned, which
+ *              fails
+ *   rekey      changePageId of a pinned page to an unused page ID
+ *   truncate   discardPages dropping the 16 highest page IDs
+ *   concurrent the miss scenario from 1 to 32 threads on one cache, behind a
+ *              mutex unless the policy is sharded, also timed as a whole to
+ *              give the throughput of all the threads
+ *   dispatch   the hit scenario with the calls made through `PageCache`,
+ *              which are virtual, and through the policy's own type, as
+ *              `PageCacheMethods` makes them, timed in batches of 64
+ *   table      PageTable lookups against std::unordered_map
+ *   victim     a search for the least recently unpinned of every page, one
+ *              in 16 pinned, with each kernel of `findOldestSlot` over dense
+ *              stamps and with a scan through pointers to page objects in a
+ *              `PageAllocator`, where a CLOCK-style policy keeps its metadata
+ *
+ * Distributions of the page IDs: uniform, zipfian (theta 0.99), sequential
+ * (a scan that wraps around), looping (a loop over 10% more pages than fit)
+ * and mixed (zipfian lookups over half the page IDs, taking turns with scans
+ * through the other half, each as long as the cache). Latencies have the cost
+ * of reading the clock subtracted.
+ * Allocations count calls of the global operator new in the timed region.
+ */
+
+#include "page_allocator.hpp"
+#include "page_cache_policies.hpp"
+#include "page_table.hpp"
+#include "victim_search.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+std::atomic<unsigned long long> numAllocations(0);
+
+std::atomic<unsigned long long> numAllocatedBytes(0);
+
+void *countedAllocate(std::size_t size, std::size_t alignment) {
+  numAllocations.fetch_add(1, std::memory_order_relaxed);
+  numAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+  void *memory = nullptr;
+  if (alignment <= alignof(std::max_align_t)) {
+    memory = std::malloc(size > 0 ? size : 1);
+  }
+  else if (posix_memalign(&memory, alignment, size > 0 ? size : 1) != 0) {
+    memory = nullptr;
+  }
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+} // namespace
+
+void *operator new(std::size_t size) {
+  return countedAllocate(size, alignof(std::max_align_t));
+}
+
+void *operator new[](std::size_t size) {
+  return countedAllocate(size, alignof(std::max_align_t));
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+  return countedAllocate(size, (std::size_t)alignment);
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+  return countedAllocate(size, (std::size_t)alignment);
+}
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+
+void operator delete[](void *memory) noexcept { std::free(memory); }
+
+void operator delete(void *memory, std::size_t) noexcept { std::free(memory); }
+
+void operator delete[](void *memory, std::size_t) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void *memory, std::align_val_t) noexcept {
+  std::free(memory);
+}
+
+void operator delete[](void *memory, std::align_val_t) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t, std::align_val_t) noexcept {
+  std::free(memory);
+}
+
+void operator delete[](void *memory, std::size_t, std::align_val_t) noexcept {
+  std::free(memory);
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kExtraSize = 48;
+
+constexpr unsigned kTruncatedPages = 16;
+
+/** Fetches timed together by the dispatch scenario. */
+constexpr std::size_t kDispatchBatchSize = 64;
+
+/** Pinned-page and truncate runs stop after this many page visits. */
+constexpr unsigned long long kMaxScanWork = 200000000;
+
+/** Pages a cache may hold beyond its maximum: one per shard of a small
+ * sharded cache. */
+constexpr unsigned kMaxExtraPinnedPages = 64;
+
+struct Options {
+  std::vector<const PageCachePolicy *> policies;
+  std::vector<std::string> scenarios = {
+      "hit",        "miss",     "pinned", "rekey", "truncate",
+      "concurrent", "dispatch", "table", "victim"};
+  std::vector<std::string> distributions = {"uniform", "zipfian", "sequential",
+                                            "looping", "mixed"};
+  std::vector<int> sizes = {100, 1000, 10000, 100000, 1000000};
+  std::vector<unsigned> threadCounts = {1, 2, 4, 8, 16, 32};
+  unsigned numOps = 200000;
+  int pageSize = 1024;
+};
+
+/** Latencies and counters of one benchmark run. */
+class Measurement {
+public:
+  explicit Measurement(std::size_t numOps) { latencies_.reserve(numOps); }
+
+  void begin() {
+    startAllocations_ = numAllocations.load();
+    startBytes_ = numAllocatedBytes.load();
+  }
+
+  void end() {
+    allocations_ += numAllocations.load() - startAllocations_;
+    bytes_ += numAllocatedBytes.load() - startBytes_;
+  }
+
+  void add(Clock::duration latency) {
+    latencies_.push_back(
+        std::chrono::duration<double, std::nano>(latency).count());
+  }
+
+  void merge(const Measurement &other) {
+    latencies_.insert(latencies_.end(), other.latencies_.begin(),
+                      other.latencies_.end());
+    allocations_ += other.allocations_;
+    bytes_ += other.bytes_;
+  }
+
+  /**
+   * Set the wall time of the whole run, so that the throughput of the run is
+   * printed as well.
+   * @param wallTime - Time from the start of the first operation to the end
+   * of the last.
+   */
+  void setWallTime(Clock::duration wallTime) { wallTime_ = wallTime; }
+
+  /**
+   * Print the run as one JSON object.
+   * @param label - JSON members naming the run, without braces.
+   * @param hitRatio - Hit ratio, or a negative value if it does not apply.
+   * @param clockOverhead - Nanoseconds to subtract from every latency.
+   */
+  void print(const std::string &label, double hitRatio,
+             double clockOverhead) {
+    auto numOps = latencies_.size();
+    if (numOps == 0) {
+      return;
+    }
+    for (auto &latency : latencies_) {
+      latency = std::max(latency - clockOverhead, 0.0);
+    }
+    std::sort(latencies_.begin(), latencies_.end());
+    double total = 0;
+    for (auto latency : latencies_) {
+      total += latency;
+    }
+    auto percentile = [&](double fraction) {
+      return latencies_[std::min(numOps - 1, (std::size_t)(fraction * numOps))];
+    };
+    std::printf("{%s,\"ops\":%zu", label.c_str(), numOps);
+    if (hitRatio >= 0) {
+      std::printf(",\"hit_ratio\":%.4f", hitRatio);
+    }
+    if (wallTime_.count() > 0) {
+      std::printf(",\"ops_per_s\":%.0f",
+                  (double)numOps /
+                      std::chrono::duration<double>(wallTime_).count());
+    }
+    std::printf(",\"ns_mean\":%.1f,\"ns_p50\":%.1f,\"ns_p90\":%.1f,"
+                "\"ns_p99\":%.1f,\"ns_p999\":%.1f,\"ns_max\":%.1f,"
+                "\"allocs_per_op\":%.4f,\"bytes_per_op\":%.1f}\n",
+                total / (double)numOps, percentile(0.5), percentile(0.9),
+                percentile(0.99), percentile(0.999), latencies_.back(),
+                (double)allocations_ / (double)numOps,
+                (double)bytes_ / (double)numOps);
+    std::fflush(stdout);
+  }
+
+private:
+  std::vector<double> latencies_;
+  unsigned long long startAllocations_ = 0;
+  unsigned long long startBytes_ = 0;
+  unsigned long long allocations_ = 0;
+  unsigned long long bytes_ = 0;
+  Clock::duration wallTime_{};
+};
+
+/**
+ * Zipfian ranks in [0, n), generated as in YCSB (Gray et al., "Quickly
+ * generating billion-record synthetic databases").
+ */
+class ZipfianGenerator {
+public:
+  ZipfianGenerator(unsigned n, double theta) : n_(n), theta_(theta) {
+    double zetaN = 0;
+    for (unsigned i = 1; i <= n; ++i) {
+      zetaN += 1 / std::pow((double)i, theta);
+    }
+    double zeta2 = 1 + 1 / std::pow(2.0, theta);
+    alpha_ = 1 / (1 - theta);
+    zetaN_ = zetaN;
+    eta_ = (1 - std::pow(2.0 / n, 1 - theta)) / (1 - zeta2 / zetaN);
+  }
+
+  unsigned operator()(std::mt19937_64 &random) {
+    double u = std::uniform_real_distribution<double>(0, 1)(random);
+    double uz = u * zetaN_;
+    if (uz < 1) {
+      return 0;
+    }
+    if (uz < 1 + std::pow(0.5, theta_)) {
+      return std::min(1u, n_ - 1);
+    }
+    return std::min(n_ - 1, (unsigned)(n_ * std::pow(eta_ * u - eta_ + 1,
+                                                     alpha_)));
+  }
+
+private:
+  unsigned n_;
+  double theta_;
+  double alpha_;
+  double zetaN_;
+  double eta_;
+};
+
+/**
+ * Generate page IDs in [1, keySpace].
+ * @param distribution - Name of the distribution.
+ * @param keySpace - Number of distinct page IDs.
+ * @param cacheSize - Number of pages that fit, for the looping and mixed
+ * distributions.
+ * @param numOps - Number of page IDs to generate.
+ * @param seed - Seed of the generator.
+ * @return Page IDs.
+ */
+std::vector<unsigned> generatePageIds(const std::string &distribution,
+                                      unsigned keySpace, unsigned cacheSize,
+                                      unsigned numOps, unsigned seed) {
+  std::vector<unsigned> pageIds(numOps);
+  std::mt19937_64 random(seed);
+  if (distribution == "uniform") {
+    std::uniform_int_distribution<unsigned> uniform(0, keySpace - 1);
+    for (auto &pageId : pageIds) {
+      pageId = uniform(random) + 1;
+    }
+  }
+  else if (distribution == "zipfian") {
+    // Scatter the popular ranks over the key space, so they do not all share
+    // one shard or one end of the page ID range.
+    ZipfianGenerator zipfian(keySpace, 0.99);
+    for (auto &pageId : pageIds) {
+      pageId = (unsigned)((zipfian(random) * 2654435761ull) % keySpace) + 1;
+    }
+  }
+  else if (distribution == "sequential") {
+    for (unsigned i = 0; i < numOps; ++i) {
+      pageIds[i] = i % keySpace + 1;
+    }
+  }
+  else if (distribution == "mixed") {
+    // Point lookups on the first half of the page IDs, then a scan through
+    // the second half that picks up where the last one stopped
+    auto numLookupPages = std::max(keySpace / 2, 1u);
+    auto numScanPages = std::max(keySpace - numLookupPages, 1u);
+    ZipfianGenerator zipfian(numLookupPages, 0.99);
+    unsigned scanPosition = 0;
+    for (unsigned i = 0; i < numOps;) {
+      for (unsigned j = 0; j < cacheSize && i < numOps; ++j, ++i) {
+        pageIds[i] =
+            (unsigned)((zipfian(random) * 2654435761ull) % numLookupPages) + 1;
+      }
+      for (unsigned j = 0; j < cacheSize && i < numOps; ++j, ++i) {
+        pageIds[i] = numLookupPages + scanPosition + 1;
+        scanPosition = (scanPosition + 1) % numScanPages;
+      }
+    }
+  }
+  else {
+    auto loopLength = std::min(keySpace, cacheSize + cacheSize / 10 + 1);
+    for (unsigned i = 0; i < numOps; ++i) {
+      pageIds[i] = i % loopLength + 1;
+    }
+  }
+  return pageIds;
+}
+
+/** Measure how long reading the clock twice takes. */
+double measureClockOverhead() {
+  std::vector<double> samples(10000);
+  for (auto &sample : samples) {
+    auto start = Clock::now();
+    auto stop = Clock::now();
+    sample = std::chrono::duration<double, std::nano>(stop - start).count();
+  }
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+std::string makeLabel(const char *policy, const std::string &scenario,
+                      const std::string &distribution, int size,
+                      unsigned numThreads) {
+  std::ostringstream label;
+  label << "\"policy\":\"" << policy << "\",\"scenario\":\"" << scenario
+        << "\",\"distribution\":\"" << distribution << "\",\"size\":" << size
+        << ",\"threads\":" << numThreads;
+  return label.str();
+}
+
+std::unique_ptr<PageCache> makeFilledPageCache(const PageCachePolicy &policy,
+                                               const Options &options,
+                                               int size) {
+  auto pageCache = policy.factory(options.pageSize, kExtraSize);
+  pageCache->setMaxNumPages(size);
+  for (unsigned pageId = 1; pageId <= (unsigned)size; ++pageId) {
+    auto page = pageCache->fetchPage(pageId, 1);
+    if (page != nullptr) {
+      pageCache->unpinPage(page, false);
+    }
+  }
+  return pageCache;
+}
+
+/**
+ * Fetch and unpin every page ID in turn.
+ * @return Hit ratio.
+ */
+double runFetches(PageCache &pageCache, const std::vector<unsigned> &pageIds,
+                  Measurement &measurement) {
+  auto numFetches = pageCache.getNumFetches();
+  auto numHits = pageCache.getNumHits();
+  measurement.begin();
+  for (auto pageId : pageIds) {
+    auto start = Clock::now();
+    auto page = pageCache.fetchPage(pageId, 1);
+    if (page != nullptr) {
+      pageCache.unpinPage(page, false);
+    }
+    measurement.add(Clock::now() - start);
+  }
+  measurement.end();
+  return (double)(pageCache.getNumHits() - numHits) /
+         (double)(pageCache.getNumFetches() - numFetches);
+}
+
+void benchmarkFetches(const PageCachePolicy &policy, const Options &options,
+                      const std::string &scenario, int size,
+                      double clockOverhead) {
+  auto keySpace = scenario == "hit" ? (unsigned)size : 4 * (unsigned)size;
+  for (const auto &distribution : options.distributions) {
+    auto pageCache = makeFilledPageCache(policy, options, size);
+    auto pageIds = generatePageIds(distribution, keySpace, size,
+                                   options.numOps, 1);
+    // Warm up, so the policy's state reflects the distribution
+    Measurement warmUp(pageIds.size());
+    runFetches(*pageCache, pageIds, warmUp);
+    Measurement measurement(pageIds.size());
+    auto hitRatio = runFetches(*pageCache, pageIds, measurement);
+    measurement.print(makeLabel(policy.name, scenario, distribution, size, 1),
+                      hitRatio, clockOverhead);
+  }
+}
+
+void benchmarkPinned(const PageCachePolicy &policy, const Options &options,
+                     int size, double clockOverhead) {
+  auto pageCache = policy.factory(options.pageSize, kExtraSize);
+  pageCache->setMaxNumPages(size);
+  // A sharded cache smaller than its number of shards keeps a page in every
+  // shard, so pin new pages until the cache is full rather than `size` pages
+  unsigned nextPageId = 1;
+  while (nextPageId <= (unsigned)size + kMaxExtraPinnedPages &&
+         pageCache->fetchPage(nextPageId, 1) != nullptr) {
+    ++nextPageId;
+  }
+  auto numOps = (unsigned)std::min<unsigned long long>(
+      options.numOps, std::max<unsigned long long>(kMaxScanWork / size, 100));
+  Measurement measurement(numOps);
+  measurement.begin();
+  for (unsigned i = 0; i < numOps; ++i) {
+    auto start = Clock::now();
+    auto page = pageCache->fetchPage(nextPageId + i, 1);
+    measurement.add(Clock::now() - start);
+    if (page != nullptr) {
+      std::fprintf(stderr, "%s: fetch succeeded with every page pinned\n",
+                   policy.name);
+      break;
+    }
+  }
+  measurement.end();
+  measurement.print(makeLabel(policy.name, "pinned", "none", size, 1), -1,
+                    clockOverhead);
+  pageCache->discardPages(0);
+}
+
+void benchmarkRekey(const PageCachePolicy &policy, const Options &options,
+                    int size, double clockOverhead) {
+  for (const auto &distribution : options.distributions) {
+    auto pageCache = makeFilledPageCache(policy, options, size);
+    // Slot i holds page ID i + 1 or i + 1 + size, so every rekey moves a page
+    // to a page ID that is not in the cache.
+    std::vector<unsigned> currentPageIds(size);
+    for (int i = 0; i < size; ++i) {
+      currentPageIds[i] = i + 1;
+    }
+    auto slots = generatePageIds(distribution, size, size, options.numOps, 2);
+    Measurement measurement(slots.size());
+    measurement.begin();
+    for (auto slot : slots) {
+      auto &pageId = currentPageIds[slot - 1];
+      auto page = pageCache->fetchPage(pageId, 0);
+      if (page == nullptr) {
+        continue;
+      }
+      auto newPageId = pageId <= (unsigned)size ? pageId + size : pageId - size;
+      auto start = Clock::now();
+      pageCache->changePageId(page, newPageId);
+      measurement.add(Clock::now() - start);
+      pageCache->unpinPage(page, false);
+      pageId = newPageId;
+    }
+    measurement.end();
+    measurement.print(makeLabel(policy.name, "rekey", distribution, size, 1),
+                      -1, clockOverhead);
+  }
+}
+
+void benchmarkTruncate(const PageCachePolicy &policy, const Options &options,
+                       int size, double clockOverhead) {
+  auto pageCache = makeFilledPageCache(policy, options, size);
+  auto numTruncated = std::min(kTruncatedPages, (unsigned)size);
+  auto numOps = (unsigned)std::min<unsigned long long>(
+      options.numOps, std::max<unsigned long long>(kMaxScanWork / size, 100));
+  Measurement measurement(numOps);
+  for (unsigned i = 0; i < numOps; ++i) {
+    measurement.begin();
+    auto start = Clock::now();
+    pageCache->discardPages(size - numTruncated + 1);
+    measurement.add(Clock::now() - start);
+    measurement.end();
+    for (auto pageId = size - numTruncated + 1; pageId <= (unsigned)size;
+         ++pageId) {
+      auto page = pageCache->fetchPage(pageId, 1);
+      if (page != nullptr) {
+        pageCache->unpinPage(page, false);
+      }
+    }
+  }
+  measurement.print(makeLabel(policy.name, "truncate", "none", size, 1), -1,
+                    clockOverhead);
+}
+
+void benchmarkConcurrent(const PageCachePolicy &policy, const Options &options,
+                         int size, double clockOverhead) {
+  // Sharded caches lock their shards themselves. The others are serialized
+  // by one mutex, as PageCacheMethods does through the page pool.
+  bool sharded = std::string(policy.name).compare(0, 8, "sharded-") == 0;
+  for (auto numThreads : options.threadCounts) {
+    for (const auto &distribution : options.distributions) {
+      auto pageCache = makeFilledPageCache(policy, options, size);
+      std::mutex mutex;
+      std::vector<std::vector<unsigned>> pageIds;
+      std::vector<Measurement> measurements;
+      for (unsigned i = 0; i < numThreads; ++i) {
+        pageIds.push_back(generatePageIds(distribution, 4 * (unsigned)size,
+                                          size, options.numOps, 3 + i));
+        measurements.emplace_back(options.numOps);
+      }
+      // The threads start together once all of them exist, so that the run
+      // is timed and its allocations counted once, without thread creation
+      std::atomic<unsigned> numReadyThreads(0);
+      std::atomic<bool> started(false);
+      std::vector<std::thread> threads;
+      for (unsigned i = 0; i < numThreads; ++i) {
+        threads.emplace_back([&, i] {
+          auto &measurement = measurements[i];
+          numReadyThreads.fetch_add(1);
+          while (!started.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+          }
+          for (auto pageId : pageIds[i]) {
+            auto start = Clock::now();
+            std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+            if (!sharded) {
+              lock.lock();
+            }
+            auto page = pageCache->fetchPage(pageId, 1);
+            if (page != nullptr) {
+              pageCache->unpinPage(page, false);
+            }
+            if (!sharded) {
+              lock.unlock();
+            }
+            measurement.add(Clock::now() - start);
+          }
+        });
+      }
+      while (numReadyThreads.load() < numThreads) {
+        std::this_thread::yield();
+      }
+      Measurement total(0);
+      total.begin();
+      auto start = Clock::now();
+      started.store(true, std::memory_order_release);
+      for (auto &thread : threads) {
+        thread.join();
+      }
+      total.setWallTime(Clock::now() - start);
+      total.end();
+      for (const auto &measurement : measurements) {
+        total.merge(measurement);
+      }
+      total.print(makeLabel(policy.name, "concurrent", distribution, size,
+                            numThreads),
+                  -1, clockOverhead);
+    }
+  }
+}
+
+/** Fetch and unpin each page ID in turn through virtual calls. */
+void fetchAllVirtual(PageCache &pageCache, const unsigned *pageIds,
+                     std::size_t numPageIds) {
+  for (std::size_t i = 0; i < numPageIds; ++i) {
+    auto page = pageCache.fetchPage(pageIds[i], 1);
+    if (page != nullptr) {
+      pageCache.unpinPage(page, false);
+    }
+  }
+}
+
+void benchmarkDispatch(const PageCachePolicy &policy, const Options &options,
+                       int size, double clockOverhead) {
+  for (const auto &distribution : options.distributions) {
+    auto pageIds = generatePageIds(distribution, (unsigned)size, size,
+                                   options.numOps, 5);
+    for (bool virtualCalls : {true, false}) {
+      auto pageCache = makeFilledPageCache(policy, options, size);
+      Measurement measurement(pageIds.size());
+      measurement.begin();
+      for (std::size_t i = 0; i < pageIds.size(); i += kDispatchBatchSize) {
+        auto numPageIds = std::min(kDispatchBatchSize, pageIds.size() - i);
+        auto start = Clock::now();
+        if (virtualCalls) {
+          fetchAllVirtual(*pageCache, &pageIds[i], numPageIds);
+        }
+        else {
+          policy.fetchLoop(*pageCache, &pageIds[i], numPageIds);
+        }
+        auto latency = (Clock::now() - start) / (Clock::rep)numPageIds;
+        for (std::size_t j = 0; j < numPageIds; ++j) {
+          measurement.add(latency);
+        }
+      }
+      measurement.end();
+      measurement.print(
+          makeLabel(policy.name,
+                    virtualCalls ? "dispatch-virtual" : "dispatch-static",
+                    distribution, size, 1),
+          -1, clockOverhead / (double)kDispatchBatchSize);
+    }
+  }
+}
+
+struct TablePage {};
+
+void benchmarkTable(const Options &options, int size, double clockOverhead) {
+  std::vector<TablePage> pages(size);
+  for (const auto &distribution : options.distributions) {
+    // Half of the lookups find a page
+    auto pageIds = generatePageIds(distribution, 2 * (unsigned)size, size,
+                                   options.numOps, 4);
+    {
+      PageTable<TablePage> table;
+      for (int i = 0; i < size; ++i) {
+        table.insert(i + 1, &pages[i]);
+      }
+      Measurement measurement(pageIds.size());
+      unsigned numFound = 0;
+      measurement.begin();
+      for (auto pageId : pageIds) {
+        auto start = Clock::now();
+        numFound += table.find(pageId) != nullptr;
+        measurement.add(Clock::now() - start);
+      }
+      measurement.end();
+      measurement.print(makeLabel("page-table", "table", distribution, size, 1),
+                        (double)numFound / (double)pageIds.size(),
+                        clockOverhead);
+    }
+    {
+      std::unordered_map<unsigned, TablePage *> table;
+      for (int i = 0; i < size; ++i) {
+        table.emplace(i + 1, &pages[i]);
+      }
+      Measurement measurement(pageIds.size());
+      unsigned numFound = 0;
+      measurement.begin();
+      for (auto pageId : pageIds) {
+        auto start = Clock::now();
+        numFound += table.find(pageId) != table.end();
+        measurement.add(Clock::now() - start);
+      }
+      measurement.end();
+      measurement.print(
+          makeLabel("unordered-map", "table", distribution, size, 1),
+          (double)numFound / (double)pageIds.size(), clockOverhead);
+    }
+  }
+}
+
+/** A page object with its stamp, for the victim search through pointers. */
+struct StampedPage {
+  std::uint32_t stamp;
+  void *links[4];
+};
+
+/** Find the page with the smallest stamp by following a pointer per page. */
+std::size_t findOldestPage(const std::vector<StampedPage *> &pages) {
+  auto oldest = pages.size();
+  auto oldestStamp = kPinnedStamp;
+  for (std::size_t slot = 0; slot < pages.size(); ++slot) {
+    if (pages[slot]->stamp < oldestStamp) {
+      oldestStamp = pages[slot]->stamp;
+      oldest = slot;
+    }
+  }
+  return oldest;
+}
+
+void benchmarkVictim(const Options &options, int size, double clockOverhead) {
+  std::vector<std::uint32_t> stamps((std::size_t)size);
+  for (std::size_t slot = 0; slot < stamps.size(); ++slot) {
+    stamps[slot] = (std::uint32_t)slot;
+  }
+  std::mt19937_64 random(6);
+  std::shuffle(stamps.begin(), stamps.end(), random);
+  for (std::size_t slot = 0; slot < stamps.size(); slot += 16) {
+    stamps[slot] = kPinnedStamp;
+  }
+  PageAllocator allocator(options.pageSize, kExtraSize, sizeof(StampedPage));
+  std::vector<StampedPage *> pages;
+  for (auto stamp : stamps) {
+    pages.push_back(new (allocator.allocate()) StampedPage{stamp, {}});
+  }
+  auto expected = getVictimSearchImplementations().back().kernel(
+      stamps.data(), stamps.size());
+  auto numOps = (unsigned)std::min<unsigned long long>(
+      options.numOps, std::max<unsigned long long>(kMaxScanWork / size, 100));
+  auto run = [&](const char *name, auto search) {
+    Measurement measurement(numOps);
+    measurement.begin();
+    for (unsigned i = 0; i < numOps; ++i) {
+      auto start = Clock::now();
+      auto slot = search();
+      measurement.add(Clock::now() - start);
+      if (slot != expected) {
+        std::fprintf(stderr, "%s: found slot %zu instead of %zu\n", name,
+                     slot, expected);
+        return;
+      }
+    }
+    measurement.end();
+    measurement.print(makeLabel(name, "victim", "none", size, 1), -1,
+                      clockOverhead);
+  };
+  for (const auto &implementation : getVictimSearchImplementations()) {
+    run(implementation.name, [&] {
+      return implementation.kernel(stamps.data(), stamps.size());
+    });
+  }
+  run("pointer-chasing", [&] { return findOldestPage(pages); });
+  for (auto page : pages) {
+    allocator.deallocate(page);
+  }
+}
+
+std::vector<std::string> splitList(const std::string &list) {
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+bool contains(const std::vector<std::string> &items, const char *item) {
+  return std::find(items.begin(), items.end(), item) != items.end();
+}
+
+bool parseOptions(int argc, char **argv, Options &options) {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string option = argv[i];
+    std::string value = argv[i + 1];
+    if (option == "--policies") {
+      for (const auto &name : splitList(value)) {
+        auto policy = findPageCachePolicy(name.c_str());
+        if (policy == nullptr) {
+          std::fprintf(stderr, "unknown policy: %s\n", name.c_str());
+          return false;
+        }
+        options.policies.push_back(policy);
+      }
+    }
+    else if (option == "--scenarios") {
+      options.scenarios = splitList(value);
+    }
+    else if (option == "--distributions") {
+      options.distributions = splitList(value);
+    }
+    else if (option == "--sizes") {
+      options.sizes.clear();
+      for (const auto &size : splitList(value)) {
+        options.sizes.push_back(std::max(std::atoi(size.c_str()), 1));
+      }
+    }
+    else if (option == "--threads") {
+      options.threadCounts.clear();
+      for (const auto &numThreads : splitList(value)) {
+        options.threadCounts.push_back(
+            (unsigned)std::max(std::atoi(numThreads.c_str()), 1));
+      }
+    }
+    else if (option == "--ops") {
+      options.numOps = (unsigned)std::max(std::atoi(value.c_str()), 1);
+    }
+    else if (option == "--page-size") {
+      options.pageSize = std::max(std::atoi(value.c_str()), 512);
+    }
+    else {
+      return false;
+    }
+  }
+  if (argc % 2 == 0) {
+    return false;
+  }
+  if (options.policies.empty()) {
+    for (const auto &policy : kPageCachePolicies) {
+      options.policies.push_back(&policy);
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    std::fprintf(stderr,
+                 "usage: page_cache_bench [--policies p,...] "
+                 "[--scenarios s,...] [--distributions d,...] "
+                 "[--sizes n,...] [--ops n] [--threads n,...] "
+                 "[--page-size n]\n");
+    return 1;
+  }
+  auto clockOverhead = measureClockOverhead();
+  for (auto size : options.sizes) {
+    if (contains(options.scenarios, "table")) {
+      benchmarkTable(options, size, clockOverhead);
+    }
+    if (contains(options.scenarios, "victim")) {
+      benchmarkVictim(options, size, clockOverhead);
+    }
+    for (auto policy : options.policies) {
+      for (const char *scenario : {"hit", "miss"}) {
+        if (contains(options.scenarios, scenario)) {
+          benchmarkFetches(*policy, options, scenario, size, clockOverhead);
+        }
+      }
+      if (contains(options.scenarios, "pinned")) {
+        benchmarkPinned(*policy, options, size, clockOverhead);
+      }
+      if (contains(options.scenarios, "rekey")) {
+        benchmarkRekey(*policy, options, size, clockOverhead);
+      }
+      if (contains(options.scenarios, "truncate")) {
+        benchmarkTruncate(*policy, options, size, clockOverhead);
+      }
+      if (contains(options.scenarios, "concurrent")) {
+        benchmarkConcurrent(*policy, options, size, clockOverhead);
+      }
+      if (contains(options.scenarios, "dispatch")) {
+        benchmarkDispatch(*policy, options, size, clockOverhead);
+      }
+    }
+  }
+  return 0;
+}
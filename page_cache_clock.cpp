@@ -0,0 +1,243 @@
+#include "page_cache_clock.hpp"
+
+/**
+ * Construct a CLOCK replacement policy Page.
+ * @param argBuffer - Page buffer.
+ * @param argExtra - Extra space.
+ * @param argPageId - Page ID.
+ * @param argPinned - The page's pin status.
+ */
+ClockReplacementPageCache::ClockReplacementPage::ClockReplacementPage(
+    void *argBuffer, void *argExtra, unsigned argPageId, bool argPinned)
+    : Page(argBuffer, argExtra, argPageId), pinned(argPinned),
+      referenced(false), slot(0) {}
+
+/**
+ * Construct a PageCache.
+ * @param pageSize - Page size in bytes. Assumed to be a power of two.
+ * @param extraSize - Extra space in bytes. Assumed to be less than 250.
+ */
+ClockReplacementPageCache::ClockReplacementPageCache(int pageSize,
+                                                     int extraSize)
+    : PageCache(pageSize, extraSize, sizeof(ClockReplacementPage)), hand(0) {}
+
+/**
+ * Destructor of PageCache.
+ */
+ClockReplacementPageCache::~ClockReplacementPageCache() {
+  for (auto page : slots) {
+    deletePage(page);
+  }
+  slots.clear();
+  cachedPages.clear();
+}
+
+/**
+ * Set the maximum number of pages in the cache. Discard unpinned pages until
+ * either the number of pages in the cache is less than or equal to
+ * `maxNumPages` or all the pages in the cache are pinned. If there are still
+ * too many pages after discarding all unpinned pages, pages will continue to
+ * be discarded after being unpinned in the `unpinPage` function.
+ * @param maxNumPages - Maximum number of pages in the cache.
+ */
+void ClockReplacementPageCache::setMaxNumPages(int maxNumPages) {
+  maxNumPages_ = maxNumPages;
+  while (getNumPages() > maxNumPages && evictPage()) {
+  }
+}
+
+/**
+ * Fetch and pin a page that is not in the cache. If `createFlag` is 0,
+ * return a null pointer. Otherwise, examine the number of pages in the cache.
+ * If the number of pages in the cache is less than the maximum, allocate and
+ * return a pointer to a new page. If the number of pages in the cache is
+ * greater than or equal to the maximum, return a pointer to an existing
+ * unpinned page. If all pages are pinned, return a null pointer if
+ * `createFlag` is 1, or allocate a page beyond the maximum if it is 2.
+ * @param pageId - Page ID.
+ * @param createFlag - 0, 1 or 2, as passed to `xFetch`.
+ * @return Pointer to a page. May be null.
+ */
+Page *ClockReplacementPageCache::fetchMissingPage(unsigned pageId,
+                                                  int createFlag) {
+  // 'createFlag' 0, SQLite takes the page as not cached
+  if (createFlag == 0) {
+    forgetVictim(pageId);
+    return nullptr;
+  }
+  // Number of pages < maximum
+  if (getNumPages() < maxNumPages_) {
+    auto page = newPage<ClockReplacementPage>(pageId, true);
+    // Null if the page pool is out of memory, replace a page instead
+    if (page != nullptr) {
+      page->slot = slots.size();
+      slots.push_back(page);
+      cachedPages.insert(pageId, page);
+      countPin();
+      return page;
+    }
+  }
+  // Number of pages >= maximum, replace the page under the hand
+  auto replacement = selectVictim();
+  // All pages pinned, grow beyond the maximum if SQLite insists
+  if (replacement == nullptr) {
+    if (createFlag != 2) {
+      return nullptr;
+    }
+    auto page = newPageBeyondLimit<ClockReplacementPage>(pageId, true);
+    page->slot = slots.size();
+    slots.push_back(page);
+    cachedPages.insert(pageId, page);
+    countPin();
+    return page;
+  }
+  counters_.recordEviction();
+  // The victim tier may keep the slot of the victim, so the page gets its own.
+  // The victim leaves the clock first: allocating the slot may evict from this
+  // cache, which must neither pick the victim again nor find it moved.
+  if (keepsVictims()) {
+    removePage(replacement);
+    deleteVictim(replacement);
+    replacement = newPageBeyondLimit<ClockReplacementPage>(pageId, true);
+    replacement->slot = slots.size();
+    slots.push_back(replacement);
+  }
+  else {
+    cachedPages.erase(replacement->pageId);
+    replacement->pinned = true;
+    replacement->reset();
+    replacement->pageId = pageId;
+  }
+  cachedPages.insert(pageId, replacement);
+  countPin();
+  return replacement;
+}
+
+/**
+ * Remove a page that is being unpinned from the cache.
+ * @param page - Pointer to a page.
+ * @param discard - Whether SQLite discarded the page. If not, the page is
+ * evicted, and the victim tier may keep it.
+ */
+void ClockReplacementPageCache::dropUnpinnedPage(ClockReplacementPage *page,
+                                                 bool discard) {
+  removePage(page);
+  if (discard) {
+    deletePage(page);
+  }
+  else {
+    counters_.recordEviction();
+    deleteVictim(page);
+  }
+}
+
+/**
+ * Change the page ID associated with a page. If a page with page ID
+ * `newPageId` is already in the cache, it is assumed that the page is
+ * unpinned, and the page is discarded.
+ * @param page - Pointer to a page.
+ * @param newPageId - New page ID.
+ */
+void ClockReplacementPageCache::changePageId(Page *page, unsigned newPageId) {
+  auto *thisPage = (ClockReplacementPage *)page;
+  auto searchedPage = cachedPages.find(newPageId);
+  // Page found, already in cache, having 'newPageId' as its page ID. Discard.
+  if (searchedPage != nullptr && searchedPage != thisPage) {
+    removePage(searchedPage);
+    deletePage(searchedPage);
+  }
+  // The victim tier's image of the new page ID is out of date
+  forgetVictim(newPageId);
+  // Change page ID
+  cachedPages.erase(thisPage->pageId);
+  thisPage->pageId = newPageId;
+  cachedPages.insert(newPageId, thisPage);
+}
+
+/**
+ * Discard all pages with page IDs greater than or equal to `pageIdLimit`. If
+ * any of these pages are pinned, then they are implicitly unpinned, meaning
+ * they can be safely discarded.
+ * @param pageIdLimit - Page ID limit.
+ */
+void ClockReplacementPageCache::discardPages(unsigned pageIdLimit) {
+  forgetVictims(pageIdLimit);
+  cachedPages.eraseFrom(
+      pageIdLimit, [this](unsigned, ClockReplacementPage *page) {
+        if (page->pinned) {
+          countUnpin();
+        }
+        removeSlot(page);
+        deletePage(page);
+      });
+}
+
+/**
+ * Discard the unpinned page that the replacement policy would replace next.
+ * @return True if a page was discarded, false if all pages are pinned.
+ */
+bool ClockReplacementPageCache::evictPage() {
+  auto victim = selectVictim();
+  if (victim == nullptr) {
+    return false;
+  }
+  removePage(victim);
+  deleteVictim(victim);
+  counters_.recordEviction();
+  return true;
+}
+
+/**
+ * Sweep the hand until it reaches an unpinned page whose reference bit is
+ * clear, clearing the reference bits of the unpinned pages it passes. Two
+ * revolutions are enough: the first clears every bit.
+ * @return Pointer to an unpinned page, or null if all pages are pinned.
+ */
+ClockReplacementPageCache::ClockReplacementPage *
+ClockReplacementPageCache::selectVictim() {
+  // All pages pinned
+  if (numPinnedPages_ >= getNumPages()) {
+    return nullptr;
+  }
+  auto numSlots = slots.size();
+  for (std::size_t step = 0; step < 2 * numSlots; ++step) {
+    if (hand >= numSlots) {
+      hand = 0;
+    }
+    auto page = slots[hand];
+    ++hand;
+    if (page->pinned) {
+      continue;
+    }
+    if (page->referenced) {
+      page->referenced = false;
+      continue;
+    }
+    return page;
+  }
+  return nullptr;
+}
+
+/**
+ * Remove a page from the cache, leaving it to the caller to destroy. The last
+ * slot moves into the page's slot, so the array stays dense.
+ * @param page - Pointer to a page in the cache.
+ */
+void ClockReplacementPageCache::removePage(ClockReplacementPage *page) {
+  if (page->pinned) {
+    countUnpin();
+  }
+  removeSlot(page);
+  cachedPages.erase(page->pageId);
+}
+
+/**
+ * Remove a page from the clock by moving the last page into its slot.
+ * @param page - Pointer to a page in the clock.
+ */
+void ClockReplacementPageCache::removeSlot(ClockReplacementPage *page) {
+  auto last = slots.back();
+  slots[page->slot] = last;
+  last->slot = page->slot;
+  slots.pop_back();
+}
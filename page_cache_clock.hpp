@@ -0,0 +1,110 @@
+#ifndef PAGE_CACHE_CLOCK_HPP
+#define PAGE_CACHE_CLOCK_HPP
+
+#include "page_cache.hpp"
+#include "page_table.hpp"
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * CLOCK replacement. The hit path of `fetchPage` and the common path of
+ * `unpinPage` are defined here, so that `PageCacheMethods`, which calls them
+ * on the final type, can inline them.
+ */
+class ClockReplacementPageCache final : public PageCache {
+public:
+  ClockReplacementPageCache(int pageSize, int extraSize);
+
+  ~ClockReplacementPageCache() override;
+
+  void setMaxNumPages(int maxNumPages) override;
+
+  /**
+   * Get the number of pages in the cache, both pinned and unpinned.
+   * @return Number of pages in the cache.
+   */
+  [[nodiscard]] int getNumPages() const override {
+    return (int)cachedPages.size();
+  }
+
+  /**
+   * Fetch and pin a page. If the page is already in the cache, set its
+   * reference bit and return a pointer to it. Otherwise, proceed as
+   * `fetchMissingPage` does.
+   * @param pageId - Page ID.
+   * @param createFlag - 0, 1 or 2, as passed to `xFetch`.
+   * @return Pointer to a page. May be null.
+   */
+  Page *fetchPage(unsigned pageId, int createFlag) override {
+    ++numFetches_;
+    auto page = cachedPages.find(pageId);
+    if (page == nullptr) {
+      return fetchMissingPage(pageId, createFlag);
+    }
+    if (!page->pinned) {
+      countPin();
+    }
+    page->pinned = true;
+    page->referenced = true;
+    ++numHits_;
+    return page;
+  }
+
+  /**
+   * Unpin a page. The page is unpinned regardless of the number of prior
+   * fetches, meaning it can be safely discarded. If `discard` is true, discard
+   * the page. If `discard` is false, examine the number of pages in the cache.
+   * If the number of pages in the cache is greater than the maximum, discard
+   * the page.
+   * @param page - Pointer to a page.
+   * @param discard - Discard the page.
+   */
+  void unpinPage(Page *page, bool discard) override {
+    auto *thisPage = (ClockReplacementPage *)page;
+    // Discard page if 'discard' true or number of pages greater than maximum
+    if (discard || getNumPages() > maxNumPages_) {
+      dropUnpinnedPage(thisPage, discard);
+    }
+    else {
+      thisPage->pinned = false;
+      countUnpin();
+    }
+  }
+
+  void changePageId(Page *page, unsigned newPageId) override;
+
+  void discardPages(unsigned pageIdLimit) override;
+
+  bool evictPage() override;
+
+private:
+  struct ClockReplacementPage : public Page {
+    ClockReplacementPage(void *buffer, void *extra, unsigned pageId,
+                         bool pinned);
+
+    bool pinned;
+    bool referenced;
+    std::size_t slot;
+  };
+
+  Page *fetchMissingPage(unsigned pageId, int createFlag);
+
+  void dropUnpinnedPage(ClockReplacementPage *page, bool discard);
+
+  ClockReplacementPage *selectVictim();
+
+  void removePage(ClockReplacementPage *page);
+
+  void removeSlot(ClockReplacementPage *page);
+
+  PageTable<ClockReplacementPage> cachedPages;
+
+  /** Circular array of the pages in the cache, swept by `hand`. */
+  std::vector<ClockReplacementPage *> slots;
+
+  /** Slot the next sweep starts at. */
+  std::size_t hand;
+};
+
+#endif
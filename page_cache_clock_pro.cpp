@@ -0,0 +1,511 @@
+#include "page_cache_clock_pro.hpp"
+
+#include <algorithm>
+
+/**
+ * Construct a CLOCK-Pro replacement policy Page.
+ * @param argBuffer - Page buffer.
+ * @param argExtra - Extra space.
+ * @param argPageId - Page ID.
+ * @param argPinned - The page's pin status.
+ */
+ClockProReplacementPageCache::ClockProReplacementPage::ClockProReplacementPage(
+    void *argBuffer, void *argExtra, unsigned argPageId, bool argPinned)
+    : Page(argBuffer, argExtra, argPageId), pinned(argPinned),
+      entry(nullptr) {}
+
+/**
+ * Construct a PageCache.
+ * @param pageSize - Page size in bytes. Assumed to be a power of two.
+ * @param extraSize - Extra space in bytes. Assumed to be less than 250.
+ */
+ClockProReplacementPageCache::ClockProReplacementPageCache(int pageSize,
+                                                           int extraSize)
+    : PageCache(pageSize, extraSize, sizeof(ClockProReplacementPage)),
+      handHot(nullptr), handCold(nullptr), handTest(nullptr), numHotPages(0),
+      coldTarget(1) {}
+
+/**
+ * Destructor of PageCache.
+ */
+ClockProReplacementPageCache::~ClockProReplacementPageCache() {
+  cachedPages.forEach(
+      [this](unsigned, ClockProReplacementPage *page) { deletePage(page); });
+  cachedPages.clear();
+}
+
+/**
+ * Set the maximum number of pages in the cache. Discard unpinned pages until
+ * either the number of pages in the cache is less than or equal to
+ * `maxNumPages` or all the pages in the cache are pinned. If there are still
+ * too many pages after discarding all unpinned pages, pages will continue to
+ * be discarded after being unpinned in the `unpinPage` function.
+ * @param maxNumPages - Maximum number of pages in the cache.
+ */
+void ClockProReplacementPageCache::setMaxNumPages(int maxNumPages) {
+  maxNumPages_ = maxNumPages;
+  coldTarget = std::max(1, std::min(coldTarget, maxNumPages - 1));
+  while (getNumPages() > maxNumPages && evictPage()) {
+  }
+  while ((int)nonResidentEntries.size() > maxNumPages && runHandTest()) {
+  }
+}
+
+/**
+ * Get the number of pages in the cache, both pinned and unpinned.
+ * @return Number of pages in the cache.
+ */
+int ClockProReplacementPageCache::getNumPages() const {
+  return (int)cachedPages.size();
+}
+
+/**
+ * Fetch and pin a page. If the page is already in the cache, return a
+ * pointer to the page. If the page is not already in the cache, use the
+ * `createFlag` parameter to determine how to proceed. If `createFlag` is 0,
+ * return a null pointer. Otherwise, examine the number of pages in the cache.
+ * If the number of pages in the cache is less than the maximum, allocate and
+ * return a pointer to a new page. If the number of pages in the cache is
+ * greater than or equal to the maximum, return a pointer to an existing
+ * unpinned page. If all pages are pinned, return a null pointer if
+ * `createFlag` is 1, or allocate a page beyond the maximum if it is 2.
+ * @param pageId - Page ID.
+ * @param createFlag - 0, 1 or 2, as passed to `xFetch`.
+ * @return Pointer to a page. May be null.
+ */
+Page *ClockProReplacementPageCache::fetchPage(unsigned pageId, int createFlag) {
+  ++numFetches_;
+  auto page = cachedPages.find(pageId);
+  // Page already in cache, a hit only sets its reference bit
+  if (page != nullptr) {
+    if (!page->pinned) {
+      countPin();
+    }
+    page->pinned = true;
+    page->entry->referenced = true;
+    ++numHits_;
+    return page;
+  }
+  // 'createFlag' 0, SQLite takes the page as not cached
+  if (createFlag == 0) {
+    forgetVictim(pageId);
+    return nullptr;
+  }
+  // Number of pages < maximum
+  if (getNumPages() < maxNumPages_) {
+    page = newPage<ClockProReplacementPage>(pageId, true);
+  }
+  // Number of pages >= maximum or the page pool is out of memory, replace a
+  // cold page
+  if (page == nullptr) {
+    page = selectVictim();
+    if (page != nullptr) {
+      retirePage(page);
+      counters_.recordEviction();
+      // The victim tier may keep the slot of the victim, so the page gets
+      // its own
+      if (keepsVictims()) {
+        deleteVictim(page);
+        page = newPageBeyondLimit<ClockProReplacementPage>(pageId, true);
+      }
+      else {
+        page->pinned = true;
+        page->reset();
+        page->pageId = pageId;
+      }
+    }
+    // All pages pinned, grow beyond the maximum if SQLite insists
+    else if (createFlag == 2) {
+      page = newPageBeyondLimit<ClockProReplacementPage>(pageId, true);
+    }
+    else {
+      return nullptr;
+    }
+  }
+  countPin();
+  admitPage(page);
+  return page;
+}
+
+/**
+ * Unpin a page. The page is unpinned regardless of the number of prior
+ * fetches, meaning it can be safely discarded. If `discard` is true, discard
+ * the page. If `discard` is false, examine the number of pages in the cache.
+ * If the number of pages in the cache is greater than the maximum, discard
+ * the page.
+ * @param page - Pointer to a page.
+ * @param discard - Discard the page.
+ */
+void ClockProReplacementPageCache::unpinPage(Page *page, bool discard) {
+  auto *thisPage = (ClockProReplacementPage *)page;
+  // Discard page if 'discard' true or number of pages grater than maximum
+  if (discard || getNumPages() > maxNumPages_) {
+    removePage(thisPage);
+    if (discard) {
+      deletePage(thisPage);
+    }
+    else {
+      counters_.recordEviction();
+      deleteVictim(thisPage);
+    }
+  }
+  else {
+    thisPage->pinned = false;
+    countUnpin();
+  }
+}
+
+/**
+ * Change the page ID associated with a page. If a page with page ID
+ * `newPageId` is already in the cache, it is assumed that the page is
+ * unpinned, and the page is discarded. A non-resident entry for `newPageId`
+ * describes a page that no longer exists and is dropped too.
+ * @param page - Pointer to a page.
+ * @param newPageId - New page ID.
+ */
+void ClockProReplacementPageCache::changePageId(Page *page,
+                                                unsigned newPageId) {
+  auto *thisPage = (ClockProReplacementPage *)page;
+  auto searchedPage = cachedPages.find(newPageId);
+  // Page found, already in cache, having 'newPageId' as its page ID. Discard.
+  if (searchedPage != nullptr && searchedPage != thisPage) {
+    removePage(searchedPage);
+    deletePage(searchedPage);
+  }
+  // The victim tier's image of the new page ID is out of date
+  forgetVictim(newPageId);
+  auto searchedEntry = nonResidentEntries.find(newPageId);
+  if (searchedEntry != nullptr) {
+    nonResidentEntries.erase(newPageId);
+    removeEntry(searchedEntry);
+  }
+  // Change page ID
+  cachedPages.erase(thisPage->pageId);
+  thisPage->pageId = newPageId;
+  thisPage->entry->pageId = newPageId;
+  cachedPages.insert(newPageId, thisPage);
+}
+
+/**
+ * Discard all pages with page IDs greater than or equal to `pageIdLimit`. If
+ * any of these pages are pinned, then they are implicitly unpinned, meaning
+ * they can be safely discarded. Non-resident entries in that range are
+ * dropped as well.
+ * @param pageIdLimit - Page ID limit.
+ */
+void ClockProReplacementPageCache::discardPages(unsigned pageIdLimit) {
+  forgetVictims(pageIdLimit);
+  cachedPages.eraseFrom(
+      pageIdLimit, [this](unsigned, ClockProReplacementPage *page) {
+        if (page->pinned) {
+          countUnpin();
+        }
+        if (page->entry->hot) {
+          --numHotPages;
+        }
+        removeEntry(page->entry);
+        deletePage(page);
+      });
+  nonResidentEntries.eraseFrom(
+      pageIdLimit, [this](unsigned, ClockEntry *entry) {
+        removeEntry(entry);
+      });
+}
+
+/**
+ * Discard the unpinned page that the replacement policy would replace next.
+ * @return True if a page was discarded, false if all pages are pinned.
+ */
+bool ClockProReplacementPageCache::evictPage() {
+  auto victim = selectVictim();
+  if (victim == nullptr) {
+    return false;
+  }
+  retirePage(victim);
+  deleteVictim(victim);
+  counters_.recordEviction();
+  return true;
+}
+
+/**
+ * Sweep the cold hand until it reaches an unpinned cold page whose reference
+ * bit is clear. A referenced cold page in its test period is promoted to hot;
+ * one outside its test period starts a new one. Either way it moves to the
+ * head of the clock. The hot hand demotes a hot page when no cold page is
+ * found in a revolution.
+ * @return Pointer to an unpinned resident page, or null if all pages are
+ * pinned.
+ */
+ClockProReplacementPageCache::ClockProReplacementPage *
+ClockProReplacementPageCache::selectVictim() {
+  // All pages pinned
+  if (numPinnedPages_ >= getNumPages()) {
+    return nullptr;
+  }
+  for (int revolution = 0; revolution < 3; ++revolution) {
+    if (revolution > 0 || getNumPages() == numHotPages) {
+      runHandHot();
+    }
+    auto numEntries = cachedPages.size() + nonResidentEntries.size();
+    for (std::size_t step = 0; step < numEntries && handCold != nullptr;
+         ++step) {
+      auto entry = handCold;
+      handCold = entry->next;
+      if (entry->page == nullptr || entry->hot || entry->page->pinned) {
+        continue;
+      }
+      if (!entry->referenced) {
+        return entry->page;
+      }
+      entry->referenced = false;
+      if (entry->test) {
+        entry->hot = true;
+        entry->test = false;
+        ++numHotPages;
+        moveEntryToHead(entry);
+        while (numHotPages > getMaxNumHotPages() && runHandHot()) {
+        }
+      }
+      else {
+        entry->test = true;
+        moveEntryToHead(entry);
+      }
+    }
+  }
+  // Only pinned pages and pages the hands keep protecting are left. Give up
+  // on the order and take any unpinned page.
+  ClockProReplacementPage *victim = nullptr;
+  cachedPages.forEach([&victim](unsigned, ClockProReplacementPage *page) {
+    if (victim == nullptr && !page->pinned) {
+      victim = page;
+    }
+  });
+  if (victim != nullptr && victim->entry->hot) {
+    victim->entry->hot = false;
+    --numHotPages;
+  }
+  return victim;
+}
+
+/**
+ * Sweep the hot hand until it demotes a hot page whose reference bit is
+ * clear, clearing the reference bits of the hot pages it passes and ending
+ * the test periods of the cold pages it passes.
+ * @return True if a hot page was demoted.
+ */
+bool ClockProReplacementPageCache::runHandHot() {
+  auto numEntries = cachedPages.size() + nonResidentEntries.size();
+  for (std::size_t step = 0; step < 2 * numEntries && handHot != nullptr;
+       ++step) {
+    auto entry = handHot;
+    handHot = entry->next;
+    if (entry->hot) {
+      if (entry->referenced) {
+        entry->referenced = false;
+        continue;
+      }
+      entry->hot = false;
+      --numHotPages;
+      return true;
+    }
+    if (entry->test) {
+      endTestPeriod(entry);
+    }
+  }
+  return false;
+}
+
+/**
+ * Sweep the test hand until it drops a non-resident entry, ending the test
+ * periods of the cold pages it passes.
+ * @return True if a non-resident entry was dropped.
+ */
+bool ClockProReplacementPageCache::runHandTest() {
+  auto numEntries = cachedPages.size() + nonResidentEntries.size();
+  for (std::size_t step = 0; step < numEntries && handTest != nullptr;
+       ++step) {
+    auto entry = handTest;
+    handTest = entry->next;
+    if (!entry->hot && entry->test) {
+      auto resident = entry->page != nullptr;
+      endTestPeriod(entry);
+      if (!resident) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * End the test period of a cold entry without the page being fetched again,
+ * which means cold pages get enough time: shrink the cold target. A
+ * non-resident entry is dropped.
+ * @param entry - Pointer to a cold entry in its test period.
+ */
+void ClockProReplacementPageCache::endTestPeriod(ClockEntry *entry) {
+  entry->test = false;
+  coldTarget = std::max(1, coldTarget - 1);
+  if (entry->page == nullptr) {
+    nonResidentEntries.erase(entry->pageId);
+    removeEntry(entry);
+  }
+}
+
+/**
+ * Add a page to the cache. A page with a non-resident entry was fetched again
+ * within its test period: it comes back hot, and the cold target grows, since
+ * a larger cold area would have kept it. Any other page comes in cold, in a
+ * new test period.
+ * @param page - Pointer to a pinned page that is not in the cache.
+ */
+void ClockProReplacementPageCache::admitPage(ClockProReplacementPage *page) {
+  auto entry = nonResidentEntries.find(page->pageId);
+  if (entry != nullptr) {
+    nonResidentEntries.erase(page->pageId);
+    coldTarget = std::min(coldTarget + 1, std::max(1, maxNumPages_ - 1));
+    entry->page = page;
+    entry->hot = true;
+    entry->test = false;
+    entry->referenced = false;
+    ++numHotPages;
+    moveEntryToHead(entry);
+  }
+  else {
+    entry = newEntry(page->pageId);
+    entry->page = page;
+    entry->test = true;
+    insertEntry(entry);
+  }
+  page->entry = entry;
+  cachedPages.insert(page->pageId, page);
+  while (numHotPages > getMaxNumHotPages() && runHandHot()) {
+  }
+}
+
+/**
+ * Take the victim chosen by `selectVictim` out of the cache without
+ * destroying it. If it is in its test period, its entry stays in the clock as
+ * a non-resident entry.
+ * @param page - Pointer to the victim.
+ */
+void ClockProReplacementPageCache::retirePage(ClockProReplacementPage *page) {
+  auto entry = page->entry;
+  cachedPages.erase(page->pageId);
+  page->entry = nullptr;
+  if (entry->test) {
+    entry->page = nullptr;
+    nonResidentEntries.insert(entry->pageId, entry);
+    while ((int)nonResidentEntries.size() > maxNumPages_ && runHandTest()) {
+    }
+  }
+  else {
+    removeEntry(entry);
+  }
+}
+
+/**
+ * Remove a page and its entry from the cache, leaving the page to the caller
+ * to destroy.
+ * @param page - Pointer to a page in the cache.
+ */
+void ClockProReplacementPageCache::removePage(ClockProReplacementPage *page) {
+  if (page->pinned) {
+    countUnpin();
+  }
+  if (page->entry->hot) {
+    --numHotPages;
+  }
+  removeEntry(page->entry);
+  cachedPages.erase(page->pageId);
+}
+
+/**
+ * Get a cold, unreferenced entry that is not in the clock.
+ * @param pageId - Page ID.
+ * @return Pointer to the entry.
+ */
+ClockProReplacementPageCache::ClockEntry *
+ClockProReplacementPageCache::newEntry(unsigned pageId) {
+  ClockEntry *entry;
+  if (!freeEntries.empty()) {
+    entry = freeEntries.back();
+    freeEntries.pop_back();
+  }
+  else {
+    entryStorage.emplace_back();
+    entry = &entryStorage.back();
+  }
+  *entry = {nullptr, nullptr, nullptr, pageId, false, false, false};
+  return entry;
+}
+
+/**
+ * Insert an entry at the head of the clock, just behind the hot hand, so it
+ * is the last entry the hands reach.
+ * @param entry - Pointer to an entry that is not in the clock.
+ */
+void ClockProReplacementPageCache::insertEntry(ClockEntry *entry) {
+  if (handHot == nullptr) {
+    entry->prev = entry;
+    entry->next = entry;
+    handHot = entry;
+    handCold = entry;
+    handTest = entry;
+    return;
+  }
+  entry->next = handHot;
+  entry->prev = handHot->prev;
+  handHot->prev->next = entry;
+  handHot->prev = entry;
+}
+
+/**
+ * Unlink an entry from the clock, moving any hand on it to the next entry.
+ * @param entry - Pointer to an entry in the clock.
+ */
+void ClockProReplacementPageCache::unlinkEntry(ClockEntry *entry) {
+  if (entry->next == entry) {
+    handHot = nullptr;
+    handCold = nullptr;
+    handTest = nullptr;
+    return;
+  }
+  if (handHot == entry) {
+    handHot = entry->next;
+  }
+  if (handCold == entry) {
+    handCold = entry->next;
+  }
+  if (handTest == entry) {
+    handTest = entry->next;
+  }
+  entry->prev->next = entry->next;
+  entry->next->prev = entry->prev;
+}
+
+/**
+ * Move an entry to the head of the clock.
+ * @param entry - Pointer to an entry in the clock.
+ */
+void ClockProReplacementPageCache::moveEntryToHead(ClockEntry *entry) {
+  unlinkEntry(entry);
+  insertEntry(entry);
+}
+
+/**
+ * Unlink an entry from the clock and recycle it.
+ * @param entry - Pointer to an entry in the clock.
+ */
+void ClockProReplacementPageCache::removeEntry(ClockEntry *entry) {
+  unlinkEntry(entry);
+  freeEntries.push_back(entry);
+}
+
+/**
+ * Get the number of resident hot pages allowed by the cold target.
+ * @return Maximum number of resident hot pages.
+ */
+int ClockProReplacementPageCache::getMaxNumHotPages() const {
+  return maxNumPages_ - coldTarget;
+}
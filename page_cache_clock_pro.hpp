@@ -0,0 +1,116 @@
+#ifndef PAGE_CACHE_CLOCK_PRO_HPP
+#define PAGE_CACHE_CLOCK_PRO_HPP
+
+#include "page_cache.hpp"
+#include "page_table.hpp"
+
+#include <deque>
+#include <vector>
+
+/**
+ * CLOCK-Pro replacement (Jiang, Chen and Zhang, 2005). Pages are hot or cold.
+ * A newly fetched page is cold and starts a test period; if it is fetched
+ * again within the test period it becomes hot, as in LRU-2 a page needs two
+ * references close together to stay. After a cold page is evicted during its
+ * test period, its page ID is remembered as a non-resident entry, so a quick
+ * refetch still counts as a second reference. The share of the cache given to
+ * cold pages adapts to how often test periods end in a refetch. Hits only set
+ * a reference bit; three hands sweep one circular list to evict cold pages,
+ * demote hot pages and end test periods.
+ */
+class ClockProReplacementPageCache final : public PageCache {
+public:
+  ClockProReplacementPageCache(int pageSize, int extraSize);
+
+  ~ClockProReplacementPageCache() override;
+
+  void setMaxNumPages(int maxNumPages) override;
+
+  [[nodiscard]] int getNumPages() const override;
+
+  Page *fetchPage(unsigned pageId, int createFlag) override;
+
+  void unpinPage(Page *page, bool discard) override;
+
+  void changePageId(Page *page, unsigned newPageId) override;
+
+  void discardPages(unsigned pageIdLimit) override;
+
+  bool evictPage() override;
+
+private:
+  struct ClockProReplacementPage;
+
+  /** Entry in the clock. Resident entries point to their page. */
+  struct ClockEntry {
+    ClockEntry *prev;
+    ClockEntry *next;
+    ClockProReplacementPage *page;
+    unsigned pageId;
+    bool hot;
+    bool test;
+    bool referenced;
+  };
+
+  struct ClockProReplacementPage : public Page {
+    ClockProReplacementPage(void *buffer, void *extra, unsigned pageId,
+                            bool pinned);
+
+    bool pinned;
+    ClockEntry *entry;
+  };
+
+  ClockProReplacementPage *selectVictim();
+
+  bool runHandHot();
+
+  bool runHandTest();
+
+  void endTestPeriod(ClockEntry *entry);
+
+  void admitPage(ClockProReplacementPage *page);
+
+  void retirePage(ClockProReplacementPage *page);
+
+  void removePage(ClockProReplacementPage *page);
+
+  ClockEntry *newEntry(unsigned pageId);
+
+  void insertEntry(ClockEntry *entry);
+
+  void unlinkEntry(ClockEntry *entry);
+
+  void moveEntryToHead(ClockEntry *entry);
+
+  void removeEntry(ClockEntry *entry);
+
+  [[nodiscard]] int getMaxNumHotPages() const;
+
+  PageTable<ClockProReplacementPage> cachedPages;
+
+  /** Non-resident cold pages in their test period. */
+  PageTable<ClockEntry> nonResidentEntries;
+
+  /** Storage for entries. Freed entries are kept in `freeEntries`. */
+  std::deque<ClockEntry> entryStorage;
+
+  std::vector<ClockEntry *> freeEntries;
+
+  /** Hand that demotes hot pages. New entries go just behind it. */
+  ClockEntry *handHot;
+
+  /** Hand that evicts cold pages. */
+  ClockEntry *handCold;
+
+  /** Hand that ends test periods to bound the non-resident entries. */
+  ClockEntry *handTest;
+
+  /** Number of resident hot pages. */
+  int numHotPages;
+
+  /** Target number of resident cold pages. Adapts between 1 and the maximum
+   * number of pages minus one. */
+  int coldTarget;
+};
+
+#endif
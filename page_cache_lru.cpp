@@ -1,22 +1,16 @@
 #include "page_cache_lru.hpp"
-#include "utilities/exception.hpp"
-#include <climits>
-
-// Order of unpinning, incremented after each unpinning
-int usedOrder = 0;
 
 /**
  * Consruct an LRU Replacement policy Page.
- * @param argPageSize - Page size in bytes. Assumed to be a power of two.
- * @param argExtraSize - Extra space in bytes. Assumed to be less than 250.
+ * @param argBuffer - Page buffer.
+ * @param argExtra - Extra space.
  * @param argPageId - Page ID.
  * @param argPinned - The page's pin status.
  */
 LRUReplacementPageCache::LRUReplacementPage::LRUReplacementPage(
-    int argPageSize, int argExtraSize, unsigned argPageId,
-    bool argPinned, int argSequenceNumber)
-  : Page(argPageSize, argExtraSize), pageId(argPageId), pinned(argPinned),
-         sequenceNumber(argSequenceNumber) {}
+    void *argBuffer, void *argExtra, unsigned argPageId, bool argPinned)
+  : Page(argBuffer, argExtra, argPageId), pinned(argPinned), scan(false),
+         prev(nullptr), next(nullptr) {}
 
 /**
  * Construct a PageCache.
@@ -24,17 +18,16 @@ LRUReplacementPageCache::LRUReplacementPage::LRUReplacementPage(
  * @param extraSize - Extra space in bytes. Assumed to be less than 250.
  */
 LRUReplacementPageCache::LRUReplacementPageCache(int pageSize, int extraSize)
-    : PageCache(pageSize, extraSize) {}
+    : PageCache(pageSize, extraSize, sizeof(LRUReplacementPage)),
+      leastRecentlyUsed(nullptr), mostRecentlyUsed(nullptr),
+      lastMissPageId(0), scanRunLength(0) {}
 
 /**
  * Destructor of PageCache.
  */
 LRUReplacementPageCache::~LRUReplacementPageCache() {
-  for (auto iterator = cachedPages.begin(); iterator != cachedPages.end();
-       ++iterator) {
-
-    delete iterator->second;
-  }
+  cachedPages.forEach(
+      [this](unsigned, LRUReplacementPage *page) { deletePage(page); });
   cachedPages.clear();
 }
 
@@ -48,124 +41,93 @@ LRUReplacementPageCache::~LRUReplacementPageCache() {
  */
 void LRUReplacementPageCache::setMaxNumPages(int maxNumPages) {
   maxNumPages_ = maxNumPages;
-  // Discard unpinned pages until the number of pages in the cache is less than
-  // or equal to `maxNumPages_` or only pinned pages remain.
-  for (auto iterator = cachedPages.begin(); iterator != cachedPages.end();) {
-
-    if (getNumPages() <= maxNumPages) {
-      break;
-    }
-
-    if (!iterator->second->pinned) {
-      delete iterator->second;
-      iterator = cachedPages.erase(iterator);
-    }
-    else {
-      ++iterator;
-    }
+  // Discard least recently used pages until the number of pages in the cache
+  // is less than or equal to `maxNumPages_` or only pinned pages remain.
+  while (getNumPages() > maxNumPages && evictPage()) {
   }
 }
 
 /**
- * Get the number of pages in the cache, both pinned and unpinned.
- * @return Number of pages in the cache.
- */
-int LRUReplacementPageCache::getNumPages() const {
-  return (int)cachedPages.size();
-}
-
-/**
- * Fetch and pin a page. If the page is already in the cache, return a
- * pointer to the page. If the page is not already in the cache, use the
- * `allocate` parameter to determine how to proceed. If `allocate` is false,
- * return a null pointer. If `allocate` is true, examine the number of pages
- * in the cache. If the number of pages in the cache is less than the maximum,
- * allocate and return a pointer to a new page. If the number of pages in the
- * cache is greater than or equal to the maximum, return a pointer to an
- * existing unpinned page. If all pages are pinned, return a null pointer.
+ * Fetch and pin a page that is not in the cache. If `createFlag` is 0,
+ * return a null pointer. Otherwise, examine the number of pages in the cache.
+ * If the number of pages in the cache is less than the maximum, allocate and
+ * return a pointer to a new page. If the number of pages in the cache is
+ * greater than or equal to the maximum, return a pointer to an existing
+ * unpinned page. If all pages are pinned, return a null pointer if
+ * `createFlag` is 1, or allocate a page beyond the maximum if it is 2.
  * @param pageId - Page ID.
- * @param allocate - Allocate new page on miss.
+ * @param createFlag - 0, 1 or 2, as passed to `xFetch`.
  * @return Pointer to a page. May be null.
  */
-Page *LRUReplacementPageCache::fetchPage(unsigned pageId, bool allocate) {
-  ++numFetches_;
-  auto iterator = cachedPages.find(pageId);
-  // Page already in cache
-  if (iterator != cachedPages.end()) {
-    iterator->second->pinned = true;
-    ++numHits_;
-    return iterator->second;
+Page *LRUReplacementPageCache::fetchMissingPage(unsigned pageId,
+                                                int createFlag) {
+  // 'createFlag' 0, SQLite takes the page as not cached
+  if (createFlag == 0) {
+    forgetVictim(pageId);
+    return nullptr;
   }
-  // Page not already in cache, check 'allocate' value
-  else {
-    // 'allocate' true
-    if (allocate) {
-      // Number of pages < maximum
-      if (getNumPages() < maxNumPages_) {
-        auto newPage = new LRUReplacementPage(pageSize_, extraSize_, pageId,
-                                              true, UINT_MAX);
-
-        cachedPages.emplace(pageId, newPage);
-        return newPage;
-      }
-      // Number of pages >= maximum
-      else {
-        unsigned min = usedOrder;
-        bool unpinnedFound = false;
-        LRUReplacementPage *replacement;
-        // Search for LRU'd unpinned
-        for (auto iterator = cachedPages.begin();
-             iterator != cachedPages.end(); ++iterator) {
-
-          if (!iterator->second->pinned) {
-            unpinnedFound = true;
-            if (iterator->second->sequenceNumber <= min) {
-              min = iterator->second->sequenceNumber;
-              replacement = iterator->second;
-            }
-          }
-        }
-        if (unpinnedFound) {
-          replacement->pinned = true;
-          auto it = cachedPages.find(replacement->pageId);
-          cachedPages.erase(it);
-          cachedPages.emplace(pageId, replacement);
-          return replacement;
-        }
-        // All pages pinned
-        else {
-          return nullptr;
-        }
-      }
+  auto scan = isScanMiss(pageId);
+  // Number of pages < maximum
+  if (getNumPages() < maxNumPages_) {
+    auto page = newPage<LRUReplacementPage>(pageId, true);
+    // Null if the page pool is out of memory, replace a page instead
+    if (page != nullptr) {
+      page->scan = scan;
+      cachedPages.insert(pageId, page);
+      countPin();
+      return page;
+    }
+  }
+  // Number of pages >= maximum, replace the least recently used page
+  if (leastRecentlyUsed != nullptr) {
+    auto replacement = leastRecentlyUsed;
+    unlinkPage(replacement);
+    cachedPages.erase(replacement->pageId);
+    counters_.recordEviction();
+    // The victim tier may keep the slot of the victim, so the page gets its
+    // own
+    if (keepsVictims()) {
+      deleteVictim(replacement);
+      replacement = newPageBeyondLimit<LRUReplacementPage>(pageId, true);
     }
-    // 'allocate' false
     else {
-      return nullptr;
+      replacement->pinned = true;
+      replacement->reset();
+      replacement->pageId = pageId;
     }
+    replacement->scan = scan;
+    cachedPages.insert(pageId, replacement);
+    countPin();
+    return replacement;
+  }
+  // All pages pinned, grow beyond the maximum if SQLite insists
+  else if (createFlag == 2) {
+    auto page = newPageBeyondLimit<LRUReplacementPage>(pageId, true);
+    page->scan = scan;
+    cachedPages.insert(pageId, page);
+    countPin();
+    return page;
+  }
+  else {
+    return nullptr;
   }
 }
 
 /**
- * Unpin a page. The page is unpinned regardless of the number of prior
- * fetches, meaning it can be safely discarded. If `discard` is true, discard
- * the page. If `discard` is false, examine the number of pages in the cache.
- * If the number of pages in the cache is greater than the maximum, discard
- * the page.
- * @param page - Pointer to a page.
- * @param discard - Discard the page.
+ * Remove a page that is being unpinned from the cache.
+ * @param page - Pointer to a page that is not in the recency list.
+ * @param discard - Whether SQLite discarded the page. If not, the page is
+ * evicted, and the victim tier may keep it.
  */
-void LRUReplacementPageCache::unpinPage(Page *page, bool discard) {
-  auto *thisPage = (LRUReplacementPage *)page;
-  // Discard page if 'discard' true or number of pages grater than maximum
-  if (discard || getNumPages() > maxNumPages_) {
-    cachedPages.erase(thisPage->pageId);
-    delete thisPage;
+void LRUReplacementPageCache::dropUnpinnedPage(LRUReplacementPage *page,
+                                               bool discard) {
+  cachedPages.erase(page->pageId);
+  if (discard) {
+    deletePage(page);
   }
-  // Unpin and add to back of the list
   else {
-    thisPage->pinned = false;
-    thisPage->sequenceNumber = usedOrder;
-    ++usedOrder;
+    counters_.recordEviction();
+    deleteVictim(page);
   }
 }
 
@@ -177,17 +139,8 @@ void LRUReplacementPageCache::unpinPage(Page *page, bool discard) {
  * @param newPageId - New page ID.
  */
 void LRUReplacementPageCache::changePageId(Page *page, unsigned newPageId) {
-  auto *thisPage = (LRUReplacementPage *)page;
-  auto searchedPage = cachedPages.find(newPageId);
-  // Page found, already in cache, having 'newPageId' as its page ID. Discard.
-  if (searchedPage != cachedPages.end()) {
-    cachedPages.erase(newPageId);
-    delete searchedPage->second;
-  }
-  // Change page ID
-  cachedPages.erase(thisPage->pageId);
-  thisPage->pageId = newPageId;
-  cachedPages.emplace(newPageId, thisPage);
+  detachPage(page);
+  attachPage(page, newPageId);
 }
 
 /**
@@ -197,14 +150,97 @@ void LRUReplacementPageCache::changePageId(Page *page, unsigned newPageId) {
  * @param pageIdLimit - Page ID limit.
  */
 void LRUReplacementPageCache::discardPages(unsigned pageIdLimit) {
-  for (auto iterator = cachedPages.begin(); iterator != cachedPages.end();) {
+  forgetVictims(pageIdLimit);
+  cachedPages.eraseFrom(
+      pageIdLimit, [this](unsigned, LRUReplacementPage *page) {
+        if (!page->pinned) {
+          unlinkPage(page);
+        }
+        else {
+          countUnpin();
+        }
+        deletePage(page);
+      });
+}
+
+/**
+ * Discard the unpinned page that the replacement policy would replace next.
+ * @return True if a page was discarded, false if all pages are pinned.
+ */
+bool LRUReplacementPageCache::evictPage() {
+  if (leastRecentlyUsed == nullptr) {
+    return false;
+  }
+  auto victim = leastRecentlyUsed;
+  unlinkPage(victim);
+  cachedPages.erase(victim->pageId);
+  deleteVictim(victim);
+  counters_.recordEviction();
+  return true;
+}
+
+/**
+ * Remove a pinned page from the cache without destroying it, so that another
+ * cache of the same type can adopt it with `attachPage`.
+ * @param page - Pointer to a page.
+ */
+void LRUReplacementPageCache::detachPage(Page *page) {
+  auto *thisPage = (LRUReplacementPage *)page;
+  if (!thisPage->pinned) {
+    unlinkPage(thisPage);
+  }
+  else {
+    countUnpin();
+  }
+  cachedPages.erase(thisPage->pageId);
+}
 
-    if (iterator->second->pageId >= pageIdLimit) {
-      delete iterator->second;
-      iterator = cachedPages.erase(iterator);
+/**
+ * Adopt a pinned page detached from a cache of the same type and page
+ * geometry. If a page with page ID `pageId` is already in the cache, it is
+ * assumed that the page is unpinned, and the page is discarded.
+ * @param page - Pointer to a detached page.
+ * @param pageId - Page ID of the page in this cache.
+ */
+void LRUReplacementPageCache::attachPage(Page *page, unsigned pageId) {
+  auto *thisPage = (LRUReplacementPage *)page;
+  auto searchedPage = cachedPages.find(pageId);
+  // Page found, already in cache, having 'pageId' as its page ID. Discard.
+  if (searchedPage != nullptr) {
+    if (!searchedPage->pinned) {
+      unlinkPage(searchedPage);
     }
     else {
-      ++iterator;
+      countUnpin();
     }
+    cachedPages.erase(pageId);
+    deletePage(searchedPage);
   }
-}
\ No newline at end of file
+  // The victim tier's image of the page ID is out of date
+  forgetVictim(pageId);
+  thisPage->pageId = pageId;
+  cachedPages.insert(pageId, thisPage);
+  if (!thisPage->pinned) {
+    linkPage(thisPage);
+  }
+  else {
+    countPin();
+  }
+}
+
+/**
+ * Count a miss for the scan detector. A scan is at least `kMinScanRunLength`
+ * misses in a row on ascending page IDs. Hits between them, as on the
+ * interior pages of a B-tree, do not break the run. A miss on the page ID of
+ * the last miss neither extends nor breaks the run: SQLite retries a fetch
+ * with `createFlag` 2 when one with `createFlag` 1 returns no page.
+ * @param pageId - Page ID of the miss.
+ * @return True if the miss continues a scan.
+ */
+bool LRUReplacementPageCache::isScanMiss(unsigned pageId) {
+  if (pageId != lastMissPageId) {
+    scanRunLength = pageId > lastMissPageId ? scanRunLength + 1 : 1;
+    lastMissPageId = pageId;
+  }
+  return scanRunLength >= kMinScanRunLength;
+}
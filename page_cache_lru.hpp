@@ -2,10 +2,20 @@
 #define PAGE_CACHE_LRU_HPP
 
 #include "page_cache.hpp"
+#include "page_table.hpp"
 
-#include <unordered_map>
-
-class LRUReplacementPageCache : public PageCache {
+/**
+ * LRU replacement with scan detection. A run of misses on ascending page IDs,
+ * as a table scan makes, marks the pages it brings in as scan pages. Unless
+ * fetched again while in the cache, a scan page is unpinned to the least
+ * recently used end of the recency list, so that a scan replaces its own
+ * pages rather than the working set.
+ *
+ * The hit path of `fetchPage` and the common path of `unpinPage` are defined
+ * here, so that `PageCacheMethods`, which calls them on the final type, can
+ * inline them.
+ */
+class LRUReplacementPageCache final : public PageCache {
 public:
   LRUReplacementPageCache(int pageSize, int extraSize);
 
@@ -13,27 +23,190 @@ public:
 
   void setMaxNumPages(int maxNumPages) override;
 
-  [[nodiscard]] int getNumPages() const override;
+  /**
+   * Get the number of pages in the cache, both pinned and unpinned.
+   * @return Number of pages in the cache.
+   */
+  [[nodiscard]] int getNumPages() const override {
+    return (int)cachedPages.size();
+  }
 
-  Page *fetchPage(unsigned pageId, bool allocate) override;
+  /**
+   * Fetch and pin a page. If the page is already in the cache, return a
+   * pointer to the page. Otherwise, proceed as `fetchMissingPage` does.
+   * @param pageId - Page ID.
+   * @param createFlag - 0, 1 or 2, as passed to `xFetch`.
+   * @return Pointer to a page. May be null.
+   */
+  Page *fetchPage(unsigned pageId, int createFlag) override {
+    ++numFetches_;
+    auto page = cachedPages.find(pageId);
+    if (page == nullptr) {
+      return fetchMissingPage(pageId, createFlag);
+    }
+    if (!page->pinned) {
+      unlinkPage(page);
+      page->pinned = true;
+      countPin();
+    }
+    // Fetched again, so not a one-off scan page
+    page->scan = false;
+    ++numHits_;
+    return page;
+  }
 
-  void unpinPage(Page *page, bool discard) override;
+  /**
+   * Unpin a page. The page is unpinned regardless of the number of prior
+   * fetches, meaning it can be safely discarded. If `discard` is true, discard
+   * the page. If `discard` is false, examine the number of pages in the cache.
+   * If the number of pages in the cache is greater than the maximum, discard
+   * the page. Otherwise a scan page goes to the least recently used end of
+   * the recency list, and any other page to the most recently used end.
+   * @param page - Pointer to a page.
+   * @param discard - Discard the page.
+   */
+  void unpinPage(Page *page, bool discard) override {
+    auto *thisPage = (LRUReplacementPage *)page;
+    if (!thisPage->pinned) {
+      unlinkPage(thisPage);
+    }
+    else {
+      countUnpin();
+    }
+    // Discard page if 'discard' true or number of pages greater than maximum
+    if (discard || getNumPages() > maxNumPages_) {
+      dropUnpinnedPage(thisPage, discard);
+    }
+    // Unpin and add to the front of the list if a scan brought it in, to be
+    // replaced next, else to the back
+    else {
+      thisPage->pinned = false;
+      if (thisPage->scan) {
+        linkColdPage(thisPage);
+        counters_.recordScanPage();
+      }
+      else {
+        linkPage(thisPage);
+      }
+    }
+  }
 
   void changePageId(Page *page, unsigned newPageId) override;
 
   void discardPages(unsigned pageIdLimit) override;
 
+  bool evictPage() override;
+
+  /**
+   * Remove a pinned page from the cache without destroying it, so that
+   * another cache of the same type can adopt it with `attachPage`.
+   * @param page Pointer to a page.
+   */
+  void detachPage(Page *page);
+
+  /**
+   * Adopt a pinned page detached from a cache of the same type and page
+   * geometry. If a page with page ID `pageId` is already in the cache, it is
+   * assumed that the page is unpinned, and the page is discarded.
+   * @param page Pointer to a detached page.
+   * @param pageId Page ID of the page in this cache.
+   */
+  void attachPage(Page *page, unsigned pageId);
+
 private:
   struct LRUReplacementPage : public Page {
-    LRUReplacementPage(int pageSize, int extraSize, unsigned pageId,
-                       bool pinned, int sequenceNumber);
+    LRUReplacementPage(void *buffer, void *extra, unsigned pageId, bool pinned);
 
-    unsigned pageId;
     bool pinned;
-    unsigned sequenceNumber;
+
+    /** Brought in by a scan and not fetched since. */
+    bool scan;
+
+    LRUReplacementPage *prev;
+    LRUReplacementPage *next;
   };
 
-  std::unordered_map<unsigned, LRUReplacementPage *> cachedPages;
+  /** Misses in a row on ascending page IDs that make a scan. */
+  static constexpr unsigned kMinScanRunLength = 8;
+
+  Page *fetchMissingPage(unsigned pageId, int createFlag);
+
+  void dropUnpinnedPage(LRUReplacementPage *page, bool discard);
+
+  /**
+   * Count a miss for the scan detector.
+   * @return True if the miss continues a scan.
+   */
+  bool isScanMiss(unsigned pageId);
+
+  /**
+   * Append an unpinned page to the most recently used end of the recency
+   * list.
+   * @param page - Pointer to a page that is not in the list.
+   */
+  void linkPage(LRUReplacementPage *page) {
+    page->prev = mostRecentlyUsed;
+    page->next = nullptr;
+    if (mostRecentlyUsed != nullptr) {
+      mostRecentlyUsed->next = page;
+    }
+    else {
+      leastRecentlyUsed = page;
+    }
+    mostRecentlyUsed = page;
+  }
+
+  /**
+   * Prepend an unpinned page to the least recently used end of the recency
+   * list, to be replaced next.
+   * @param page - Pointer to a page that is not in the list.
+   */
+  void linkColdPage(LRUReplacementPage *page) {
+    page->prev = nullptr;
+    page->next = leastRecentlyUsed;
+    if (leastRecentlyUsed != nullptr) {
+      leastRecentlyUsed->prev = page;
+    }
+    else {
+      mostRecentlyUsed = page;
+    }
+    leastRecentlyUsed = page;
+  }
+
+  /**
+   * Remove a page from the recency list.
+   * @param page - Pointer to a page that is in the list.
+   */
+  void unlinkPage(LRUReplacementPage *page) {
+    if (page->prev != nullptr) {
+      page->prev->next = page->next;
+    }
+    else {
+      leastRecentlyUsed = page->next;
+    }
+    if (page->next != nullptr) {
+      page->next->prev = page->prev;
+    }
+    else {
+      mostRecentlyUsed = page->prev;
+    }
+    page->prev = nullptr;
+    page->next = nullptr;
+  }
+
+  PageTable<LRUReplacementPage> cachedPages;
+
+  /** Least recently unpinned page. Next victim on a miss. */
+  LRUReplacementPage *leastRecentlyUsed;
+
+  /** Most recently unpinned page. */
+  LRUReplacementPage *mostRecentlyUsed;
+
+  /** Page ID of the last miss. */
+  unsigned lastMissPageId;
+
+  /** Number of misses in a row on ascending page IDs, up to the last miss. */
+  unsigned scanRunLength;
 };
 
 #endif
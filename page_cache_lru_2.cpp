@@ -1,20 +1,35 @@
 #include "page_cache_lru_2.hpp"
-#include "utilities/exception.hpp"
 
-// Order of unpinning, incremented after each unpinning
-int sequenceNumber = 0;
+#include <utility>
+
+namespace {
+
+/**
+ * Whether one sequence number was taken before another. The two are compared
+ * modulo 2^64, which is right across a wraparound as long as they are less
+ * than 2^63 unpinnings apart.
+ * @param sequenceNum - Sequence number.
+ * @param otherSequenceNum - Other sequence number.
+ * @return True if `sequenceNum` comes first.
+ */
+bool isEarlier(unsigned long long sequenceNum,
+               unsigned long long otherSequenceNum) {
+  return (sequenceNum - otherSequenceNum) >> 63 != 0;
+}
+
+} // namespace
 
 /**
  * Consruct an LRU-2 replacement policy Page.
- * @param argPageSize - Page size in bytes. Assumed to be a power of two.
- * @param argExtraSize - Extra space in bytes. Assumed to be less than 250.
+ * @param argBuffer - Page buffer.
+ * @param argExtra - Extra space.
  * @param argPageId - Page ID.
  * @param argPinned - The page's pin status.
  */
 LRU2ReplacementPageCache::LRU2ReplacementPage::LRU2ReplacementPage(
-    int argPageSize, int argExtraSize, unsigned argPageId, bool argPinned)
-    : Page(argPageSize, argExtraSize), pageId(argPageId), pinned(argPinned),
-    sequenceNums() {}
+    void *argBuffer, void *argExtra, unsigned argPageId, bool argPinned)
+    : Page(argBuffer, argExtra, argPageId), pinned(argPinned), numUnpins(0),
+      heapIndex(0), prev(nullptr), next(nullptr), history{0, 0} {}
 
 /**
  * Construct a PageCache.
@@ -22,17 +37,16 @@ LRU2ReplacementPageCache::LRU2ReplacementPage::LRU2ReplacementPage(
  * @param extraSize - Extra space in bytes. Assumed to be less than 250.
  */
 LRU2ReplacementPageCache::LRU2ReplacementPageCache(int pageSize, int extraSize)
-    : PageCache(pageSize, extraSize) {}
+    : PageCache(pageSize, extraSize, sizeof(LRU2ReplacementPage)),
+      oldestOneAccess(nullptr), newestOneAccess(nullptr),
+      sequenceNumber(0) {}
 
 /**
  * Destructor of PageCache.
  */
 LRU2ReplacementPageCache::~LRU2ReplacementPageCache() {
-  for (auto iterator = cachedPages.begin(); iterator != cachedPages.end();
-       ++iterator) {
-
-    delete iterator->second;
-  }
+  cachedPages.forEach(
+      [this](unsigned, LRU2ReplacementPage *page) { deletePage(page); });
   cachedPages.clear();
 }
 
@@ -46,21 +60,10 @@ LRU2ReplacementPageCache::~LRU2ReplacementPageCache() {
  */
 void LRU2ReplacementPageCache::setMaxNumPages(int maxNumPages) {
   maxNumPages_ = maxNumPages;
-  // Discard unpinned pages until the number of pages in the cache is less than
-  // or equal to `maxNumPages_` or only pinned pages remain.
-  for (auto iterator = cachedPages.begin(); iterator != cachedPages.end();) {
-
-    if (getNumPages() <= maxNumPages) {
-      break;
-    }
-
-    if (!iterator->second->pinned) {
-      delete iterator->second;
-      iterator = cachedPages.erase(iterator);
-    }
-    else {
-      ++iterator;
-    }
+  // Discard unpinned pages in replacement order until the number of pages in
+  // the cache is less than or equal to `maxNumPages_` or only pinned pages
+  // remain.
+  while (getNumPages() > maxNumPages && evictPage()) {
   }
 }
 
@@ -75,118 +78,83 @@ int LRU2ReplacementPageCache::getNumPages() const {
 /**
  * Fetch and pin a page. If the page is already in the cache, return a
  * pointer to the page. If the page is not already in the cache, use the
- * `allocate` parameter to determine how to proceed. If `allocate` is false,
- * return a null pointer. If `allocate` is true, examine the number of pages
- * in the cache. If the number of pages in the cache is less than the maximum,
- * allocate and return a pointer to a new page. If the number of pages in the
- * cache is greater than or equal to the maximum, return a pointer to an
- * existing unpinned page. If all pages are pinned, return a null pointer.
+ * `createFlag` parameter to determine how to proceed. If `createFlag` is 0,
+ * return a null pointer. Otherwise, examine the number of pages in the cache.
+ * If the number of pages in the cache is less than the maximum, allocate and
+ * return a pointer to a new page. If the number of pages in the cache is
+ * greater than or equal to the maximum, return a pointer to an existing
+ * unpinned page. If all pages are pinned, return a null pointer if
+ * `createFlag` is 1, or allocate a page beyond the maximum if it is 2.
  * @param pageId - Page ID.
- * @param allocate - Allocate new page on miss.
+ * @param createFlag - 0, 1 or 2, as passed to `xFetch`.
  * @return Pointer to a page. May be null.
  */
-Page *LRU2ReplacementPageCache::fetchPage(unsigned pageId, bool allocate) {
+Page *LRU2ReplacementPageCache::fetchPage(unsigned pageId, int createFlag) {
   ++numFetches_;
-  auto iterator = cachedPages.find(pageId);
+  auto page = cachedPages.find(pageId);
   // Page already in cache
-  if (iterator != cachedPages.end()) {
-    iterator->second->pinned = true;
+  if (page != nullptr) {
+    if (!page->pinned) {
+      untrackPage(page);
+      page->pinned = true;
+      countPin();
+    }
     ++numHits_;
-    return iterator->second;
+    return page;
   }
-  // Page not already in cache, check 'allocate' value
+  // Page not already in cache, check 'createFlag' value
   else {
-    // 'allocate' true
-    if (allocate) {
+    // 'createFlag' 1 or 2
+    if (createFlag != 0) {
       // Number of pages < maximum
       if (getNumPages() < maxNumPages_) {
-        auto newPage = new LRU2ReplacementPage(pageSize_, extraSize_, pageId,
-            true);
-
-        cachedPages.emplace(pageId, newPage);
-        return newPage;
-      }
-      // Number of pages >= maximum
-      else {
-        // Search for unpinned replacement.
-        unsigned numUnpinned = 0;
-        unsigned numOneAccess = 0;
-        unsigned min = sequenceNumber;
-        LRU2ReplacementPage *replacement;
-        // Check number of unpinned pages, unpinned pages with only one access
-        for (auto iterator = cachedPages.begin();
-             iterator != cachedPages.end(); ++iterator) {
-
-          if (!iterator->second->pinned) {
-            ++numUnpinned;
-            if (iterator->second->sequenceNums.size() < 2) {
-              ++numOneAccess;
-            }
-          }
+        page = newPage<LRU2ReplacementPage>(pageId, true);
+        // Null if the page pool is out of memory, replace a page instead
+        if (page != nullptr) {
+          cachedPages.insert(pageId, page);
+          countPin();
+          return page;
         }
-
-        if (numUnpinned == 0) {
+      }
+      // Number of pages >= maximum. Replace the oldest unpinned page with only
+      // one access if there is one, otherwise the unpinned page with the
+      // oldest penultimate access.
+      auto replacement = selectVictim();
+      // All pages pinned, grow beyond the maximum if SQLite insists
+      if (replacement == nullptr) {
+        if (createFlag != 2) {
           return nullptr;
         }
-        // Single unpinned page with only one access.
-        if (numOneAccess == 1) {
-          for (auto iterator = cachedPages.begin();
-               iterator != cachedPages.end(); ++iterator) {
-
-            if (!iterator->second->pinned &&
-                iterator->second->sequenceNums.size() < 2) {
-
-              iterator->second->pinned = true;
-              replacement = iterator->second;
-              cachedPages.erase(iterator);
-              cachedPages.emplace(pageId, replacement);
-              return replacement;
-            }
-          }
-        }
-        // Multiple unpinned pages with only one access, return LRU'd.
-        else if (numOneAccess >= 1) {
-          for (auto iterator = cachedPages.begin();
-            iterator != cachedPages.end(); ++iterator) {
-
-            if (!iterator->second->pinned &&
-                iterator->second->sequenceNums.size() < 2 &&
-                iterator->second->sequenceNums.front() <= min) {
-
-              min = iterator->second->sequenceNums.front();
-              replacement = iterator->second;
-            }
-          }
-          replacement->pinned = true;
-          auto it = cachedPages.find(replacement->pageId);
-          cachedPages.erase(it);
-          cachedPages.emplace(pageId, replacement);
-          return replacement;
-        }
-        // All pages >= two accesses, return LRU-2'd.
-        else {
-          for (auto iterator = cachedPages.begin();
-            iterator != cachedPages.end(); ++iterator) {
-
-            if (iterator->second->sequenceNums.front() <= min) {
-              min = iterator->second->sequenceNums.front();
-              replacement = iterator->second;
-            }
-          }
-          replacement->pinned = true;
-          auto it = cachedPages.find(replacement->pageId);
-          cachedPages.erase(it);
-          cachedPages.emplace(pageId, replacement);
-          return replacement;
-        }
+        page = newPageBeyondLimit<LRU2ReplacementPage>(pageId, true);
+        cachedPages.insert(pageId, page);
+        countPin();
+        return page;
+      }
+      untrackPage(replacement);
+      cachedPages.erase(replacement->pageId);
+      counters_.recordEviction();
+      // The victim tier may keep the slot of the victim, so the page gets its
+      // own
+      if (keepsVictims()) {
+        deleteVictim(replacement);
+        replacement = newPageBeyondLimit<LRU2ReplacementPage>(pageId, true);
+      }
+      else {
+        replacement->pinned = true;
+        replacement->reset();
+        replacement->numUnpins = 0;
+        replacement->pageId = pageId;
       }
+      cachedPages.insert(pageId, replacement);
+      countPin();
+      return replacement;
     }
-    // 'allocate' false
+    // 'createFlag' 0, SQLite takes the page as not cached
     else {
+      forgetVictim(pageId);
       return nullptr;
     }
   }
-  throw NotImplementedException("LRU2ReplacementPageCache::fetchPage");
 }
 
 /**
@@ -200,20 +168,29 @@ Page *LRU2ReplacementPageCache::fetchPage(unsigned pageId, bool allocate) {
  */
 void LRU2ReplacementPageCache::unpinPage(Page *page, bool discard) {
   auto *thisPage = (LRU2ReplacementPage *)page;
+  if (!thisPage->pinned) {
+    untrackPage(thisPage);
+  }
+  else {
+    countUnpin();
+  }
   // Discard page if 'discard' true or number of pages grater than maximum
   if (discard || getNumPages() > maxNumPages_) {
     cachedPages.erase(thisPage->pageId);
-    delete thisPage;
+    if (discard) {
+      deletePage(thisPage);
+    }
+    else {
+      counters_.recordEviction();
+      deleteVictim(thisPage);
+    }
   }
-  // Unpin and add sequence number to queue
+  // Unpin and add sequence number to the history
   else {
     thisPage->pinned = false;
-    thisPage->sequenceNums.push(sequenceNumber);
+    thisPage->recordUnpin(sequenceNumber);
     ++sequenceNumber;
-    // Keep queue size <= 2
-    if (thisPage->sequenceNums.size() > 2) {
-      thisPage->sequenceNums.pop();
-    }
+    trackPage(thisPage);
   }
 }
 
@@ -225,17 +202,8 @@ void LRU2ReplacementPageCache::unpinPage(Page *page, bool discard) {
  * @param newPageId - New page ID.
  */
 void LRU2ReplacementPageCache::changePageId(Page *page, unsigned newPageId) {
-  auto *thisPage = (LRU2ReplacementPage *)page;
-  auto searchedPage = cachedPages.find(newPageId);
-  // Page found, already in cache, having 'newPageId' as its page ID. Discard.
-  if (searchedPage != cachedPages.end()) {
-    cachedPages.erase(newPageId);
-    delete searchedPage->second;
-  }
-  // Change page ID
-  cachedPages.erase(thisPage->pageId);
-  thisPage->pageId = newPageId;
-  cachedPages.emplace(newPageId, thisPage);
+  detachPage(page);
+  attachPage(page, newPageId);
 }
 
 /**
@@ -245,14 +213,212 @@ void LRU2ReplacementPageCache::changePageId(Page *page, unsigned newPageId) {
  * @param pageIdLimit - Page ID limit.
  */
 void LRU2ReplacementPageCache::discardPages(unsigned pageIdLimit) {
-  for (auto iterator = cachedPages.begin(); iterator != cachedPages.end();) {
+  forgetVictims(pageIdLimit);
+  cachedPages.eraseFrom(
+      pageIdLimit, [this](unsigned, LRU2ReplacementPage *page) {
+        if (!page->pinned) {
+          untrackPage(page);
+        }
+        else {
+          countUnpin();
+        }
+        deletePage(page);
+      });
+}
+
+/**
+ * Discard the unpinned page that the replacement policy would replace next.
+ * @return True if a page was discarded, false if all pages are pinned.
+ */
+bool LRU2ReplacementPageCache::evictPage() {
+  auto victim = selectVictim();
+  if (victim == nullptr) {
+    return false;
+  }
+  untrackPage(victim);
+  cachedPages.erase(victim->pageId);
+  deleteVictim(victim);
+  counters_.recordEviction();
+  return true;
+}
 
-    if (iterator->second->pageId >= pageIdLimit) {
-      delete iterator->second;
-      iterator = cachedPages.erase(iterator);
+/**
+ * Remove a pinned page from the cache without destroying it, so that another
+ * cache of the same type can adopt it with `attachPage`.
+ * @param page - Pointer to a page.
+ */
+void LRU2ReplacementPageCache::detachPage(Page *page) {
+  auto *thisPage = (LRU2ReplacementPage *)page;
+  if (!thisPage->pinned) {
+    untrackPage(thisPage);
+  }
+  else {
+    countUnpin();
+  }
+  cachedPages.erase(thisPage->pageId);
+}
+
+/**
+ * Adopt a pinned page detached from a cache of the same type and page
+ * geometry. If a page with page ID `pageId` is already in the cache, it is
+ * assumed that the page is unpinned, and the page is discarded.
+ * @param page - Pointer to a detached page.
+ * @param pageId - Page ID of the page in this cache.
+ */
+void LRU2ReplacementPageCache::attachPage(Page *page, unsigned pageId) {
+  auto *thisPage = (LRU2ReplacementPage *)page;
+  auto searchedPage = cachedPages.find(pageId);
+  // Page found, already in cache, having 'pageId' as its page ID. Discard.
+  if (searchedPage != nullptr) {
+    if (!searchedPage->pinned) {
+      untrackPage(searchedPage);
+    }
+    else {
+      countUnpin();
+    }
+    cachedPages.erase(pageId);
+    deletePage(searchedPage);
+  }
+  // The victim tier's image of the page ID is out of date
+  forgetVictim(pageId);
+  thisPage->pageId = pageId;
+  cachedPages.insert(pageId, thisPage);
+  if (!thisPage->pinned) {
+    trackPage(thisPage);
+  }
+  else {
+    countPin();
+  }
+}
+
+/**
+ * Set the sequence number of the next unpinning.
+ * @param sequenceNum - Sequence number.
+ */
+void LRU2ReplacementPageCache::setSequenceNumber(
+    unsigned long long sequenceNum) {
+  sequenceNumber = sequenceNum;
+}
+
+/**
+ * Start tracking an unpinned page as a replacement candidate. Pages with fewer
+ * than two accesses are appended to the one-access FIFO, which stays ordered by
+ * sequence number because each unpinning takes the next one. Pages with two accesses
+ * are pushed onto the heap keyed by their penultimate sequence number.
+ * @param page - Pointer to an unpinned page that is not tracked.
+ */
+void LRU2ReplacementPageCache::trackPage(LRU2ReplacementPage *page) {
+  if (!page->hasTwoUnpins()) {
+    page->prev = newestOneAccess;
+    page->next = nullptr;
+    if (newestOneAccess != nullptr) {
+      newestOneAccess->next = page;
     }
     else {
-      ++iterator;
+      oldestOneAccess = page;
+    }
+    newestOneAccess = page;
+  }
+  else {
+    page->heapIndex = (std::uint32_t)twoAccessPages.size();
+    twoAccessPages.push_back(page);
+    siftUp(page->heapIndex);
+  }
+}
+
+/**
+ * Stop tracking a page as a replacement candidate.
+ * @param page - Pointer to a tracked page.
+ */
+void LRU2ReplacementPageCache::untrackPage(LRU2ReplacementPage *page) {
+  if (!page->hasTwoUnpins()) {
+    if (page->prev != nullptr) {
+      page->prev->next = page->next;
+    }
+    else {
+      oldestOneAccess = page->next;
+    }
+    if (page->next != nullptr) {
+      page->next->prev = page->prev;
+    }
+    else {
+      newestOneAccess = page->prev;
+    }
+    page->prev = nullptr;
+    page->next = nullptr;
+  }
+  else {
+    auto index = page->heapIndex;
+    auto last = twoAccessPages.back();
+    twoAccessPages.pop_back();
+    if (last != page) {
+      twoAccessPages[index] = last;
+      last->heapIndex = (std::uint32_t)index;
+      siftUp(index);
+      siftDown(last->heapIndex);
+    }
+  }
+}
+
+/**
+ * Select the page to replace: the oldest unpinned page with fewer than two
+ * accesses if there is one, otherwise the unpinned page with the oldest
+ * penultimate access.
+ * @return Pointer to an unpinned page, or null if all pages are pinned.
+ */
+LRU2ReplacementPageCache::LRU2ReplacementPage *
+LRU2ReplacementPageCache::selectVictim() const {
+  if (oldestOneAccess != nullptr) {
+    return oldestOneAccess;
+  }
+  if (!twoAccessPages.empty()) {
+    return twoAccessPages.front();
+  }
+  return nullptr;
+}
+
+/**
+ * Move a heap entry towards the root until the heap property holds.
+ * @param index - Index of the entry in `twoAccessPages`.
+ */
+void LRU2ReplacementPageCache::siftUp(std::size_t index) {
+  while (index > 0) {
+    auto parent = (index - 1) / 2;
+    if (!isEarlier(twoAccessPages[index]->history[0],
+                   twoAccessPages[parent]->history[0])) {
+      break;
+    }
+    std::swap(twoAccessPages[parent], twoAccessPages[index]);
+    twoAccessPages[parent]->heapIndex = (std::uint32_t)parent;
+    twoAccessPages[index]->heapIndex = (std::uint32_t)index;
+    index = parent;
+  }
+}
+
+/**
+ * Move a heap entry towards the leaves until the heap property holds.
+ * @param index - Index of the entry in `twoAccessPages`.
+ */
+void LRU2ReplacementPageCache::siftDown(std::size_t index) {
+  auto size = twoAccessPages.size();
+  while (true) {
+    auto smallest = index;
+    auto left = 2 * index + 1;
+    auto right = left + 1;
+    if (left < size && isEarlier(twoAccessPages[left]->history[0],
+                                 twoAccessPages[smallest]->history[0])) {
+      smallest = left;
+    }
+    if (right < size && isEarlier(twoAccessPages[right]->history[0],
+                                  twoAccessPages[smallest]->history[0])) {
+      smallest = right;
+    }
+    if (smallest == index) {
+      break;
     }
+    std::swap(twoAccessPages[smallest], twoAccessPages[index]);
+    twoAccessPages[smallest]->heapIndex = (std::uint32_t)smallest;
+    twoAccessPages[index]->heapIndex = (std::uint32_t)index;
+    index = smallest;
   }
 }
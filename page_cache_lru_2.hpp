@@ -2,11 +2,13 @@
 #define PAGE_CACHE_LRU_2_HPP
 
 #include "page_cache.hpp"
+#include "page_table.hpp"
 
-#include <unordered_map>
-#include <queue>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
 
-class LRU2ReplacementPageCache : public PageCache {
+class LRU2ReplacementPageCache final : public PageCache {
 public:
   LRU2ReplacementPageCache(int pageSize, int extraSize);
 
@@ -16,7 +18,7 @@ public:
 
   [[nodiscard]] int getNumPages() const override;
 
-  Page *fetchPage(unsigned pageId, bool allocate) override;
+  Page *fetchPage(unsigned pageId, int createFlag) override;
 
   void unpinPage(Page *page, bool discard) override;
 
@@ -24,16 +26,98 @@ public:
 
   void discardPages(unsigned pageIdLimit) override;
 
+  bool evictPage() override;
+
+  /**
+   * Remove a pinned page from the cache without destroying it, so that
+   * another cache of the same type can adopt it with `attachPage`.
+   * @param page Pointer to a page.
+   */
+  void detachPage(Page *page);
+
+  /**
+   * Adopt a pinned page detached from a cache of the same type and page
+   * geometry. If a page with page ID `pageId` is already in the cache, it is
+   * assumed that the page is unpinned, and the page is discarded.
+   * @param page Pointer to a detached page.
+   * @param pageId Page ID of the page in this cache.
+   */
+  void attachPage(Page *page, unsigned pageId);
+
+  /**
+   * Set the sequence number of the next unpinning, so that tests can run the
+   * order of unpinning past the point where it wraps.
+   * @param sequenceNum Sequence number.
+   */
+  void setSequenceNumber(unsigned long long sequenceNum);
+
 private:
+  /**
+   * The bookkeeping fits in one cache line with the page header. The history
+   * is a fixed pair of sequence numbers. The pinned flag and the count take
+   * two of the four bytes of padding at the end of `Page`; the heap index is
+   * aligned past them, which leaves two bytes before it and four after it
+   * unused.
+   */
   struct LRU2ReplacementPage : public Page {
-    LRU2ReplacementPage(int pageSize, int extraSize, unsigned pageId, bool pinned);
+    LRU2ReplacementPage(void *buffer, void *extra, unsigned pageId, bool pinned);
+
+    /** Record an unpinning in the history. */
+    void recordUnpin(unsigned long long sequenceNum) {
+      history[0] = history[1];
+      history[1] = sequenceNum;
+      if (numUnpins < 2) {
+        ++numUnpins;
+      }
+    }
+
+    /** Whether the page was unpinned at least twice, with a penultimate
+     * sequence number. */
+    [[nodiscard]] bool hasTwoUnpins() const { return numUnpins == 2; }
 
-    unsigned pageId;
     bool pinned;
-    std::queue<unsigned> sequenceNums;
+
+    /** Number of unpinnings in the history, at most two. */
+    std::uint8_t numUnpins;
+
+    /** Position in `twoAccessPages` while the page is there. */
+    std::uint32_t heapIndex;
+
+    LRU2ReplacementPage *prev;
+    LRU2ReplacementPage *next;
+
+    /** Sequence numbers of the last two unpinnings, the penultimate first. */
+    unsigned long long history[2];
   };
 
-  std::unordered_map<unsigned, LRU2ReplacementPage*> cachedPages;
+  static_assert(sizeof(LRU2ReplacementPage) <= 64,
+                "An LRU-2 page object must fit in one cache line");
+
+  void trackPage(LRU2ReplacementPage *page);
+
+  void untrackPage(LRU2ReplacementPage *page);
+
+  LRU2ReplacementPage *selectVictim() const;
+
+  void siftUp(std::size_t index);
+
+  void siftDown(std::size_t index);
+
+  PageTable<LRU2ReplacementPage> cachedPages;
+
+  /** Oldest unpinned page with fewer than two accesses. */
+  LRU2ReplacementPage *oldestOneAccess;
+
+  /** Newest unpinned page with fewer than two accesses. */
+  LRU2ReplacementPage *newestOneAccess;
+
+  /** Min-heap of unpinned pages with two accesses, keyed by the penultimate
+   * sequence number. */
+  std::vector<LRU2ReplacementPage *> twoAccessPages;
+
+  /** Order of unpinning, incremented after each unpinning. Sequence numbers
+   * are compared modulo 2^64, so the order holds when it wraps. */
+  unsigned long long sequenceNumber;
 };
 
 #endif
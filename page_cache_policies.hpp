@@ -0,0 +1,88 @@
+#ifndef PAGE_CACHE_POLICIES_HPP
+#define PAGE_CACHE_POLICIES_HPP
+
+#include "page_cache_arc.hpp"
+#include "page_cache_array_lru.hpp"
+#include "page_cache_clock.hpp"
+#include "page_cache_clock_pro.hpp"
+#include "page_cache_lru.hpp"
+#include "page_cache_lru_2.hpp"
+#include "page_cache_sharded.hpp"
+#include "page_cache_tiny_lfu.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+
+/**
+ * Every `PageCache` implementation under a short name, for the tools that
+ * compare them.
+ */
+struct PageCachePolicy {
+  using Factory = std::unique_ptr<PageCache> (*)(int pageSize, int extraSize);
+
+  /**
+   * Fetch and unpin each page ID in turn, calling the cache through its own
+   * type, as `PageCacheMethods` does.
+   */
+  using FetchLoop = void (*)(PageCache &pageCache, const unsigned *pageIds,
+                             std::size_t numPageIds);
+
+  const char *name;
+  Factory factory;
+  FetchLoop fetchLoop;
+
+  template <typename PageCacheImplementation>
+  static std::unique_ptr<PageCache> make(int pageSize, int extraSize) {
+    return std::unique_ptr<PageCache>(
+        new PageCacheImplementation(pageSize, extraSize));
+  }
+
+  template <typename PageCacheImplementation>
+  static void fetchAll(PageCache &pageCache, const unsigned *pageIds,
+                       std::size_t numPageIds) {
+    auto &cache = static_cast<PageCacheImplementation &>(pageCache);
+    for (std::size_t i = 0; i < numPageIds; ++i) {
+      auto page = cache.fetchPage(pageIds[i], 1);
+      if (page != nullptr) {
+        cache.unpinPage(page, false);
+      }
+    }
+  }
+};
+
+inline const PageCachePolicy kPageCachePolicies[] = {
+    {"lru", PageCachePolicy::make<LRUReplacementPageCache>,
+     PageCachePolicy::fetchAll<LRUReplacementPageCache>},
+    {"array-lru", PageCachePolicy::make<ArrayLRUReplacementPageCache>,
+     PageCachePolicy::fetchAll<ArrayLRUReplacementPageCache>},
+    {"lru2", PageCachePolicy::make<LRU2ReplacementPageCache>,
+     PageCachePolicy::fetchAll<LRU2ReplacementPageCache>},
+    {"clock", PageCachePolicy::make<ClockReplacementPageCache>,
+     PageCachePolicy::fetchAll<ClockReplacementPageCache>},
+    {"clockpro", PageCachePolicy::make<ClockProReplacementPageCache>,
+     PageCachePolicy::fetchAll<ClockProReplacementPageCache>},
+    {"arc", PageCachePolicy::make<ARCReplacementPageCache>,
+     PageCachePolicy::fetchAll<ARCReplacementPageCache>},
+    {"tinylfu", PageCachePolicy::make<TinyLFUPageCache>,
+     PageCachePolicy::fetchAll<TinyLFUPageCache>},
+    {"sharded-lru",
+     PageCachePolicy::make<ShardedPageCache<LRUReplacementPageCache>>,
+     PageCachePolicy::fetchAll<ShardedPageCache<LRUReplacementPageCache>>},
+};
+
+/**
+ * Find a policy by name.
+ * @param name Name of the policy.
+ * @return Pointer to the policy, or null if there is none by that name.
+ */
+inline const PageCachePolicy *findPageCachePolicy(const char *name) {
+  for (const auto &policy : kPageCachePolicies) {
+    if (std::strcmp(policy.name, name) == 0) {
+      return &policy;
+    }
+  }
+  return nullptr;
+}
+
+#endif
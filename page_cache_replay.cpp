@@ -0,0 +1,301 @@
+/**
+ * Replays a trace recorded with `TraceRecorder::start` against every
+ * combination of the chosen replacement policies and cache sizes, running the
+ * combinations in parallel, and prints a comparison table.
+ *
+ *   page_cache_replay [-p policy,...] [-s size,...] [-j threads] TRACE
+ *
+ * Policies: lru, array-lru, lru2, clock, clockpro, arc, tinylfu, sharded-lru.
+ * Sizes are maximum numbers of pages per cache; size 0 keeps the sizes SQLite
+ * set while recording. ns/op covers every replayed call, so use `-j 1` when
+ * comparing timings.
+ */
+
+#include "page_cache_policies.hpp"
+#include "page_cache_trace.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+struct ReplayResult {
+  unsigned long long numLookups = 0;
+  unsigned long long numHits = 0;
+  unsigned long long numEvictions = 0;
+  double nanosecondsPerCall = 0;
+};
+
+struct ReplayCache {
+  std::unique_ptr<PageCache> pageCache;
+
+  /** Pages the recorded run held pinned, by page ID. */
+  std::unordered_map<unsigned, Page *> pinnedPages;
+
+  /** Page ID of the last fetch, if it failed while recording. */
+  bool lastFetchFailed = false;
+  unsigned lastFetchPageId = 0;
+};
+
+/**
+ * Replay a trace against fresh caches of one policy. Pages the recorded run
+ * did not get are unpinned again right away, since SQLite never used them,
+ * and calls on pages the replayed cache failed to return are skipped. A fetch
+ * repeating a fetch of the same page that failed while recording is SQLite
+ * retrying with a stronger create flag, so it is not counted as a lookup.
+ * @param events - Recorded events.
+ * @param factory - Creates a cache of the policy.
+ * @param cacheSize - Maximum number of pages per cache, or 0 to apply the
+ * recorded cache sizes.
+ * @return Counters and timing of the replay.
+ */
+ReplayResult replay(const std::vector<TraceEvent> &events,
+                    PageCachePolicy::Factory factory, int cacheSize) {
+  ReplayResult result;
+  std::unordered_map<unsigned, ReplayCache> caches;
+  auto start = std::chrono::steady_clock::now();
+  for (const auto &event : events) {
+    auto &cache = caches[event.cacheId];
+    auto pageCache = cache.pageCache.get();
+    if (pageCache == nullptr && event.type != TraceEvent::Type::Create) {
+      continue;
+    }
+    switch (event.type) {
+    case TraceEvent::Type::Create:
+      cache = ReplayCache();
+      cache.pageCache = factory((int)event.value, (int)event.secondValue);
+      if (cacheSize > 0) {
+        cache.pageCache->setMaxNumPages(cacheSize);
+      }
+      break;
+    case TraceEvent::Type::Cachesize:
+      if (cacheSize == 0) {
+        auto numPages = pageCache->getNumPages();
+        pageCache->setMaxNumPages((int)event.value);
+        if (pageCache->getNumPages() < numPages) {
+          result.numEvictions += numPages - pageCache->getNumPages();
+        }
+      }
+      break;
+    case TraceEvent::Type::Fetch: {
+      auto pageId = (unsigned)event.value;
+      bool found = (event.flags & 4) != 0;
+      bool retry = cache.lastFetchFailed && cache.lastFetchPageId == pageId;
+      auto numHits = pageCache->getNumHits();
+      auto numPages = pageCache->getNumPages();
+      auto page = pageCache->fetchPage(pageId, event.flags & 3);
+      bool hit = pageCache->getNumHits() > numHits;
+      if (!retry) {
+        ++result.numLookups;
+        result.numHits += hit;
+      }
+      if (page != nullptr && !hit &&
+          pageCache->getNumPages() < numPages + 1) {
+        result.numEvictions += numPages + 1 - pageCache->getNumPages();
+      }
+      if (page != nullptr) {
+        if (found) {
+          cache.pinnedPages[pageId] = page;
+        }
+        else if (cache.pinnedPages.count(pageId) == 0) {
+          pageCache->unpinPage(page, false);
+        }
+      }
+      cache.lastFetchFailed = !found;
+      cache.lastFetchPageId = pageId;
+      break;
+    }
+    case TraceEvent::Type::Unpin: {
+      auto iterator = cache.pinnedPages.find((unsigned)event.value);
+      if (iterator == cache.pinnedPages.end()) {
+        break;
+      }
+      auto page = iterator->second;
+      cache.pinnedPages.erase(iterator);
+      auto numPages = pageCache->getNumPages();
+      pageCache->unpinPage(page, event.flags != 0);
+      if (event.flags == 0 && pageCache->getNumPages() < numPages) {
+        result.numEvictions += numPages - pageCache->getNumPages();
+      }
+      break;
+    }
+    case TraceEvent::Type::Rekey: {
+      auto oldPageId = (unsigned)event.value;
+      auto newPageId = (unsigned)event.secondValue;
+      auto iterator = cache.pinnedPages.find(oldPageId);
+      if (iterator == cache.pinnedPages.end() ||
+          cache.pinnedPages.count(newPageId) != 0) {
+        break;
+      }
+      auto page = iterator->second;
+      cache.pinnedPages.erase(iterator);
+      pageCache->changePageId(page, newPageId);
+      cache.pinnedPages[newPageId] = page;
+      break;
+    }
+    case TraceEvent::Type::Truncate: {
+      auto pageIdLimit = (unsigned)event.value;
+      pageCache->discardPages(pageIdLimit);
+      for (auto iterator = cache.pinnedPages.begin();
+           iterator != cache.pinnedPages.end();) {
+        if (iterator->first >= pageIdLimit) {
+          iterator = cache.pinnedPages.erase(iterator);
+        }
+        else {
+          ++iterator;
+        }
+      }
+      break;
+    }
+    case TraceEvent::Type::Destroy:
+      caches.erase(event.cacheId);
+      break;
+    case TraceEvent::Type::Shrink: {
+      auto numPages = pageCache->getNumPages();
+      pageCache->releaseMemory();
+      result.numEvictions += numPages - pageCache->getNumPages();
+      break;
+    }
+    }
+  }
+  caches.clear();
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  if (!events.empty()) {
+    result.nanosecondsPerCall = elapsed.count() / (double)events.size();
+  }
+  return result;
+}
+
+std::vector<std::string> splitList(const std::string &list) {
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+void printUsage() {
+  std::fprintf(stderr, "usage: page_cache_replay [-p policy,...] "
+                       "[-s size,...] [-j threads] TRACE\npolicies:");
+  for (const auto &policy : kPageCachePolicies) {
+    std::fprintf(stderr, " %s", policy.name);
+  }
+  std::fprintf(stderr, "\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::vector<const PageCachePolicy *> policies;
+  std::vector<int> cacheSizes;
+  unsigned numThreads = std::thread::hardware_concurrency();
+  const char *tracePath = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    std::string argument = argv[i];
+    if ((argument == "-p" || argument == "-s" || argument == "-j") &&
+        i + 1 < argc) {
+      std::string value = argv[++i];
+      if (argument == "-p") {
+        for (const auto &name : splitList(value)) {
+          auto found = findPageCachePolicy(name.c_str());
+          if (found == nullptr) {
+            std::fprintf(stderr, "unknown policy: %s\n", name.c_str());
+            printUsage();
+            return 1;
+          }
+          policies.push_back(found);
+        }
+      }
+      else if (argument == "-s") {
+        for (const auto &size : splitList(value)) {
+          cacheSizes.push_back(std::atoi(size.c_str()));
+        }
+      }
+      else {
+        numThreads = (unsigned)std::atoi(value.c_str());
+      }
+    }
+    else if (tracePath == nullptr && argument[0] != '-') {
+      tracePath = argv[i];
+    }
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+  if (tracePath == nullptr) {
+    printUsage();
+    return 1;
+  }
+  if (policies.empty()) {
+    for (const auto &policy : kPageCachePolicies) {
+      policies.push_back(&policy);
+    }
+  }
+  if (cacheSizes.empty()) {
+    cacheSizes.push_back(0);
+  }
+  if (numThreads == 0) {
+    numThreads = 1;
+  }
+
+  std::vector<TraceEvent> events;
+  if (!readTrace(tracePath, events)) {
+    std::fprintf(stderr, "cannot read trace: %s\n", tracePath);
+    return 1;
+  }
+
+  struct Run {
+    const PageCachePolicy *policy;
+    int cacheSize;
+    ReplayResult result;
+  };
+  std::vector<Run> runs;
+  for (auto cacheSize : cacheSizes) {
+    for (auto policy : policies) {
+      runs.push_back({policy, cacheSize, {}});
+    }
+  }
+  std::atomic<std::size_t> nextRun(0);
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < numThreads && i < runs.size(); ++i) {
+    threads.emplace_back([&] {
+      for (auto index = nextRun++; index < runs.size(); index = nextRun++) {
+        runs[index].result =
+            replay(events, runs[index].policy->factory, runs[index].cacheSize);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  std::printf("%zu calls\n", events.size());
+  std::printf("%-12s %10s %12s %9s %12s %8s\n", "policy", "size", "lookups",
+              "hit ratio", "evictions", "ns/op");
+  for (const auto &run : runs) {
+    const auto &result = run.result;
+    double hitRatio = result.numLookups > 0
+                          ? (double)result.numHits / (double)result.numLookups
+                          : 0;
+    std::printf("%-12s %10s %12llu %9.4f %12llu %8.1f\n", run.policy->name,
+                run.cacheSize > 0 ? std::to_string(run.cacheSize).c_str()
+                                  : "recorded",
+                result.numLookups, hitRatio, result.numEvictions,
+                result.nanosecondsPerCall);
+  }
+  return 0;
+}
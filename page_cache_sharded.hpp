@@ -0,0 +1,220 @@
+#ifndef PAGE_CACHE_SHARDED_HPP
+#define PAGE_CACHE_SHARDED_HPP
+
+#include "page_cache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * Thread-safe page cache made of `NumShards` independent caches of type
+ * `ShardImplementation`, each behind its own lock. A page belongs to the shard
+ * selected by the low bits of its page ID, so consecutive pages are spread
+ * round-robin and operations on different shards never contend. Each shard
+ * evicts with its own policy and holds at most its share of the maximum
+ * number of pages.
+ *
+ * `ShardImplementation` must provide `detachPage` and `attachPage`, which
+ * move a page between shards when its page ID changes shard.
+ */
+template <typename ShardImplementation, unsigned NumShards = 16>
+class ShardedPageCache final : public PageCache {
+  static_assert(NumShards > 0 && (NumShards & (NumShards - 1)) == 0,
+                "NumShards must be a power of two");
+
+public:
+  /**
+   * Construct a ShardedPageCache.
+   * @param pageSize Page size in bytes. Assumed to be a power of two.
+   * @param extraSize Extra space in bytes. Assumed to be less than 250.
+   */
+  ShardedPageCache(int pageSize, int extraSize)
+      : PageCache(pageSize, extraSize, sizeof(Page)), nextEvictedShard_(0) {
+    shards_.reserve(NumShards);
+    for (unsigned i = 0; i < NumShards; ++i) {
+      shards_.emplace_back(new Shard(pageSize, extraSize));
+      // A shard sees one in NumShards of the pages between two accesses
+      shards_.back()->cache.getCounters().setReuseDistanceScale(NumShards);
+    }
+  }
+
+  /**
+   * Destroy the ShardedPageCache. A page whose ID changed shard lives in a
+   * slot of another shard's allocator, so every page is destroyed before any
+   * shard releases its memory.
+   */
+  ~ShardedPageCache() override { discardPages(0); }
+
+  void setMaxNumPages(int maxNumPages) override {
+    maxNumPages_ = maxNumPages;
+    // The shares add up to the maximum. Page IDs start at 1, so the pages
+    // left over go to the shards of page IDs 1 to maxNumPages % NumShards, and
+    // a database of maxNumPages pages fits exactly. A cache of fewer pages
+    // than shards still keeps a page in every shard, so it holds NumShards.
+    auto shardMaxNumPages = maxNumPages / (int)NumShards;
+    auto numLeftOverPages = (unsigned)(maxNumPages % (int)NumShards);
+    for (unsigned i = 0; i < NumShards; ++i) {
+      auto shareMaxNumPages =
+          shardMaxNumPages + (((i - 1) & (NumShards - 1)) < numLeftOverPages);
+      std::lock_guard<std::mutex> lock(shards_[i]->mutex);
+      shards_[i]->cache.setMaxNumPages(std::max(shareMaxNumPages, 1));
+    }
+  }
+
+  [[nodiscard]] int getNumPages() const override {
+    int numPages = 0;
+    for (auto &shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      numPages += shard->cache.getNumPages();
+    }
+    return numPages;
+  }
+
+  Page *fetchPage(unsigned pageId, int createFlag) override {
+    auto &shard = getShard(pageId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.cache.fetchPage(pageId, createFlag);
+  }
+
+  static constexpr bool kSynchronizesItself = true;
+
+  /**
+   * Fetch a page for `xFetch`, which may be called from several threads at
+   * once, recording the fetch and its reuse distance in the counters of the
+   * page's shard under the shard's lock.
+   * @param pageId Page ID.
+   * @param createFlag 0, 1 or 2, as passed to `xFetch`.
+   * @return Pointer to a page. May be null.
+   */
+  Page *fetchAndRecordPage(unsigned pageId, int createFlag) {
+    auto &shard = getShard(pageId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return PageCacheMethods<ShardImplementation>::fetchAndRecordPage(
+        shard.cache, pageId, createFlag);
+  }
+
+  void unpinPage(Page *page, bool discard) override {
+    auto &shard = getShard(page->pageId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.unpinPage(page, discard);
+  }
+
+  void changePageId(Page *page, unsigned newPageId) override {
+    auto &oldShard = getShard(page->pageId);
+    auto &newShard = getShard(newPageId);
+    if (&oldShard == &newShard) {
+      std::lock_guard<std::mutex> lock(oldShard.mutex);
+      oldShard.cache.changePageId(page, newPageId);
+    }
+    else {
+      std::scoped_lock lock(oldShard.mutex, newShard.mutex);
+      oldShard.cache.detachPage(page);
+      newShard.cache.attachPage(page, newPageId);
+    }
+  }
+
+  void discardPages(unsigned pageIdLimit) override {
+    for (auto &shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      shard->cache.discardPages(pageIdLimit);
+    }
+  }
+
+  bool evictPage() override {
+    // Start at a different shard each time, so that evictions are spread
+    // evenly over the shards.
+    for (unsigned i = 0; i < NumShards; ++i) {
+      auto &shard = *shards_[nextEvictedShard_.fetch_add(
+                                 1, std::memory_order_relaxed) &
+                             (NumShards - 1)];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      if (shard.cache.evictPage()) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  std::size_t releaseMemory() override {
+    std::size_t numBytes = 0;
+    for (auto &shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      numBytes += shard->cache.releaseMemory();
+    }
+    return numBytes;
+  }
+
+  [[nodiscard]] unsigned long long getNumFetches() const override {
+    unsigned long long numFetches = 0;
+    for (auto &shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      numFetches += shard->cache.getNumFetches();
+    }
+    return numFetches;
+  }
+
+  [[nodiscard]] unsigned long long getNumHits() const override {
+    unsigned long long numHits = 0;
+    for (auto &shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      numHits += shard->cache.getNumHits();
+    }
+    return numHits;
+  }
+
+  [[nodiscard]] unsigned long long getNumRestores() const override {
+    unsigned long long numRestores = 0;
+    for (auto &shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      numRestores += shard->cache.getNumRestores();
+    }
+    return numRestores;
+  }
+
+  /**
+   * Take a snapshot of the statistics of the cache: the calls recorded on the
+   * cache itself plus the counts of every shard, which include the failed
+   * fetches, the fetch latencies and the reuse distances. The high-water mark
+   * of pinned pages is the sum of those of the shards.
+   * @return Statistics of the cache, without its cache ID.
+   */
+  [[nodiscard]] PageCacheStatistics getStatistics() const override {
+    auto statistics = PageCache::getStatistics();
+    for (auto &shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      statistics.add(shard->cache.getStatistics());
+    }
+    return statistics;
+  }
+
+protected:
+  /**
+   * A sharded cache synchronizes itself and keeps the memory of its shards,
+   * so it stays out of the page pool and its lock.
+   * @return False.
+   */
+  [[nodiscard]] bool canJoinPagePool() const override { return false; }
+
+private:
+  /** A shard sits on its own cache lines so that locks do not false share. */
+  struct alignas(64) Shard {
+    Shard(int pageSize, int extraSize) : cache(pageSize, extraSize) {}
+
+    mutable std::mutex mutex;
+    ShardImplementation cache;
+  };
+
+  Shard &getShard(unsigned pageId) {
+    return *shards_[pageId & (NumShards - 1)];
+  }
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  /** Shard `evictPage` tries first. */
+  std::atomic<unsigned> nextEvictedShard_;
+};
+
+#endif
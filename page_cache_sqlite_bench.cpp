@@ -0,0 +1,510 @@
+/**
+ * End-to-end benchmark of the replacement policies inside SQLite. Each policy
+ * is registered with `sqlite3_config(SQLITE_CONFIG_PCACHE2, ...)` in turn and
+ * runs every workload against a fresh copy of an on-disk database, with
+ * SQLite's own pcache1 as the baseline. Each result is printed as one JSON
+ * object per line.
+ *
+ *   page_cache_sqlite_bench [--policies p,...] [--workloads w,...]
+ *                           [--cache-sizes n,...] [--rows n] [--ops n]
+ *                           [--db path] [--huge-pages 0|1]
+ *                           [--victim-tier bytes] [--eviction-reserve n]
+ *
+ * Workloads, all on a table of `--rows` accounts with an index on the branch:
+ *   oltp       transactions of ten point reads, updates and inserts by
+ *              primary key, 70/20/10
+ *   analytical range scans by primary key and aggregates over branch ranges
+ *              through the index, one op per query
+ *   index      CREATE INDEX on three columns of the table, one op per index
+ *
+ * `--huge-pages 1` allocates the pages of the policies with the huge page
+ * layout of `PageAllocator`. `--victim-tier bytes` gives each cache of the
+ * policies a `VictimTier` of that budget. `--eviction-reserve n` has the
+ * eviction worker of the page pool keep `n` free slots for each cache.
+ *
+ * Policies: pcache1 and the names in page_cache_policies.hpp. Cache sizes are
+ * given to `PRAGMA cache_size` in pages. The hit ratio comes from
+ * `SQLITE_DBSTATUS_CACHE_HIT` and `SQLITE_DBSTATUS_CACHE_MISS`. The memory
+ * high-water mark covers SQLite's allocations and the global operator new,
+ * measured with `malloc_usable_size`, plus the chunks the policies map for
+ * their pages, which only grow during a run. Synchronous writes are off, so
+ * the timings measure the cache rather than the disk.
+ */
+
+#include "dependencies/sqlite/sqlite3.h"
+#include "page_cache_policies.hpp"
+
+#include <malloc.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::atomic<long long> numBytesInUse(0);
+
+std::atomic<long long> maxNumBytesInUse(0);
+
+void addBytesInUse(long long numBytes) {
+  auto inUse = numBytesInUse.fetch_add(numBytes, std::memory_order_relaxed) +
+               numBytes;
+  auto maxInUse = maxNumBytesInUse.load(std::memory_order_relaxed);
+  while (inUse > maxInUse &&
+         !maxNumBytesInUse.compare_exchange_weak(maxInUse, inUse,
+                                                 std::memory_order_relaxed)) {
+  }
+}
+
+void *countedMalloc(std::size_t size) {
+  auto memory = std::malloc(size > 0 ? size : 1);
+  if (memory != nullptr) {
+    addBytesInUse((long long)malloc_usable_size(memory));
+  }
+  return memory;
+}
+
+void countedFree(void *memory) {
+  if (memory != nullptr) {
+    addBytesInUse(-(long long)malloc_usable_size(memory));
+    std::free(memory);
+  }
+}
+
+void *countedAllocate(std::size_t size, std::size_t alignment) {
+  void *memory = nullptr;
+  if (alignment <= alignof(std::max_align_t)) {
+    memory = countedMalloc(size);
+  }
+  else if (posix_memalign(&memory, alignment, size > 0 ? size : 1) == 0) {
+    addBytesInUse((long long)malloc_usable_size(memory));
+  }
+  else {
+    memory = nullptr;
+  }
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+} // namespace
+
+void *operator new(std::size_t size) {
+  return countedAllocate(size, alignof(std::max_align_t));
+}
+
+void *operator new[](std::size_t size) {
+  return countedAllocate(size, alignof(std::max_align_t));
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+  return countedAllocate(size, (std::size_t)alignment);
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+  return countedAllocate(size, (std::size_t)alignment);
+}
+
+void operator delete(void *memory) noexcept { countedFree(memory); }
+
+void operator delete[](void *memory) noexcept { countedFree(memory); }
+
+void operator delete(void *memory, std::size_t) noexcept {
+  countedFree(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept {
+  countedFree(memory);
+}
+
+void operator delete(void *memory, std::align_val_t) noexcept {
+  countedFree(memory);
+}
+
+void operator delete[](void *memory, std::align_val_t) noexcept {
+  countedFree(memory);
+}
+
+void operator delete(void *memory, std::size_t, std::align_val_t) noexcept {
+  countedFree(memory);
+}
+
+void operator delete[](void *memory, std::size_t, std::align_val_t) noexcept {
+  countedFree(memory);
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/** SQLite's allocator, counted like operator new. */
+const sqlite3_mem_methods kCountedMemMethods = {
+    [](int size) { return countedMalloc((std::size_t)size); },
+    countedFree,
+    [](void *memory, int size) -> void * {
+      auto oldSize = memory != nullptr ? malloc_usable_size(memory) : 0;
+      auto newMemory = std::realloc(memory, (std::size_t)(size > 0 ? size : 1));
+      if (newMemory != nullptr) {
+        addBytesInUse((long long)malloc_usable_size(newMemory) -
+                      (long long)oldSize);
+      }
+      return newMemory;
+    },
+    [](void *memory) { return (int)malloc_usable_size(memory); },
+    [](int size) { return (size + 7) & ~7; },
+    [](void *) { return SQLITE_OK; },
+    [](void *) {},
+    nullptr,
+};
+
+struct SqlitePolicy {
+  const char *name;
+  const sqlite3_pcache_methods2 *methods;
+};
+
+template <typename PageCacheImplementation>
+const sqlite3_pcache_methods2 *getMethods() {
+  static const PageCacheMethods<PageCacheImplementation> methods;
+  return &methods;
+}
+
+/** SQLite's default page cache, saved before any other is registered. */
+sqlite3_pcache_methods2 pcache1Methods;
+
+const SqlitePolicy kSqlitePolicies[] = {
+    {"pcache1", &pcache1Methods},
+    {"lru", getMethods<LRUReplacementPageCache>()},
+    {"array-lru", getMethods<ArrayLRUReplacementPageCache>()},
+    {"lru2", getMethods<LRU2ReplacementPageCache>()},
+    {"clock", getMethods<ClockReplacementPageCache>()},
+    {"clockpro", getMethods<ClockProReplacementPageCache>()},
+    {"arc", getMethods<ARCReplacementPageCache>()},
+    {"tinylfu", getMethods<TinyLFUPageCache>()},
+    {"sharded-lru", getMethods<ShardedPageCache<LRUReplacementPageCache>>()},
+};
+
+struct Options {
+  std::vector<const SqlitePolicy *> policies;
+  std::vector<std::string> workloads = {"oltp", "analytical", "index"};
+  std::vector<int> cacheSizes = {100, 1000, 10000};
+  unsigned numRows = 200000;
+  unsigned numOps = 100000;
+  std::string databasePath = "page_cache_sqlite_bench.db";
+};
+
+void check(sqlite3 *db, int rc, const char *what) {
+  if (rc != SQLITE_OK && rc != SQLITE_ROW && rc != SQLITE_DONE) {
+    std::fprintf(stderr, "%s: %s\n", what,
+                 db != nullptr ? sqlite3_errmsg(db) : sqlite3_errstr(rc));
+    std::exit(1);
+  }
+}
+
+void execute(sqlite3 *db, const char *sql) {
+  check(db, sqlite3_exec(db, sql, nullptr, nullptr, nullptr), sql);
+}
+
+/** A prepared statement, finalized when it goes out of scope. */
+class Statement {
+public:
+  Statement(sqlite3 *db, const char *sql) : db_(db), statement_(nullptr) {
+    check(db, sqlite3_prepare_v2(db, sql, -1, &statement_, nullptr), sql);
+  }
+
+  ~Statement() { sqlite3_finalize(statement_); }
+
+  Statement(const Statement &) = delete;
+  Statement &operator=(const Statement &) = delete;
+
+  /**
+   * Bind integers to the parameters and step through every row.
+   * @param values - Values of the parameters, in order.
+   * @return Number of rows.
+   */
+  int run(std::initializer_list<long long> values) {
+    int parameter = 1;
+    for (auto value : values) {
+      sqlite3_bind_int64(statement_, parameter++, value);
+    }
+    int numRows = 0;
+    int rc;
+    while ((rc = sqlite3_step(statement_)) == SQLITE_ROW) {
+      ++numRows;
+    }
+    check(db_, rc, sqlite3_sql(statement_));
+    sqlite3_reset(statement_);
+    return numRows;
+  }
+
+private:
+  sqlite3 *db_;
+  sqlite3_stmt *statement_;
+};
+
+/**
+ * Create the database the workloads start from, using whichever page cache
+ * is registered.
+ */
+void createDatabase(const Options &options) {
+  std::remove(options.databasePath.c_str());
+  sqlite3 *db = nullptr;
+  check(db, sqlite3_open(options.databasePath.c_str(), &db),
+        options.databasePath.c_str());
+  execute(db, "PRAGMA synchronous=OFF;"
+              "CREATE TABLE accounts(id INTEGER PRIMARY KEY, branch INTEGER,"
+              " balance INTEGER, note TEXT);"
+              "CREATE INDEX accounts_branch ON accounts(branch);");
+  Statement insert(db, "WITH RECURSIVE ids(id) AS (SELECT 1 UNION ALL SELECT"
+                       " id + 1 FROM ids WHERE id < ?1) INSERT INTO accounts"
+                       " SELECT id, abs(random()) % 1000,"
+                       " abs(random()) % 100000, hex(randomblob(48))"
+                       " FROM ids");
+  execute(db, "BEGIN");
+  insert.run({(long long)options.numRows});
+  execute(db, "COMMIT");
+  sqlite3_close(db);
+}
+
+bool copyFile(const std::string &from, const std::string &to) {
+  std::ifstream input(from, std::ios::binary);
+  std::ofstream output(to, std::ios::binary | std::ios::trunc);
+  output << input.rdbuf();
+  return input.good() && output.good();
+}
+
+/** @return Number of ops. */
+unsigned runOltp(sqlite3 *db, const Options &options) {
+  Statement select(db, "SELECT balance FROM accounts WHERE id = ?1");
+  Statement update(db,
+                   "UPDATE accounts SET balance = balance + ?2 WHERE id = ?1");
+  Statement insert(db, "INSERT INTO accounts(branch, balance, note) VALUES"
+                       " (?1, ?2, hex(randomblob(48)))");
+  std::mt19937_64 random(1);
+  std::uniform_int_distribution<unsigned> ids(1, options.numRows);
+  for (unsigned i = 0; i < options.numOps; ++i) {
+    if (i % 10 == 0) {
+      execute(db, "BEGIN");
+    }
+    auto kind = random() % 10;
+    if (kind < 7) {
+      select.run({ids(random)});
+    }
+    else if (kind < 9) {
+      update.run({ids(random), (long long)(random() % 100)});
+    }
+    else {
+      insert.run({(long long)(random() % 1000), (long long)(random() % 100000)});
+    }
+    if (i % 10 == 9 || i + 1 == options.numOps) {
+      execute(db, "COMMIT");
+    }
+  }
+  return options.numOps;
+}
+
+/** @return Number of ops. */
+unsigned runAnalytical(sqlite3 *db, const Options &options) {
+  Statement rangeScan(db, "SELECT sum(balance), count(*) FROM accounts"
+                          " WHERE id BETWEEN ?1 AND ?1 + ?2");
+  Statement branchAggregate(db, "SELECT branch, avg(balance) FROM accounts"
+                                " WHERE branch BETWEEN ?1 AND ?1 + 9"
+                                " GROUP BY branch");
+  std::mt19937_64 random(2);
+  auto numOps = std::max(options.numOps / 100, 1u);
+  auto rangeLength = std::max(options.numRows / 100, 1u);
+  for (unsigned i = 0; i < numOps; ++i) {
+    if (i % 2 == 0) {
+      rangeScan.run({(long long)(random() % options.numRows + 1),
+                     (long long)rangeLength});
+    }
+    else {
+      branchAggregate.run({(long long)(random() % 1000)});
+    }
+  }
+  return numOps;
+}
+
+/** @return Number of ops. */
+unsigned runIndexBuild(sqlite3 *db, const Options &) {
+  const char *statements[] = {
+      "CREATE INDEX accounts_balance ON accounts(balance)",
+      "CREATE INDEX accounts_note ON accounts(note)",
+      "CREATE INDEX accounts_branch_balance ON accounts(branch, balance)",
+  };
+  for (auto sql : statements) {
+    execute(db, sql);
+  }
+  return sizeof(statements) / sizeof(statements[0]);
+}
+
+/**
+ * Run one workload on a fresh copy of the database with one policy
+ * registered, and print the result.
+ */
+void benchmark(const SqlitePolicy &policy, const Options &options,
+               const std::string &workload, int cacheSize) {
+  auto runPath = options.databasePath + ".run";
+  std::remove((runPath + "-journal").c_str());
+  if (!copyFile(options.databasePath, runPath)) {
+    std::fprintf(stderr, "cannot copy %s\n", options.databasePath.c_str());
+    std::exit(1);
+  }
+  sqlite3_shutdown();
+  check(nullptr, sqlite3_config(SQLITE_CONFIG_PCACHE2, policy.methods),
+        "SQLITE_CONFIG_PCACHE2");
+  check(nullptr, sqlite3_initialize(), "sqlite3_initialize");
+  auto startBytes = numBytesInUse.load();
+  maxNumBytesInUse.store(startBytes);
+  auto startMappedBytes = PageAllocator::getNumMappedBytes();
+  auto start = Clock::now();
+  sqlite3 *db = nullptr;
+  check(db, sqlite3_open(runPath.c_str(), &db), runPath.c_str());
+  auto pragmas = "PRAGMA synchronous=OFF; PRAGMA cache_size=" +
+                 std::to_string(cacheSize);
+  execute(db, pragmas.c_str());
+  unsigned numOps = 0;
+  if (workload == "oltp") {
+    numOps = runOltp(db, options);
+  }
+  else if (workload == "analytical") {
+    numOps = runAnalytical(db, options);
+  }
+  else {
+    numOps = runIndexBuild(db, options);
+  }
+  int numHits = 0;
+  int numMisses = 0;
+  int unused = 0;
+  sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_HIT, &numHits, &unused, 0);
+  sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_MISS, &numMisses, &unused, 0);
+  auto numMappedBytes =
+      (long long)(PageAllocator::getNumMappedBytes() - startMappedBytes);
+  sqlite3_close(db);
+  auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  auto numLookups = (double)numHits + (double)numMisses;
+  std::printf("{\"policy\":\"%s\",\"workload\":\"%s\",\"cache_size\":%d,"
+              "\"ops\":%u,\"seconds\":%.4f,\"ops_per_second\":%.1f,"
+              "\"hit_ratio\":%.4f,\"peak_bytes\":%lld}\n",
+              policy.name, workload.c_str(), cacheSize, numOps, seconds,
+              (double)numOps / seconds,
+              numLookups > 0 ? numHits / numLookups : 0.0,
+              maxNumBytesInUse.load() - startBytes + numMappedBytes);
+  std::fflush(stdout);
+  std::remove(runPath.c_str());
+}
+
+std::vector<std::string> splitList(const std::string &list) {
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+bool parseOptions(int argc, char **argv, Options &options) {
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string option = argv[i];
+    std::string value = argv[i + 1];
+    if (option == "--policies") {
+      for (const auto &name : splitList(value)) {
+        auto policy = std::find_if(
+            std::begin(kSqlitePolicies), std::end(kSqlitePolicies),
+            [&](const SqlitePolicy &policy) { return name == policy.name; });
+        if (policy == std::end(kSqlitePolicies)) {
+          std::fprintf(stderr, "unknown policy: %s\n", name.c_str());
+          return false;
+        }
+        options.policies.push_back(policy);
+      }
+    }
+    else if (option == "--workloads") {
+      options.workloads = splitList(value);
+      for (const auto &workload : options.workloads) {
+        if (workload != "oltp" && workload != "analytical" &&
+            workload != "index") {
+          std::fprintf(stderr, "unknown workload: %s\n", workload.c_str());
+          return false;
+        }
+      }
+    }
+    else if (option == "--cache-sizes") {
+      options.cacheSizes.clear();
+      for (const auto &cacheSize : splitList(value)) {
+        options.cacheSizes.push_back(std::max(std::atoi(cacheSize.c_str()), 1));
+      }
+    }
+    else if (option == "--rows") {
+      options.numRows = (unsigned)std::max(std::atoi(value.c_str()), 1);
+    }
+    else if (option == "--ops") {
+      options.numOps = (unsigned)std::max(std::atoi(value.c_str()), 1);
+    }
+    else if (option == "--db") {
+      options.databasePath = value;
+    }
+    else if (option == "--huge-pages") {
+      PageAllocator::setUseHugePages(std::atoi(value.c_str()) != 0);
+    }
+    else if (option == "--victim-tier") {
+      VictimTier::enable((std::size_t)std::max(std::atoll(value.c_str()), 0LL));
+    }
+    else if (option == "--eviction-reserve") {
+      PagePool::setEvictionReserve(std::atoi(value.c_str()));
+    }
+    else {
+      return false;
+    }
+  }
+  if (argc % 2 == 0) {
+    return false;
+  }
+  if (options.policies.empty()) {
+    for (const auto &policy : kSqlitePolicies) {
+      options.policies.push_back(&policy);
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    std::fprintf(stderr,
+                 "usage: page_cache_sqlite_bench [--policies p,...] "
+                 "[--workloads w,...] [--cache-sizes n,...] [--rows n] "
+                 "[--ops n] [--db path] [--huge-pages 0|1] "
+                 "[--victim-tier bytes] [--eviction-reserve n]\n");
+    return 1;
+  }
+  // Both must be set before SQLite initializes for the first time
+  check(nullptr, sqlite3_config(SQLITE_CONFIG_MALLOC, &kCountedMemMethods),
+        "SQLITE_CONFIG_MALLOC");
+  check(nullptr, sqlite3_config(SQLITE_CONFIG_GETPCACHE2, &pcache1Methods),
+        "SQLITE_CONFIG_GETPCACHE2");
+  createDatabase(options);
+  for (const auto &workload : options.workloads) {
+    for (auto cacheSize : options.cacheSizes) {
+      for (auto policy : options.policies) {
+        benchmark(*policy, options, workload, cacheSize);
+      }
+    }
+  }
+  sqlite3_shutdown();
+  std::remove(options.databasePath.c_str());
+  return 0;
+}
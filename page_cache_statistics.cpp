@@ -0,0 +1,202 @@
+#include "page_cache_statistics.hpp"
+#include "page_cache.hpp"
+
+#include <algorithm>
+#include <mutex>
+
+namespace {
+
+struct RegistryEntry {
+  PageCache *pageCache;
+  unsigned long long cacheId;
+  bool purgeable;
+};
+
+std::mutex registryMutex;
+
+std::vector<RegistryEntry> registryEntries;
+
+unsigned long long nextCacheId = 1;
+
+/** Accesses after which the reuse distance counts are halved. */
+constexpr unsigned long long kReuseDistanceAgingPeriod =
+    ReuseDistanceHistogram::kAccessWeight << 20;
+
+} // namespace
+
+int LatencyHistogram::getBucket(unsigned long long nanoseconds) {
+  if (nanoseconds == 0) {
+    return 0;
+  }
+  return std::min(63 - __builtin_clzll(nanoseconds), kNumBuckets - 1);
+}
+
+unsigned long long LatencyHistogram::getNumSamples() const {
+  unsigned long long numSamples = 0;
+  for (auto count : counts) {
+    numSamples += count;
+  }
+  return numSamples;
+}
+
+unsigned long long LatencyHistogram::getPercentile(double fraction) const {
+  auto numSamples = getNumSamples();
+  if (numSamples == 0) {
+    return 0;
+  }
+  // Rank of the percentile among the samples, counting from 1
+  auto rank = std::max((unsigned long long)(fraction * (double)numSamples +
+                                            0.5),
+                       1ull);
+  unsigned long long numBelow = 0;
+  for (int bucket = 0; bucket < kNumBuckets; ++bucket) {
+    numBelow += counts[bucket];
+    if (numBelow >= rank) {
+      return (2ull << bucket) - 1;
+    }
+  }
+  return (2ull << (kNumBuckets - 1)) - 1;
+}
+
+void PageCacheStatistics::add(const PageCacheStatistics &other) {
+  numPages += other.numPages;
+  numFetches += other.numFetches;
+  numHits += other.numHits;
+  numFailedFetches += other.numFailedFetches;
+  numEvictions += other.numEvictions;
+  numBackgroundEvictions += other.numBackgroundEvictions;
+  numRekeys += other.numRekeys;
+  numTruncations += other.numTruncations;
+  numTruncatedPages += other.numTruncatedPages;
+  numShrinks += other.numShrinks;
+  numReleasedBytes += other.numReleasedBytes;
+  maxNumPinnedPages += other.maxNumPinnedPages;
+  numOverheadBytesPerPage =
+      std::max(numOverheadBytesPerPage, other.numOverheadBytesPerPage);
+  numScanPages += other.numScanPages;
+  numCompressions += other.numCompressions;
+  numRestores += other.numRestores;
+  numTierPages += other.numTierPages;
+  numTierBytes += other.numTierBytes;
+  for (int bucket = 0; bucket < LatencyHistogram::kNumBuckets; ++bucket) {
+    hitLatencies.counts[bucket] += other.hitLatencies.counts[bucket];
+    restoreLatencies.counts[bucket] += other.restoreLatencies.counts[bucket];
+    missLatencies.counts[bucket] += other.missLatencies.counts[bucket];
+  }
+  for (int bucket = 0; bucket < ReuseDistanceHistogram::kNumBuckets;
+       ++bucket) {
+    reuseDistances.counts[bucket] += other.reuseDistances.counts[bucket];
+  }
+  reuseDistances.numSampledAccesses +=
+      other.reuseDistances.numSampledAccesses;
+  reuseDistances.numAccesses += other.reuseDistances.numAccesses;
+}
+
+void PageCacheCounters::recordFetchLatency(
+    FetchOutcome outcome, std::chrono::steady_clock::duration latency) {
+  auto nanoseconds =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count();
+  auto bucket = LatencyHistogram::getBucket(
+      nanoseconds > 0 ? (unsigned long long)nanoseconds : 0);
+  switch (outcome) {
+  case FetchOutcome::Hit:
+    ++hitLatencies_[bucket];
+    break;
+  case FetchOutcome::Restore:
+    ++restoreLatencies_[bucket];
+    break;
+  case FetchOutcome::Miss:
+    ++missLatencies_[bucket];
+    break;
+  }
+}
+
+std::vector<MissRatioCurvePoint>
+PageCacheStatistics::getMissRatioCurve() const {
+  return reuseDistances.getMissRatioCurve(maxNumPages, numBytesPerPage);
+}
+
+void PageCacheCounters::recordAccess(unsigned pageId) {
+#if PAGE_CACHE_STATISTICS
+  if (sampler_ == nullptr) {
+    sampler_.reset(new ReuseDistanceSampler());
+  }
+  numAccesses_.add(ReuseDistanceHistogram::kAccessWeight);
+  unsigned long long distance;
+  if (sampler_->sample(pageId, distance)) {
+    auto weight = sampler_->getWeight();
+    numSampledAccesses_.add(weight);
+    if (distance != ReuseDistanceSampler::kNoDistance) {
+      distance *= reuseDistanceScale_;
+      reuseDistances_[ReuseDistanceHistogram::getBucket(distance)].add(weight);
+    }
+  }
+  // Halve the counts now and then, so the curve follows the workload
+  if (numAccesses_ >= kReuseDistanceAgingPeriod) {
+    numAccesses_.subtract(numAccesses_ / 2);
+    numSampledAccesses_.subtract(numSampledAccesses_ / 2);
+    for (auto &count : reuseDistances_) {
+      count.subtract(count / 2);
+    }
+  }
+#else
+  (void)pageId;
+#endif
+}
+
+void PageCacheCounters::addTo(PageCacheStatistics &statistics) const {
+  statistics.numPages += numPages_;
+  statistics.numFailedFetches += numFailedFetches_;
+  statistics.numEvictions += numEvictions_;
+  statistics.numBackgroundEvictions += numBackgroundEvictions_;
+  statistics.numRekeys += numRekeys_;
+  statistics.numTruncations += numTruncations_;
+  statistics.numTruncatedPages += numTruncatedPages_;
+  statistics.numShrinks += numShrinks_;
+  statistics.numReleasedBytes += numReleasedBytes_;
+  statistics.maxNumPinnedPages += maxNumPinnedPages_;
+  statistics.numScanPages += numScanPages_;
+  statistics.numCompressions += numCompressions_;
+  statistics.numTierPages += numTierPages_;
+  statistics.numTierBytes += numTierBytes_;
+  for (int bucket = 0; bucket < LatencyHistogram::kNumBuckets; ++bucket) {
+    statistics.hitLatencies.counts[bucket] += hitLatencies_[bucket];
+    statistics.restoreLatencies.counts[bucket] += restoreLatencies_[bucket];
+    statistics.missLatencies.counts[bucket] += missLatencies_[bucket];
+  }
+  statistics.maxNumPages += (int)maxNumPages_;
+  for (int bucket = 0; bucket < ReuseDistanceHistogram::kNumBuckets;
+       ++bucket) {
+    statistics.reuseDistances.counts[bucket] += reuseDistances_[bucket];
+  }
+  statistics.reuseDistances.numSampledAccesses += numSampledAccesses_;
+  statistics.reuseDistances.numAccesses += numAccesses_;
+}
+
+void PageCacheRegistry::add(PageCache *pageCache, bool purgeable) {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  registryEntries.push_back({pageCache, nextCacheId++, purgeable});
+}
+
+void PageCacheRegistry::remove(PageCache *pageCache) {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  auto entry = std::find_if(registryEntries.begin(), registryEntries.end(),
+                            [pageCache](const RegistryEntry &entry) {
+                              return entry.pageCache == pageCache;
+                            });
+  if (entry != registryEntries.end()) {
+    registryEntries.erase(entry);
+  }
+}
+
+std::vector<PageCacheStatistics> PageCacheRegistry::getStatistics() {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  std::vector<PageCacheStatistics> statistics;
+  statistics.reserve(registryEntries.size());
+  for (const auto &entry : registryEntries) {
+    statistics.push_back(entry.pageCache->getStatistics());
+    statistics.back().cacheId = entry.cacheId;
+    statistics.back().purgeable = entry.purgeable;
+  }
+  return statistics;
+}
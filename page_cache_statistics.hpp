@@ -0,0 +1,469 @@
+#ifndef PAGE_CACHE_STATISTICS_HPP
+#define PAGE_CACHE_STATISTICS_HPP
+
+#include "miss_ratio_curve.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+/**
+ * Set to 0 to compile out the counters and latency histograms of
+ * `PageCacheCounters`. The fetch and hit counts of `PageCache` are kept
+ * either way.
+ */
+#ifndef PAGE_CACHE_STATISTICS
+#define PAGE_CACHE_STATISTICS 1
+#endif
+
+class PageCache;
+
+/**
+ * A counter that one thread at a time updates and any thread may read. The
+ * writer does a relaxed load and store rather than an atomic read-modify-write,
+ * so an update costs as much as on a plain integer.
+ */
+class StatisticsCounter {
+public:
+  StatisticsCounter() : value_(0) {}
+
+  StatisticsCounter(const StatisticsCounter &) = delete;
+  StatisticsCounter &operator=(const StatisticsCounter &) = delete;
+
+  StatisticsCounter &operator++() {
+    add(1);
+    return *this;
+  }
+
+  /**
+   * Add to the counter.
+   * @param amount Amount to add.
+   */
+  void add(unsigned long long amount) {
+    value_.store(value_.load(std::memory_order_relaxed) + amount,
+                 std::memory_order_relaxed);
+  }
+
+  /**
+   * Subtract from the counter.
+   * @param amount Amount to subtract.
+   */
+  void subtract(unsigned long long amount) {
+    value_.store(value_.load(std::memory_order_relaxed) - amount,
+                 std::memory_order_relaxed);
+  }
+
+  /**
+   * Set the counter.
+   * @param value New value.
+   */
+  void set(unsigned long long value) {
+    value_.store(value, std::memory_order_relaxed);
+  }
+
+  /**
+   * Raise the counter to a value if it is lower, for high-water marks.
+   * @param value Value to raise the counter to.
+   */
+  void raise(unsigned long long value) {
+    if (value > value_.load(std::memory_order_relaxed)) {
+      value_.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  operator unsigned long long() const {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<unsigned long long> value_;
+};
+
+/**
+ * A counter that several threads may update at once, with atomic
+ * read-modify-writes. For the counts of rare calls, which a cache that
+ * synchronizes itself may take from several threads at once.
+ */
+class SharedStatisticsCounter {
+public:
+  SharedStatisticsCounter() : value_(0) {}
+
+  SharedStatisticsCounter(const SharedStatisticsCounter &) = delete;
+  SharedStatisticsCounter &operator=(const SharedStatisticsCounter &) = delete;
+
+  SharedStatisticsCounter &operator++() {
+    add(1);
+    return *this;
+  }
+
+  /**
+   * Add to the counter.
+   * @param amount Amount to add.
+   */
+  void add(unsigned long long amount) {
+    value_.fetch_add(amount, std::memory_order_relaxed);
+  }
+
+  operator unsigned long long() const {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<unsigned long long> value_;
+};
+
+/**
+ * Stands in for `StatisticsCounter` and `SharedStatisticsCounter` when
+ * statistics are compiled out.
+ */
+class DisabledStatisticsCounter {
+public:
+  DisabledStatisticsCounter &operator++() { return *this; }
+
+  void add(unsigned long long) {}
+
+  void subtract(unsigned long long) {}
+
+  void set(unsigned long long) {}
+
+  void raise(unsigned long long) {}
+
+  operator unsigned long long() const { return 0; }
+};
+
+/**
+ * Latencies in power-of-two buckets. Bucket `i` counts latencies of at least
+ * 2^i and less than 2^(i + 1) nanoseconds, except that bucket 0 also counts
+ * latencies below 1 ns and the last bucket everything above.
+ */
+struct LatencyHistogram {
+  static constexpr int kNumBuckets = 32;
+
+  /**
+   * Get the bucket of a latency.
+   * @param nanoseconds Latency in nanoseconds.
+   * @return Index of the bucket.
+   */
+  static int getBucket(unsigned long long nanoseconds);
+
+  /**
+   * Get the total number of latencies.
+   * @return Sum of the buckets.
+   */
+  [[nodiscard]] unsigned long long getNumSamples() const;
+
+  /**
+   * Estimate a percentile as the upper bound of the bucket it falls in.
+   * @param fraction Fraction of the latencies at or below the percentile,
+   * between 0 and 1.
+   * @return Latency in nanoseconds, or 0 if there are no latencies.
+   */
+  [[nodiscard]] unsigned long long getPercentile(double fraction) const;
+
+  unsigned long long counts[kNumBuckets] = {};
+};
+
+/**
+ * Where a fetch found its page, to tell the latencies apart.
+ */
+enum class FetchOutcome {
+  /** The page was in the cache. */
+  Hit,
+
+  /** The page was restored from the victim tier. */
+  Restore,
+
+  /** The page was new, or the fetch failed. */
+  Miss
+};
+
+/**
+ * A snapshot of the statistics of one cache.
+ */
+struct PageCacheStatistics {
+  /**
+   * Add the counts of another snapshot, as for the shards of a cache. The
+   * high-water mark of pinned pages becomes the sum of both, an upper bound,
+   * and the overhead per page the larger of both.
+   * @param other Snapshot to add.
+   */
+  void add(const PageCacheStatistics &other);
+
+  /**
+   * Estimate the miss ratio curve of the cache from its reuse distances.
+   * @return Hit ratios of LRU caches of 0.25 to 4 times the maximum number of
+   * pages, or none if no fetch was sampled.
+   */
+  [[nodiscard]] std::vector<MissRatioCurvePoint> getMissRatioCurve() const;
+
+  /** Identifies the cache while it exists, in order of creation. */
+  unsigned long long cacheId = 0;
+
+  int pageSize = 0;
+
+  bool purgeable = false;
+
+  /** Maximum number of pages last set by SQLite. */
+  int maxNumPages = 0;
+
+  /** Approximate memory a page takes, with its extra space and metadata. */
+  std::size_t numBytesPerPage = 0;
+
+  /**
+   * Memory a page slot takes beyond the page buffer and the extra space: the
+   * page object with the policy's bookkeeping, and the padding of the slot.
+   */
+  std::size_t numOverheadBytesPerPage = 0;
+
+  /** Number of pages allocated by the cache, pinned or not. */
+  unsigned long long numPages = 0;
+
+  unsigned long long numFetches = 0;
+
+  unsigned long long numHits = 0;
+
+  /** Fetches with a nonzero create flag that returned a null pointer. */
+  unsigned long long numFailedFetches = 0;
+
+  /** Unpinned pages dropped or reused to stay within the maximum. */
+  unsigned long long numEvictions = 0;
+
+  /**
+   * Evictions made ahead of time by the eviction worker of the page pool,
+   * also counted in `numEvictions`.
+   */
+  unsigned long long numBackgroundEvictions = 0;
+
+  unsigned long long numRekeys = 0;
+
+  unsigned long long numTruncations = 0;
+
+  /** Pages discarded by truncations. */
+  unsigned long long numTruncatedPages = 0;
+
+  /** Calls to `xShrink`. */
+  unsigned long long numShrinks = 0;
+
+  /** Bytes the shrinks returned to the operating system. */
+  unsigned long long numReleasedBytes = 0;
+
+  /** High-water mark of the number of pinned pages. */
+  unsigned long long maxNumPinnedPages = 0;
+
+  /** Pages a scan brought in, unpinned to be replaced first. */
+  unsigned long long numScanPages = 0;
+
+  /** Evicted pages the victim tier kept compressed. */
+  unsigned long long numCompressions = 0;
+
+  /** Fetches that restored a page from the victim tier. */
+  unsigned long long numRestores = 0;
+
+  /** Number of pages in the victim tier. */
+  unsigned long long numTierPages = 0;
+
+  /** Memory the victim tier takes, in bytes. */
+  unsigned long long numTierBytes = 0;
+
+  /** Latencies of a sample of fetches that were hits. */
+  LatencyHistogram hitLatencies;
+
+  /** Latencies of a sample of fetches that restored a page. */
+  LatencyHistogram restoreLatencies;
+
+  /** Latencies of a sample of fetches that were misses. */
+  LatencyHistogram missLatencies;
+
+  /** Reuse distances of a sample of fetches, for the miss ratio curve. */
+  ReuseDistanceHistogram reuseDistances;
+};
+
+/**
+ * The counters a cache keeps beyond its fetches and hits. The policies record
+ * evictions, pinned pages and scan pages, the eviction worker of the page
+ * pool its evictions, and `PageCacheMethods` the rest, all while holding the
+ * cache's lock, so each cache has one writer at a time. A cache that
+ * synchronizes itself has no such lock: it records fetches in the counters of
+ * its parts, under their locks, and rekeys, truncations and shrinks are
+ * counted with atomic read-modify-writes. With `PAGE_CACHE_STATISTICS` 0,
+ * every function does nothing.
+ */
+class PageCacheCounters {
+public:
+  /** One in this many fetches is timed. */
+  static constexpr unsigned kLatencySamplePeriod = 64;
+
+  void recordFailedFetch() { ++numFailedFetches_; }
+
+  void recordEviction() { ++numEvictions_; }
+
+  void recordBackgroundEviction() { ++numBackgroundEvictions_; }
+
+  void recordRekey() { ++numRekeys_; }
+
+  /**
+   * Count a truncation.
+   * @param numPages Number of pages it discarded.
+   */
+  void recordTruncation(unsigned long long numPages) {
+    ++numTruncations_;
+    numTruncatedPages_.add(numPages);
+  }
+
+  /**
+   * Count a shrink.
+   * @param numBytes Number of bytes it returned to the operating system.
+   */
+  void recordShrink(std::size_t numBytes) {
+    ++numShrinks_;
+    numReleasedBytes_.add(numBytes);
+  }
+
+  /**
+   * Raise the high-water mark of pinned pages.
+   * @param numPinnedPages Number of pinned pages.
+   */
+  void recordNumPinnedPages(int numPinnedPages) {
+    maxNumPinnedPages_.raise((unsigned long long)numPinnedPages);
+  }
+
+  void recordScanPage() { ++numScanPages_; }
+
+  void recordCompression() { ++numCompressions_; }
+
+  /**
+   * Remember the size of the victim tier.
+   * @param numPages Number of pages in the tier.
+   * @param numBytes Memory the tier takes, in bytes.
+   */
+  void recordTierSize(int numPages, std::size_t numBytes) {
+    numTierPages_.set((unsigned long long)numPages);
+    numTierBytes_.set(numBytes);
+  }
+
+  void recordNewPage() { ++numPages_; }
+
+  void recordDeletedPage() { numPages_.subtract(1); }
+
+  /**
+   * Remember the maximum number of pages SQLite set.
+   * @param maxNumPages Maximum number of pages.
+   */
+  void recordMaxNumPages(int maxNumPages) {
+    maxNumPages_.set((unsigned long long)maxNumPages);
+  }
+
+  /**
+   * Count a fetch, and its reuse distance if its page is sampled.
+   * The sampler is created on the first call, so caches that are never
+   * fetched through `PageCacheMethods`, like a sharded cache whose shards
+   * record its fetches, do not pay for it.
+   * @param pageId Page ID.
+   */
+  void recordAccess(unsigned pageId);
+
+  /**
+   * Multiply the reuse distances measured from now on, for a shard that sees
+   * one in `scale` of the pages of its cache, and so a distance that many
+   * times shorter than the cache does.
+   * @param scale Factor of the distances.
+   */
+  void setReuseDistanceScale(unsigned scale) { reuseDistanceScale_ = scale; }
+
+  /**
+   * Decide whether to time the next fetch.
+   * @return True for one in `kLatencySamplePeriod` calls.
+   */
+  bool shouldSampleLatency() {
+#if PAGE_CACHE_STATISTICS
+    if (--numFetchesUntilSample_ == 0) {
+      numFetchesUntilSample_ = kLatencySamplePeriod;
+      return true;
+    }
+#endif
+    return false;
+  }
+
+  /**
+   * Count the latency of a sampled fetch.
+   * @param outcome Where the fetch found its page.
+   * @param latency Latency of the fetch.
+   */
+  void recordFetchLatency(FetchOutcome outcome,
+                          std::chrono::steady_clock::duration latency);
+
+  /**
+   * Add the counters to a snapshot.
+   * @param statistics Snapshot to add to.
+   */
+  void addTo(PageCacheStatistics &statistics) const;
+
+private:
+#if PAGE_CACHE_STATISTICS
+  using Counter = StatisticsCounter;
+  using SharedCounter = SharedStatisticsCounter;
+#else
+  using Counter = DisabledStatisticsCounter;
+  using SharedCounter = DisabledStatisticsCounter;
+#endif
+
+  Counter numPages_;
+  Counter numFailedFetches_;
+  Counter numEvictions_;
+  Counter numBackgroundEvictions_;
+  SharedCounter numRekeys_;
+  SharedCounter numTruncations_;
+  SharedCounter numTruncatedPages_;
+  SharedCounter numShrinks_;
+  SharedCounter numReleasedBytes_;
+  Counter maxNumPinnedPages_;
+  Counter numScanPages_;
+  Counter numCompressions_;
+  Counter numTierPages_;
+  Counter numTierBytes_;
+  Counter hitLatencies_[LatencyHistogram::kNumBuckets];
+  Counter restoreLatencies_[LatencyHistogram::kNumBuckets];
+  Counter missLatencies_[LatencyHistogram::kNumBuckets];
+  Counter maxNumPages_;
+  Counter numAccesses_;
+  Counter numSampledAccesses_;
+  Counter reuseDistances_[ReuseDistanceHistogram::kNumBuckets];
+
+  std::unique_ptr<ReuseDistanceSampler> sampler_;
+
+  /** Factor of the measured reuse distances. */
+  unsigned reuseDistanceScale_ = 1;
+
+  /** Fetches left until the next timed one. Only read by the writer. */
+  unsigned numFetchesUntilSample_ = kLatencySamplePeriod;
+};
+
+/**
+ * The caches created through `PageCacheMethods`, for reading their statistics
+ * from any thread. A cache is removed before it is destroyed, and snapshots
+ * are taken under the same lock.
+ */
+class PageCacheRegistry {
+public:
+  /**
+   * Add a cache and give it the next cache ID.
+   * @param pageCache Pointer to the cache.
+   * @param purgeable Whether SQLite can evict the cache's pages.
+   */
+  static void add(PageCache *pageCache, bool purgeable);
+
+  /**
+   * Remove a cache.
+   * @param pageCache Pointer to the cache.
+   */
+  static void remove(PageCache *pageCache);
+
+  /**
+   * Take a snapshot of the statistics of every cache.
+   * @return One snapshot per cache, in order of creation.
+   */
+  static std::vector<PageCacheStatistics> getStatistics();
+};
+
+#endif
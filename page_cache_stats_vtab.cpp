@@ -0,0 +1,326 @@
+#include "page_cache_stats_vtab.hpp"
+#include "page_cache_statistics.hpp"
+
+#include <vector>
+
+namespace {
+
+enum StatsColumn {
+  CacheId,
+  PageSize,
+  Purgeable,
+  Pages,
+  Fetches,
+  Hits,
+  HitRatio,
+  FailedFetches,
+  Evictions,
+  BackgroundEvictions,
+  Rekeys,
+  Truncations,
+  TruncatedPages,
+  Shrinks,
+  ReleasedBytes,
+  MaxPinnedPages,
+  OverheadBytes,
+  ScanPages,
+  Compressions,
+  Restores,
+  TierPages,
+  TierBytes,
+  LatencySamples,
+  HitP50Ns,
+  HitP99Ns,
+  RestoreP50Ns,
+  RestoreP99Ns,
+  MissP50Ns,
+  MissP99Ns
+};
+
+enum MissRatioCurveColumn {
+  CurveCacheId,
+  Scale,
+  CurvePages,
+  Bytes,
+  CurveHitRatio
+};
+
+/** Set a latency percentile as the result, or null if nothing was sampled. */
+int resultPercentile(sqlite3_context *context,
+                     const LatencyHistogram &histogram, double fraction) {
+  if (histogram.getNumSamples() == 0) {
+    sqlite3_result_null(context);
+  }
+  else {
+    sqlite3_result_int64(context,
+                         (sqlite3_int64)histogram.getPercentile(fraction));
+  }
+  return SQLITE_OK;
+}
+
+/**
+ * Rows of `page_cache_stats`: one snapshot per cache.
+ */
+struct StatsTable {
+  using Row = PageCacheStatistics;
+
+  static constexpr const char *kSchema =
+      "CREATE TABLE x(cache_id INTEGER, page_size INTEGER, purgeable INTEGER,"
+      " pages INTEGER, fetches INTEGER, hits INTEGER, hit_ratio REAL,"
+      " failed_fetches INTEGER, evictions INTEGER,"
+      " background_evictions INTEGER, rekeys INTEGER,"
+      " truncations INTEGER, truncated_pages INTEGER, shrinks INTEGER,"
+      " released_bytes INTEGER, max_pinned_pages INTEGER,"
+      " overhead_bytes INTEGER, scan_pages INTEGER, compressions INTEGER,"
+      " restores INTEGER, tier_pages INTEGER, tier_bytes INTEGER,"
+      " latency_samples INTEGER,"
+      " hit_p50_ns INTEGER, hit_p99_ns INTEGER, restore_p50_ns INTEGER,"
+      " restore_p99_ns INTEGER, miss_p50_ns INTEGER, miss_p99_ns INTEGER)";
+
+  static std::vector<Row> getRows() {
+    return PageCacheRegistry::getStatistics();
+  }
+
+  static int resultColumn(sqlite3_context *context, const Row &statistics,
+                          int column) {
+    sqlite3_int64 value = 0;
+    switch (column) {
+    case CacheId:
+      value = (sqlite3_int64)statistics.cacheId;
+      break;
+    case PageSize:
+      value = statistics.pageSize;
+      break;
+    case Purgeable:
+      value = statistics.purgeable ? 1 : 0;
+      break;
+    case Pages:
+      value = (sqlite3_int64)statistics.numPages;
+      break;
+    case Fetches:
+      value = (sqlite3_int64)statistics.numFetches;
+      break;
+    case Hits:
+      value = (sqlite3_int64)statistics.numHits;
+      break;
+    case HitRatio:
+      if (statistics.numFetches == 0) {
+        sqlite3_result_null(context);
+      }
+      else {
+        sqlite3_result_double(context, (double)statistics.numHits /
+                                           (double)statistics.numFetches);
+      }
+      return SQLITE_OK;
+    case FailedFetches:
+      value = (sqlite3_int64)statistics.numFailedFetches;
+      break;
+    case Evictions:
+      value = (sqlite3_int64)statistics.numEvictions;
+      break;
+    case BackgroundEvictions:
+      value = (sqlite3_int64)statistics.numBackgroundEvictions;
+      break;
+    case Rekeys:
+      value = (sqlite3_int64)statistics.numRekeys;
+      break;
+    case Truncations:
+      value = (sqlite3_int64)statistics.numTruncations;
+      break;
+    case TruncatedPages:
+      value = (sqlite3_int64)statistics.numTruncatedPages;
+      break;
+    case Shrinks:
+      value = (sqlite3_int64)statistics.numShrinks;
+      break;
+    case ReleasedBytes:
+      value = (sqlite3_int64)statistics.numReleasedBytes;
+      break;
+    case MaxPinnedPages:
+      value = (sqlite3_int64)statistics.maxNumPinnedPages;
+      break;
+    case OverheadBytes:
+      value = (sqlite3_int64)statistics.numOverheadBytesPerPage;
+      break;
+    case ScanPages:
+      value = (sqlite3_int64)statistics.numScanPages;
+      break;
+    case Compressions:
+      value = (sqlite3_int64)statistics.numCompressions;
+      break;
+    case Restores:
+      value = (sqlite3_int64)statistics.numRestores;
+      break;
+    case TierPages:
+      value = (sqlite3_int64)statistics.numTierPages;
+      break;
+    case TierBytes:
+      value = (sqlite3_int64)statistics.numTierBytes;
+      break;
+    case LatencySamples:
+      value = (sqlite3_int64)(statistics.hitLatencies.getNumSamples() +
+                              statistics.restoreLatencies.getNumSamples() +
+                              statistics.missLatencies.getNumSamples());
+      break;
+    case HitP50Ns:
+      return resultPercentile(context, statistics.hitLatencies, 0.5);
+    case HitP99Ns:
+      return resultPercentile(context, statistics.hitLatencies, 0.99);
+    case RestoreP50Ns:
+      return resultPercentile(context, statistics.restoreLatencies, 0.5);
+    case RestoreP99Ns:
+      return resultPercentile(context, statistics.restoreLatencies, 0.99);
+    case MissP50Ns:
+      return resultPercentile(context, statistics.missLatencies, 0.5);
+    case MissP99Ns:
+      return resultPercentile(context, statistics.missLatencies, 0.99);
+    default:
+      break;
+    }
+    sqlite3_result_int64(context, value);
+    return SQLITE_OK;
+  }
+};
+
+/**
+ * Rows of `page_cache_mrc`: the points of the miss ratio curve of every cache.
+ */
+struct MissRatioCurveTable {
+  struct Row {
+    unsigned long long cacheId;
+    MissRatioCurvePoint point;
+  };
+
+  static constexpr const char *kSchema =
+      "CREATE TABLE x(cache_id INTEGER, scale REAL, pages INTEGER,"
+      " bytes INTEGER, hit_ratio REAL)";
+
+  static std::vector<Row> getRows() {
+    std::vector<Row> rows;
+    for (const auto &statistics : PageCacheRegistry::getStatistics()) {
+      for (const auto &point : statistics.getMissRatioCurve()) {
+        rows.push_back({statistics.cacheId, point});
+      }
+    }
+    return rows;
+  }
+
+  static int resultColumn(sqlite3_context *context, const Row &row,
+                          int column) {
+    switch (column) {
+    case CurveCacheId:
+      sqlite3_result_int64(context, (sqlite3_int64)row.cacheId);
+      break;
+    case Scale:
+      sqlite3_result_double(context, row.point.scale);
+      break;
+    case CurvePages:
+      sqlite3_result_int64(context, row.point.numPages);
+      break;
+    case Bytes:
+      sqlite3_result_int64(context, (sqlite3_int64)row.point.numBytes);
+      break;
+    case CurveHitRatio:
+      sqlite3_result_double(context, row.point.hitRatio);
+      break;
+    default:
+      sqlite3_result_null(context);
+      break;
+    }
+    return SQLITE_OK;
+  }
+};
+
+/**
+ * Read-only eponymous table whose rows `Table` computes when a query starts.
+ */
+template <typename Table> struct SnapshotModule : sqlite3_module {
+  struct Cursor : sqlite3_vtab_cursor {
+    /** Snapshot taken by `xFilter`. */
+    std::vector<typename Table::Row> rows;
+
+    std::size_t row = 0;
+  };
+
+  SnapshotModule() : sqlite3_module() {
+    // Eponymous only: the table exists on every connection and cannot be
+    // created with CREATE VIRTUAL TABLE.
+    xCreate = nullptr;
+
+    xConnect = [](sqlite3 *db, void *, int, const char *const *,
+                  sqlite3_vtab **table, char **) {
+      auto rc = sqlite3_declare_vtab(db, Table::kSchema);
+      if (rc != SQLITE_OK) {
+        return rc;
+      }
+      *table = new sqlite3_vtab();
+      return SQLITE_OK;
+    };
+
+    xBestIndex = [](sqlite3_vtab *, sqlite3_index_info *indexInfo) {
+      indexInfo->estimatedCost = 100;
+      indexInfo->estimatedRows = 100;
+      return SQLITE_OK;
+    };
+
+    xDisconnect = [](sqlite3_vtab *table) {
+      delete table;
+      return SQLITE_OK;
+    };
+
+    xOpen = [](sqlite3_vtab *, sqlite3_vtab_cursor **cursor) {
+      *cursor = new Cursor();
+      return SQLITE_OK;
+    };
+
+    xClose = [](sqlite3_vtab_cursor *cursor) {
+      delete (Cursor *)cursor;
+      return SQLITE_OK;
+    };
+
+    xFilter = [](sqlite3_vtab_cursor *cursorBase, int, const char *, int,
+                 sqlite3_value **) {
+      auto cursor = (Cursor *)cursorBase;
+      cursor->rows = Table::getRows();
+      cursor->row = 0;
+      return SQLITE_OK;
+    };
+
+    xNext = [](sqlite3_vtab_cursor *cursorBase) {
+      ++((Cursor *)cursorBase)->row;
+      return SQLITE_OK;
+    };
+
+    xEof = [](sqlite3_vtab_cursor *cursorBase) {
+      auto cursor = (Cursor *)cursorBase;
+      return cursor->row >= cursor->rows.size() ? 1 : 0;
+    };
+
+    xColumn = [](sqlite3_vtab_cursor *cursorBase, sqlite3_context *context,
+                 int column) {
+      auto cursor = (Cursor *)cursorBase;
+      return Table::resultColumn(context, cursor->rows[cursor->row], column);
+    };
+
+    xRowid = [](sqlite3_vtab_cursor *cursorBase, sqlite3_int64 *rowId) {
+      *rowId = (sqlite3_int64)((Cursor *)cursorBase)->row;
+      return SQLITE_OK;
+    };
+  }
+};
+
+const SnapshotModule<StatsTable> kStatsModule;
+
+const SnapshotModule<MissRatioCurveTable> kMissRatioCurveModule;
+
+} // namespace
+
+int pageCacheStatsInit(sqlite3 *db, char **, const sqlite3_api_routines *) {
+  auto rc =
+      sqlite3_create_module(db, "page_cache_stats", &kStatsModule, nullptr);
+  if (rc != SQLITE_OK) {
+    return rc;
+  }
+  return sqlite3_create_module(db, "page_cache_mrc", &kMissRatioCurveModule,
+                               nullptr);
+}
@@ -0,0 +1,30 @@
+#ifndef PAGE_CACHE_STATS_VTAB_HPP
+#define PAGE_CACHE_STATS_VTAB_HPP
+
+#include "dependencies/sqlite/sqlite3.h"
+
+/**
+ * Register the eponymous virtual tables `page_cache_stats` and
+ * `page_cache_mrc` on a connection. Querying `page_cache_stats` takes a
+ * snapshot of the statistics of every cache created through
+ * `PageCacheMethods`, one row per cache:
+ *
+ *   SELECT cache_id, pages, hit_ratio, evictions, miss_p99_ns
+ *   FROM page_cache_stats;
+ *
+ * `page_cache_mrc` has the miss ratio curve of every cache, one row per size
+ * from 0.25 to 4 times its maximum number of pages:
+ *
+ *   SELECT cache_id, scale, pages, bytes, hit_ratio FROM page_cache_mrc;
+ *
+ * Has the signature of an extension entry point, so that
+ * `sqlite3_auto_extension` can register the tables on every new connection.
+ * @param db Connection.
+ * @param errorMessage Unused.
+ * @param api Unused.
+ * @return SQLite result code.
+ */
+int pageCacheStatsInit(sqlite3 *db, char **errorMessage,
+                       const sqlite3_api_routines *api);
+
+#endif
@@ -0,0 +1,316 @@
+/**
+ * Checks every policy against the contract of SQLite's page cache while the
+ * page pool, a memory limit and the victim tier are all in play, calling the
+ * caches through `PageCacheMethods` as SQLite does. Prints one line per
+ * policy and exits with status 1 if any check failed.
+ *
+ *   page_cache_test
+ *
+ * Each round fills the cache with pages of incompressible and compressible
+ * content, then drops the memory limit of the page pool below what the cache
+ * holds, so that replacing a page makes the pool evict from the same cache
+ * while the policy is in the middle of the replacement. After each round:
+ *   - a page SQLite has initialized still holds the content written to it;
+ *   - no two cached page IDs share a buffer;
+ *   - `xPagecount` counts the pages that can be fetched;
+ *   - pinning every page ID at once, which drains the free slots of the
+ *     allocator, hands out distinct buffers.
+ *
+ * W-TinyLFU runs a second time with the capacity tuned under a memory budget
+ * below what the cache holds, so the tuner shrinks it a few pages per fetch;
+ * it must end up within the budget. Resizing the frequency sketch must keep
+ * the frequencies it has seen.
+ *
+ * LRU-2 must evict in the order of the penultimate unpinnings while their
+ * sequence numbers cross 2^32 and wrap past 2^64, and the array LRU in the
+ * order of the unpinnings while it renumbers its 32-bit stamps.
+ */
+
+#include "dependencies/sqlite/sqlite3.h"
+#include "page_cache_policies.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <set>
+#include <vector>
+
+namespace {
+
+constexpr int kPageSize = 4096;
+
+constexpr int kExtraSize = 16;
+
+constexpr unsigned kMaxNumPages = 64;
+
+constexpr unsigned kNumPageIds = 4 * kMaxNumPages;
+
+constexpr int kNumRounds = 50;
+
+struct TestPolicy {
+  const char *name;
+  const sqlite3_pcache_methods2 *methods;
+
+  /** Tune the capacity under a budget of a quarter of the pages. */
+  bool tuned;
+};
+
+template <typename PageCacheImplementation>
+const sqlite3_pcache_methods2 *getMethods() {
+  static const PageCacheMethods<PageCacheImplementation> methods;
+  return &methods;
+}
+
+const TestPolicy kTestPolicies[] = {
+    {"lru", getMethods<LRUReplacementPageCache>(), false},
+    {"array-lru", getMethods<ArrayLRUReplacementPageCache>(), false},
+    {"lru2", getMethods<LRU2ReplacementPageCache>(), false},
+    {"clock", getMethods<ClockReplacementPageCache>(), false},
+    {"clockpro", getMethods<ClockProReplacementPageCache>(), false},
+    {"arc", getMethods<ARCReplacementPageCache>(), false},
+    {"tinylfu", getMethods<TinyLFUPageCache>(), false},
+    {"tinylfu-tuned", getMethods<TinyLFUPageCache>(), true},
+    {"sharded-lru", getMethods<ShardedPageCache<LRUReplacementPageCache>>(),
+     false},
+};
+
+/**
+ * Write the content of a page: its page ID, then random bytes for odd page
+ * IDs, which the victim tier cannot compress, and zeros for even ones.
+ */
+void writePage(sqlite3_pcache_page *page, unsigned pageId) {
+  std::memset(page->pBuf, 0, kPageSize);
+  if (pageId % 2 != 0) {
+    std::mt19937 random(pageId);
+    auto words = (std::uint32_t *)page->pBuf;
+    for (int i = 0; i < kPageSize / 4; ++i) {
+      words[i] = (std::uint32_t)random();
+    }
+  }
+  std::memcpy(page->pBuf, &pageId, sizeof(pageId));
+  // SQLite takes a page whose extra space starts with zero as uninitialized
+  *(void **)page->pExtra = page;
+}
+
+/**
+ * Fetch a page with `createFlag` 2 and check the content of an initialized
+ * page, then initialize it with its own content.
+ * @return Pointer to the page.
+ */
+sqlite3_pcache_page *fetchPage(const sqlite3_pcache_methods2 &methods,
+                               sqlite3_pcache *pageCache, unsigned pageId,
+                               int &numFailures) {
+  auto page = methods.xFetch(pageCache, pageId, 2);
+  if (*(void **)page->pExtra != nullptr &&
+      std::memcmp(page->pBuf, &pageId, sizeof(pageId)) != 0) {
+    std::printf("  page %u has the content of another page\n", pageId);
+    ++numFailures;
+  }
+  writePage(page, pageId);
+  return page;
+}
+
+/**
+ * Check the pages in the cache after a round.
+ */
+void checkPages(const sqlite3_pcache_methods2 &methods,
+                sqlite3_pcache *pageCache, int &numFailures) {
+  std::set<void *> buffers;
+  int numPages = 0;
+  for (unsigned pageId = 1; pageId <= kNumPageIds; ++pageId) {
+    if (auto page = methods.xFetch(pageCache, pageId, 0)) {
+      ++numPages;
+      if (!buffers.insert(page->pBuf).second) {
+        std::printf("  page %u shares its buffer\n", pageId);
+        ++numFailures;
+      }
+      methods.xUnpin(pageCache, page, 0);
+    }
+  }
+  if (numPages != methods.xPagecount(pageCache)) {
+    std::printf("  %d pages fetched, xPagecount %d\n", numPages,
+                methods.xPagecount(pageCache));
+    ++numFailures;
+  }
+  // Grow past the maximum with every page pinned, so the allocator hands out
+  // every free slot it has
+  std::vector<sqlite3_pcache_page *> pinnedPages;
+  buffers.clear();
+  for (unsigned pageId = 1; pageId <= kNumPageIds; ++pageId) {
+    auto page = fetchPage(methods, pageCache, pageId, numFailures);
+    if (!buffers.insert(page->pBuf).second) {
+      std::printf("  pinned page %u shares its buffer\n", pageId);
+      ++numFailures;
+    }
+    pinnedPages.push_back(page);
+  }
+  for (auto page : pinnedPages) {
+    methods.xUnpin(pageCache, page, 0);
+  }
+}
+
+/**
+ * Run the rounds against one policy.
+ * @return Number of failed checks.
+ */
+int test(const TestPolicy &policy) {
+  const auto &methods = *policy.methods;
+  methods.xInit(methods.pArg);
+  auto pageCache = methods.xCreate(kPageSize, kExtraSize, 1);
+  methods.xCachesize(pageCache, kMaxNumPages);
+  auto numBytesPerSlot = ((PageCache *)pageCache)->getNumBytesPerSlot();
+  if (policy.tuned) {
+    PageCacheTuning tuning;
+    tuning.memoryBudget = kMaxNumPages / 4 * numBytesPerSlot;
+    tuning.numFetchesPerDecision = 64;
+    tuning.numPagesPerShrinkStep = 2;
+    PageCacheTuner::enable(tuning);
+  }
+  std::mt19937 random(1);
+  int numFailures = 0;
+  for (int round = 0; round < kNumRounds; ++round) {
+    PagePool::setMemoryLimit(0);
+    for (unsigned i = 0; i < 4 * kMaxNumPages; ++i) {
+      auto pageId = 1 + (unsigned)random() % kNumPageIds;
+      methods.xUnpin(pageCache,
+                     fetchPage(methods, pageCache, pageId, numFailures), 0);
+    }
+    // Every replacement now evicts from the same cache to meet the limit
+    if (auto pagePool = PagePool::get()) {
+      PagePool::setMemoryLimit(pagePool->getNumBytes() / 8);
+    }
+    for (unsigned i = 0; i < kMaxNumPages; ++i) {
+      auto pageId = 1 + (unsigned)random() % kNumPageIds;
+      methods.xUnpin(pageCache,
+                     fetchPage(methods, pageCache, pageId, numFailures), 0);
+    }
+    PagePool::setMemoryLimit(0);
+    checkPages(methods, pageCache, numFailures);
+  }
+  if (policy.tuned) {
+    PageCacheTuner::disable();
+    auto numBytes = (std::size_t)methods.xPagecount(pageCache) * numBytesPerSlot;
+    if (numBytes > kMaxNumPages / 4 * numBytesPerSlot) {
+      std::printf("  %zu bytes of pages over a budget of %zu\n", numBytes,
+                  kMaxNumPages / 4 * numBytesPerSlot);
+      ++numFailures;
+    }
+  }
+  methods.xDestroy(pageCache);
+  methods.xShutdown(methods.pArg);
+  return numFailures;
+}
+
+/**
+ * Check that resizing the frequency sketch, as the tuner does to W-TinyLFU on
+ * every shrink step, keeps the frequencies it has seen.
+ * @return Number of failed checks.
+ */
+int testFrequencySketch() {
+  int numFailures = 0;
+  FrequencySketch sketch(4096);
+  for (int i = 0; i < 8; ++i) {
+    sketch.increment(7);
+  }
+  for (int capacity : {4000, 1000, 100, 4096, 1 << 16}) {
+    sketch.resize(capacity);
+    if (sketch.frequency(7) < 8) {
+      std::printf("  frequency %u after resizing to %d\n", sketch.frequency(7),
+                  capacity);
+      ++numFailures;
+    }
+  }
+  return numFailures;
+}
+
+/**
+ * Fetch new pages into a full cache, keeping them pinned, and check that each
+ * replaces the next page of `evictionOrder`.
+ * @return Number of failed checks.
+ */
+int checkEvictionOrder(PageCache &pageCache,
+                       const std::vector<unsigned> &evictionOrder) {
+  int numFailures = 0;
+  std::vector<Page *> newPages;
+  auto newPageId = (unsigned)evictionOrder.size();
+  for (auto pageId : evictionOrder) {
+    newPages.push_back(pageCache.fetchPage(++newPageId, 2));
+    if (auto page = pageCache.fetchPage(pageId, 0)) {
+      std::printf("  page %u outlived a page unpinned after it\n", pageId);
+      ++numFailures;
+      newPages.push_back(page);
+      break;
+    }
+  }
+  for (auto page : newPages) {
+    pageCache.unpinPage(page, false);
+  }
+  return numFailures;
+}
+
+/**
+ * Check that LRU-2 evicts pages in the order of their penultimate unpinnings
+ * when the sequence numbers of those unpinnings straddle `boundary`.
+ * @return Number of failed checks.
+ */
+int testLRU2Wraparound(unsigned long long boundary) {
+  constexpr unsigned kNumPages = 8;
+  LRU2ReplacementPageCache pageCache(kPageSize, kExtraSize);
+  pageCache.setMaxNumPages(kNumPages);
+  pageCache.setSequenceNumber(boundary - kNumPages / 2);
+  // Unpinning every page twice keys page n by the (n-1)-th sequence number
+  for (int pass = 0; pass < 2; ++pass) {
+    for (unsigned pageId = 1; pageId <= kNumPages; ++pageId) {
+      pageCache.unpinPage(pageCache.fetchPage(pageId, 2), false);
+    }
+  }
+  return checkEvictionOrder(pageCache, {1, 2, 3, 4, 5, 6, 7, 8});
+}
+
+/**
+ * Check that the array LRU evicts pages in the order of their unpinnings when
+ * its stamps run out halfway through them and are renumbered.
+ * @return Number of failed checks.
+ */
+int testArrayLRURenumbering() {
+  const std::vector<unsigned> unpinOrder = {3, 1, 4, 8, 5, 2, 7, 6};
+  ArrayLRUReplacementPageCache pageCache(kPageSize, kExtraSize);
+  pageCache.setMaxNumPages((int)unpinOrder.size());
+  std::vector<Page *> pages;
+  for (unsigned pageId = 1; pageId <= unpinOrder.size(); ++pageId) {
+    pages.push_back(pageCache.fetchPage(pageId, 2));
+  }
+  pageCache.setNextStamp(kPinnedStamp - (std::uint32_t)unpinOrder.size() / 2);
+  for (auto pageId : unpinOrder) {
+    pageCache.unpinPage(pages[pageId - 1], false);
+  }
+  return checkEvictionOrder(pageCache, unpinOrder);
+}
+
+} // namespace
+
+int main() {
+  VictimTier::enable(1 << 20);
+  int numFailures = 0;
+  for (const auto &policy : kTestPolicies) {
+    auto numPolicyFailures = test(policy);
+    std::printf("%-14s %s\n", policy.name,
+                numPolicyFailures == 0 ? "ok" : "FAILED");
+    numFailures += numPolicyFailures;
+  }
+  auto numSketchFailures = testFrequencySketch();
+  std::printf("%-14s %s\n", "sketch-resize",
+              numSketchFailures == 0 ? "ok" : "FAILED");
+  numFailures += numSketchFailures;
+  auto numWraparoundFailures =
+      testLRU2Wraparound(1ull << 32) + testLRU2Wraparound(0);
+  std::printf("%-14s %s\n", "lru2-wrap",
+              numWraparoundFailures == 0 ? "ok" : "FAILED");
+  numFailures += numWraparoundFailures;
+  auto numRenumberingFailures = testArrayLRURenumbering();
+  std::printf("%-14s %s\n", "array-lru-wrap",
+              numRenumberingFailures == 0 ? "ok" : "FAILED");
+  numFailures += numRenumberingFailures;
+  return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,346 @@
+#include "page_cache_tiny_lfu.hpp"
+
+#include <algorithm>
+
+/**
+ * Consruct a W-TinyLFU replacement policy Page.
+ * @param argBuffer - Page buffer.
+ * @param argExtra - Extra space.
+ * @param argPageId - Page ID.
+ * @param argPinned - The page's pin status.
+ */
+TinyLFUPageCache::TinyLFUPage::TinyLFUPage(void *argBuffer, void *argExtra,
+                                           unsigned argPageId, bool argPinned)
+    : Page(argBuffer, argExtra, argPageId), pinned(argPinned),
+      region(Region::Window), prev(nullptr), next(nullptr) {}
+
+/**
+ * Construct a PageCache.
+ * @param pageSize - Page size in bytes. Assumed to be a power of two.
+ * @param extraSize - Extra space in bytes. Assumed to be less than 250.
+ */
+TinyLFUPageCache::TinyLFUPageCache(int pageSize, int extraSize)
+    : PageCache(pageSize, extraSize, sizeof(TinyLFUPage)),
+      sketch(maxNumPages_), maxWindowSize(1), maxProtectedSize(0) {}
+
+/**
+ * Destructor of PageCache.
+ */
+TinyLFUPageCache::~TinyLFUPageCache() {
+  cachedPages.forEach(
+      [this](unsigned, TinyLFUPage *page) { deletePage(page); });
+  cachedPages.clear();
+}
+
+/**
+ * Set the maximum number of pages in the cache. Discard unpinned pages until
+ * either the number of pages in the cache is less than or equal to
+ * `maxNumPages` or all the pages in the cache are pinned. If there are still
+ * too many pages after discarding all unpinned pages, pages will continue to
+ * be discarded after being unpinned in the `unpinPage` function. The
+ * frequency sketch is resized, keeping the frequencies seen so far.
+ * @param maxNumPages - Maximum number of pages in the cache.
+ */
+void TinyLFUPageCache::setMaxNumPages(int maxNumPages) {
+  if (maxNumPages != maxNumPages_) {
+    sketch.resize(maxNumPages);
+  }
+  maxNumPages_ = maxNumPages;
+  maxWindowSize = std::max(maxNumPages / 100, 1);
+  maxProtectedSize = std::max(maxNumPages - maxWindowSize, 0) / 5 * 4;
+  while (getNumPages() > maxNumPages && evictPage()) {
+  }
+  rebalance();
+}
+
+/**
+ * Get the number of pages in the cache, both pinned and unpinned.
+ * @return Number of pages in the cache.
+ */
+int TinyLFUPageCache::getNumPages() const {
+  return (int)cachedPages.size();
+}
+
+/**
+ * Fetch and pin a page. If the page is already in the cache, return a
+ * pointer to the page. If the page is not already in the cache, use the
+ * `createFlag` parameter to determine how to proceed. If `createFlag` is 0,
+ * return a null pointer. Otherwise, examine the number of pages in the cache.
+ * If the number of pages in the cache is less than the maximum, allocate and
+ * return a pointer to a new page. If the number of pages in the cache is
+ * greater than or equal to the maximum, return a pointer to an existing
+ * unpinned page. If all pages are pinned, return a null pointer if
+ * `createFlag` is 1, or allocate a page beyond the maximum if it is 2.
+ * Hits and allocating misses are recorded in the frequency sketch, so the
+ * probe SQLite makes with `createFlag` 0 before allocating counts once.
+ * @param pageId - Page ID.
+ * @param createFlag - 0, 1 or 2, as passed to `xFetch`.
+ * @return Pointer to a page. May be null.
+ */
+Page *TinyLFUPageCache::fetchPage(unsigned pageId, int createFlag) {
+  ++numFetches_;
+  auto page = cachedPages.find(pageId);
+  // Page already in cache
+  if (page != nullptr) {
+    sketch.increment(pageId);
+    if (page->region == Region::Probation) {
+      movePage(page, Region::Protected);
+      rebalance();
+    }
+    else {
+      listOf(page->region).moveToMostRecent(page);
+    }
+    if (!page->pinned) {
+      countPin();
+    }
+    page->pinned = true;
+    ++numHits_;
+    return page;
+  }
+  // 'createFlag' 0, SQLite takes the page as not cached
+  if (createFlag == 0) {
+    forgetVictim(pageId);
+    return nullptr;
+  }
+  sketch.increment(pageId);
+  // Number of pages < maximum
+  if (getNumPages() < maxNumPages_) {
+    page = newPage<TinyLFUPage>(pageId, true);
+  }
+  // Number of pages >= maximum, or the page pool is out of memory
+  if (page == nullptr) {
+    page = selectVictim();
+    if (page != nullptr) {
+      listOf(page->region).remove(page);
+      cachedPages.erase(page->pageId);
+      counters_.recordEviction();
+      // The victim tier may keep the slot of the victim, so the page gets
+      // its own
+      if (keepsVictims()) {
+        deleteVictim(page);
+        page = newPageBeyondLimit<TinyLFUPage>(pageId, true);
+      }
+      else {
+        page->pinned = true;
+        page->reset();
+        page->pageId = pageId;
+      }
+    }
+    // All pages pinned, grow beyond the maximum if SQLite insists
+    else if (createFlag == 2) {
+      page = newPageBeyondLimit<TinyLFUPage>(pageId, true);
+    }
+    else {
+      return nullptr;
+    }
+  }
+  countPin();
+  page->region = Region::Window;
+  window.pushMostRecent(page);
+  cachedPages.insert(pageId, page);
+  rebalance();
+  return page;
+}
+
+/**
+ * Unpin a page. The page is unpinned regardless of the number of prior
+ * fetches, meaning it can be safely discarded. If `discard` is true, discard
+ * the page. If `discard` is false, examine the number of pages in the cache.
+ * If the number of pages in the cache is greater than the maximum, discard
+ * the page.
+ * @param page - Pointer to a page.
+ * @param discard - Discard the page.
+ */
+void TinyLFUPageCache::unpinPage(Page *page, bool discard) {
+  auto *thisPage = (TinyLFUPage *)page;
+  // Discard page if 'discard' true or number of pages grater than maximum
+  if (discard || getNumPages() > maxNumPages_) {
+    removePage(thisPage);
+    if (discard) {
+      deletePage(thisPage);
+    }
+    else {
+      counters_.recordEviction();
+      deleteVictim(thisPage);
+    }
+  }
+  // Unpin, the page keeps its place in its region
+  else {
+    thisPage->pinned = false;
+    countUnpin();
+  }
+}
+
+/**
+ * Change the page ID associated with a page. If a page with page ID
+ * `newPageId` is already in the cache, it is assumed that the page is
+ * unpinned, and the page is discarded.
+ * @param page - Pointer to a page.
+ * @param newPageId - New page ID.
+ */
+void TinyLFUPageCache::changePageId(Page *page, unsigned newPageId) {
+  auto *thisPage = (TinyLFUPage *)page;
+  auto searchedPage = cachedPages.find(newPageId);
+  // Page found, already in cache, having 'newPageId' as its page ID. Discard.
+  if (searchedPage != nullptr) {
+    removePage(searchedPage);
+    deletePage(searchedPage);
+  }
+  // The victim tier's image of the new page ID is out of date
+  forgetVictim(newPageId);
+  cachedPages.erase(thisPage->pageId);
+  thisPage->pageId = newPageId;
+  cachedPages.insert(newPageId, thisPage);
+}
+
+/**
+ * Discard all pages with page IDs greater than or equal to `pageIdLimit`. If
+ * any of these pages are pinned, then they are implicitly unpinned, meaning
+ * they can be safely discarded.
+ * @param pageIdLimit - Page ID limit.
+ */
+void TinyLFUPageCache::discardPages(unsigned pageIdLimit) {
+  forgetVictims(pageIdLimit);
+  cachedPages.eraseFrom(
+      pageIdLimit, [this](unsigned, TinyLFUPage *page) {
+        if (page->pinned) {
+          countUnpin();
+        }
+        listOf(page->region).remove(page);
+        deletePage(page);
+      });
+}
+
+/**
+ * Discard the unpinned page that the replacement policy would replace next.
+ * @return True if a page was discarded, false if all pages are pinned.
+ */
+bool TinyLFUPageCache::evictPage() {
+  auto victim = selectVictim();
+  if (victim == nullptr) {
+    return false;
+  }
+  removePage(victim);
+  deleteVictim(victim);
+  counters_.recordEviction();
+  return true;
+}
+
+/**
+ * Get the list holding the pages of a region.
+ * @param region - Region.
+ * @return Reference to the list.
+ */
+RecencyList<TinyLFUPageCache::TinyLFUPage> &
+TinyLFUPageCache::listOf(Region region) {
+  switch (region) {
+  case Region::Window:
+    return window;
+  case Region::Probation:
+    return probation;
+  default:
+    return protectedPages;
+  }
+}
+
+/**
+ * Select the page to replace. If the window is full, its least recently used
+ * unpinned page is the candidate for leaving it, and the least recently used
+ * unpinned page of the main region, from probation before protected, is the
+ * main victim. The candidate moves to probation and the main victim is
+ * returned only if the candidate's estimated frequency is higher; otherwise
+ * the candidate is returned. When either is missing, the other is returned.
+ * @return Pointer to an unpinned page, or null if all pages are pinned.
+ */
+TinyLFUPageCache::TinyLFUPage *TinyLFUPageCache::selectVictim() {
+  // All pages pinned
+  if (numPinnedPages_ >= getNumPages()) {
+    return nullptr;
+  }
+  auto candidate = window.size >= maxWindowSize
+                       ? leastRecentUnpinned(window)
+                       : nullptr;
+  auto mainVictim = leastRecentUnpinned(probation);
+  if (mainVictim == nullptr) {
+    mainVictim = leastRecentUnpinned(protectedPages);
+  }
+  if (candidate == nullptr) {
+    return mainVictim != nullptr ? mainVictim : leastRecentUnpinned(window);
+  }
+  if (mainVictim == nullptr) {
+    return candidate;
+  }
+  if (sketch.frequency(candidate->pageId) >
+      sketch.frequency(mainVictim->pageId)) {
+    movePage(candidate, Region::Probation);
+    return mainVictim;
+  }
+  return candidate;
+}
+
+/**
+ * Find the least recently used unpinned page of a list. Pinned pages are
+ * rare, so the walk is short in practice.
+ * @param list - Window, probation or protected list.
+ * @return Pointer to an unpinned page, or null if all pages are pinned.
+ */
+TinyLFUPageCache::TinyLFUPage *
+TinyLFUPageCache::leastRecentUnpinned(const RecencyList<TinyLFUPage> &list) {
+  auto page = list.leastRecent;
+  while (page != nullptr && page->pinned) {
+    page = page->next;
+  }
+  return page;
+}
+
+/**
+ * Move a page to the most recently used end of another region.
+ * @param page - Pointer to a page.
+ * @param region - Destination region.
+ */
+void TinyLFUPageCache::movePage(TinyLFUPage *page, Region region) {
+  listOf(page->region).remove(page);
+  page->region = region;
+  listOf(region).pushMostRecent(page);
+}
+
+/**
+ * Move pages from the window and from the protected segment to probation
+ * until neither is over its size. This never evicts a page.
+ */
+void TinyLFUPageCache::rebalance() {
+  while (window.size > maxWindowSize) {
+    demoteLeastRecent(window);
+  }
+  while (protectedPages.size > maxProtectedSize) {
+    demoteLeastRecent(protectedPages);
+  }
+}
+
+/**
+ * Move the least recently used page of the window or the protected segment
+ * to the most recently used end of probation. The source list is named
+ * rather than looked up from the page's region: GCC 12 at -O3 hoists the
+ * size check out of `rebalance` when the loop goes through `listOf`, and
+ * then walks off the end of the list.
+ * @param list - Window or protected list, not empty.
+ */
+void TinyLFUPageCache::demoteLeastRecent(RecencyList<TinyLFUPage> &list) {
+  auto page = list.leastRecent;
+  list.remove(page);
+  page->region = Region::Probation;
+  probation.pushMostRecent(page);
+}
+
+/**
+ * Remove a page from its region and the page table, leaving it to the caller
+ * to delete.
+ * @param page - Pointer to a page.
+ */
+void TinyLFUPageCache::removePage(TinyLFUPage *page) {
+  if (page->pinned) {
+    countUnpin();
+  }
+  listOf(page->region).remove(page);
+  cachedPages.erase(page->pageId);
+}
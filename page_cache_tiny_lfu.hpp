@@ -0,0 +1,82 @@
+#ifndef PAGE_CACHE_TINY_LFU_HPP
+#define PAGE_CACHE_TINY_LFU_HPP
+
+#include "frequency_sketch.hpp"
+#include "page_cache.hpp"
+#include "page_table.hpp"
+#include "recency_list.hpp"
+
+/**
+ * W-TinyLFU replacement (Einziger, Friedman and Manes, 2017). Fetched pages
+ * enter a small LRU window. A page pushed out of the window only moves on to
+ * the main region, a segmented LRU, if a count-min sketch estimates it is
+ * fetched more often than the page it would evict there; otherwise the
+ * window page itself is evicted. A one-off scan therefore churns through the
+ * window without displacing frequently used pages. Main-region pages start
+ * on probation and are protected once fetched again. Pinned pages stay in
+ * their lists but are never chosen as victims.
+ */
+class TinyLFUPageCache final : public PageCache {
+public:
+  TinyLFUPageCache(int pageSize, int extraSize);
+
+  ~TinyLFUPageCache() override;
+
+  void setMaxNumPages(int maxNumPages) override;
+
+  [[nodiscard]] int getNumPages() const override;
+
+  Page *fetchPage(unsigned pageId, int createFlag) override;
+
+  void unpinPage(Page *page, bool discard) override;
+
+  void changePageId(Page *page, unsigned newPageId) override;
+
+  void discardPages(unsigned pageIdLimit) override;
+
+  bool evictPage() override;
+
+private:
+  enum class Region : unsigned char { Window, Probation, Protected };
+
+  struct TinyLFUPage : public Page {
+    TinyLFUPage(void *buffer, void *extra, unsigned pageId, bool pinned);
+
+    bool pinned;
+    Region region;
+    TinyLFUPage *prev;
+    TinyLFUPage *next;
+  };
+
+  RecencyList<TinyLFUPage> &listOf(Region region);
+
+  TinyLFUPage *selectVictim();
+
+  static TinyLFUPage *leastRecentUnpinned(const RecencyList<TinyLFUPage> &list);
+
+  void movePage(TinyLFUPage *page, Region region);
+
+  void rebalance();
+
+  void demoteLeastRecent(RecencyList<TinyLFUPage> &list);
+
+  void removePage(TinyLFUPage *page);
+
+  PageTable<TinyLFUPage> cachedPages;
+
+  FrequencySketch sketch;
+
+  RecencyList<TinyLFUPage> window;
+
+  RecencyList<TinyLFUPage> probation;
+
+  RecencyList<TinyLFUPage> protectedPages;
+
+  /** About 1% of the maximum number of pages, at least one. */
+  int maxWindowSize;
+
+  /** 80% of the main region. */
+  int maxProtectedSize;
+};
+
+#endif
@@ -0,0 +1,215 @@
+#include "page_cache_trace.hpp"
+
+#include <atomic>
+#include <cstring>
+
+namespace {
+
+constexpr char kMagic[8] = {'P', 'C', 'T', 'R', 'A', 'C', 'E', '1'};
+
+/** Events are written to the file in blocks of about this many bytes. */
+constexpr std::size_t kBufferSize = 1 << 16;
+
+std::atomic<TraceRecorder *> activeRecorder(nullptr);
+
+std::uint64_t zigzag(std::int64_t value) {
+  return ((std::uint64_t)value << 1) ^ (std::uint64_t)(value >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t value) {
+  return (std::int64_t)(value >> 1) ^ -(std::int64_t)(value & 1);
+}
+
+} // namespace
+
+bool TraceRecorder::start(const std::string &path) {
+  if (activeRecorder.load() != nullptr) {
+    return false;
+  }
+  auto file = std::fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  std::fwrite(kMagic, 1, sizeof(kMagic), file);
+  activeRecorder = new TraceRecorder(file);
+  return true;
+}
+
+void TraceRecorder::stop() { delete activeRecorder.exchange(nullptr); }
+
+TraceRecorder *TraceRecorder::get() {
+  return activeRecorder.load(std::memory_order_acquire);
+}
+
+TraceRecorder::TraceRecorder(std::FILE *file)
+    : file_(file), nextCacheId_(0), lastPageId_(0) {
+  buffer_.reserve(kBufferSize + 64);
+}
+
+TraceRecorder::~TraceRecorder() {
+  flush();
+  std::fclose(file_);
+}
+
+void TraceRecorder::recordCreate(const PageCache *pageCache, int pageSize,
+                                 int extraSize, bool purgeable) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  cacheIds_[pageCache] = nextCacheId_++;
+  beginEvent(TraceEvent::Type::Create, purgeable, pageCache);
+  putVarint((std::uint64_t)pageSize);
+  putVarint((std::uint64_t)extraSize);
+}
+
+void TraceRecorder::recordCachesize(const PageCache *pageCache,
+                                    int maxNumPages) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  beginEvent(TraceEvent::Type::Cachesize, 0, pageCache);
+  putVarint(zigzag(maxNumPages));
+}
+
+void TraceRecorder::recordFetch(const PageCache *pageCache, unsigned pageId,
+                                int createFlag, bool found) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  beginEvent(TraceEvent::Type::Fetch, (createFlag & 3) | (found ? 4 : 0),
+             pageCache);
+  putPageId(pageId);
+}
+
+void TraceRecorder::recordUnpin(const PageCache *pageCache, unsigned pageId,
+                                bool discard) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  beginEvent(TraceEvent::Type::Unpin, discard, pageCache);
+  putPageId(pageId);
+}
+
+void TraceRecorder::recordRekey(const PageCache *pageCache,
+                                unsigned oldPageId, unsigned newPageId) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  beginEvent(TraceEvent::Type::Rekey, 0, pageCache);
+  putPageId(oldPageId);
+  putPageId(newPageId);
+}
+
+void TraceRecorder::recordTruncate(const PageCache *pageCache,
+                                   unsigned pageIdLimit) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  beginEvent(TraceEvent::Type::Truncate, 0, pageCache);
+  putVarint(pageIdLimit);
+}
+
+void TraceRecorder::recordDestroy(const PageCache *pageCache) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  beginEvent(TraceEvent::Type::Destroy, 0, pageCache);
+  cacheIds_.erase(pageCache);
+}
+
+void TraceRecorder::recordShrink(const PageCache *pageCache) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  beginEvent(TraceEvent::Type::Shrink, 0, pageCache);
+}
+
+void TraceRecorder::beginEvent(TraceEvent::Type type, int flags,
+                               const PageCache *pageCache) {
+  if (buffer_.size() >= kBufferSize) {
+    flush();
+  }
+  buffer_.push_back((unsigned char)((unsigned)type | (unsigned)flags << 3));
+  auto iterator = cacheIds_.find(pageCache);
+  putVarint(iterator != cacheIds_.end() ? iterator->second : ~0u);
+}
+
+void TraceRecorder::putVarint(std::uint64_t value) {
+  while (value >= 0x80) {
+    buffer_.push_back((unsigned char)(value | 0x80));
+    value >>= 7;
+  }
+  buffer_.push_back((unsigned char)value);
+}
+
+void TraceRecorder::putPageId(unsigned pageId) {
+  putVarint(zigzag((std::int64_t)pageId - (std::int64_t)lastPageId_));
+  lastPageId_ = pageId;
+}
+
+void TraceRecorder::flush() {
+  std::fwrite(buffer_.data(), 1, buffer_.size(), file_);
+  buffer_.clear();
+}
+
+bool readTrace(const std::string &path, std::vector<TraceEvent> &events) {
+  auto file = std::fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  std::vector<unsigned char> data;
+  unsigned char block[kBufferSize];
+  std::size_t numRead;
+  while ((numRead = std::fread(block, 1, sizeof(block), file)) > 0) {
+    data.insert(data.end(), block, block + numRead);
+  }
+  std::fclose(file);
+  if (data.size() < sizeof(kMagic) ||
+      std::memcmp(data.data(), kMagic, sizeof(kMagic)) != 0) {
+    return false;
+  }
+
+  std::size_t position = sizeof(kMagic);
+  bool truncated = false;
+  auto getVarint = [&]() {
+    std::uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      if (position >= data.size()) {
+        truncated = true;
+        return value;
+      }
+      auto byte = data[position++];
+      value |= (std::uint64_t)(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        break;
+      }
+    }
+    return value;
+  };
+  unsigned lastPageId = 0;
+  auto getPageId = [&]() {
+    lastPageId = (unsigned)((std::int64_t)lastPageId + unzigzag(getVarint()));
+    return lastPageId;
+  };
+
+  events.clear();
+  while (position < data.size()) {
+    auto opcode = data[position++];
+    TraceEvent event{(TraceEvent::Type)(opcode & 7), 0, 0, 0, opcode >> 3};
+    event.cacheId = (unsigned)getVarint();
+    switch (event.type) {
+    case TraceEvent::Type::Create:
+      event.value = (std::int64_t)getVarint();
+      event.secondValue = (std::int64_t)getVarint();
+      break;
+    case TraceEvent::Type::Cachesize:
+      event.value = unzigzag(getVarint());
+      break;
+    case TraceEvent::Type::Fetch:
+    case TraceEvent::Type::Unpin:
+      event.value = getPageId();
+      break;
+    case TraceEvent::Type::Rekey:
+      event.value = getPageId();
+      event.secondValue = getPageId();
+      break;
+    case TraceEvent::Type::Truncate:
+      event.value = (std::int64_t)getVarint();
+      break;
+    case TraceEvent::Type::Destroy:
+    case TraceEvent::Type::Shrink:
+      break;
+    default:
+      return false;
+    }
+    if (truncated) {
+      return false;
+    }
+    events.push_back(event);
+  }
+  return true;
+}
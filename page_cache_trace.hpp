@@ -0,0 +1,141 @@
+#ifndef PAGE_CACHE_TRACE_HPP
+#define PAGE_CACHE_TRACE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class PageCache;
+
+/**
+ * One call made by SQLite on a page cache, as stored in a trace.
+ */
+struct TraceEvent {
+  enum class Type : unsigned char {
+    Create,
+    Cachesize,
+    Fetch,
+    Unpin,
+    Rekey,
+    Truncate,
+    Destroy,
+    Shrink
+  };
+
+  Type type;
+
+  /** Identifies the cache within the trace, in order of creation. */
+  unsigned cacheId;
+
+  /**
+   * Create: page size. Cachesize: maximum number of pages. Fetch, Unpin,
+   * Rekey: page ID. Truncate: page ID limit.
+   */
+  std::int64_t value;
+
+  /** Create: extra size. Rekey: new page ID. */
+  std::int64_t secondValue;
+
+  /**
+   * Create: purgeable. Fetch: create flag, plus 4 if a page was returned.
+   * Unpin: discard.
+   */
+  int flags;
+};
+
+/**
+ * Records the calls `PageCacheMethods` receives to a compact binary trace for
+ * offline replay with `page_cache_replay`. Events are buffered and written in
+ * large blocks. Each event is an opcode byte holding the event type and its
+ * flags, followed by LEB128 varints: the cache ID, then the event's values.
+ * Page IDs are stored as zigzag-encoded deltas from the previous page ID in
+ * the trace, so the mostly sequential and repeated page IDs of a database
+ * take one or two bytes each. The `record` functions take the recorder's own
+ * lock, so events of different caches interleave whole. The events of a cache
+ * are in the order the cache served them only if its calls are serialized, as
+ * SQLite serializes the calls on each cache, or as the page pool's lock does.
+ * `ShardedPageCache` takes no cache-wide lock, so calls made on it from
+ * several threads at once may be recorded in another order than its shards
+ * served them, and a replay of such a trace is approximate.
+ */
+class TraceRecorder {
+public:
+  /**
+   * Start recording every page cache call to a file. Must be called before
+   * `sqlite3_initialize` or while no page cache exists, like `sqlite3_config`.
+   * @param path Path of the trace file. Overwritten if it exists.
+   * @return False if the file cannot be opened or a recording is running.
+   */
+  static bool start(const std::string &path);
+
+  /**
+   * Flush and close the trace. Called by `PageCacheMethods::xShutdown`.
+   */
+  static void stop();
+
+  /**
+   * Get the running recorder.
+   * @return Pointer to the recorder, or null if no recording is running.
+   */
+  static TraceRecorder *get();
+
+  TraceRecorder(const TraceRecorder &) = delete;
+  TraceRecorder &operator=(const TraceRecorder &) = delete;
+
+  ~TraceRecorder();
+
+  void recordCreate(const PageCache *pageCache, int pageSize, int extraSize,
+                    bool purgeable);
+
+  void recordCachesize(const PageCache *pageCache, int maxNumPages);
+
+  void recordFetch(const PageCache *pageCache, unsigned pageId, int createFlag,
+                   bool found);
+
+  void recordUnpin(const PageCache *pageCache, unsigned pageId, bool discard);
+
+  void recordRekey(const PageCache *pageCache, unsigned oldPageId,
+                   unsigned newPageId);
+
+  void recordTruncate(const PageCache *pageCache, unsigned pageIdLimit);
+
+  void recordDestroy(const PageCache *pageCache);
+
+  void recordShrink(const PageCache *pageCache);
+
+private:
+  explicit TraceRecorder(std::FILE *file);
+
+  void beginEvent(TraceEvent::Type type, int flags, const PageCache *pageCache);
+
+  void putVarint(std::uint64_t value);
+
+  void putPageId(unsigned pageId);
+
+  void flush();
+
+  std::mutex mutex_;
+
+  std::FILE *file_;
+
+  std::vector<unsigned char> buffer_;
+
+  std::unordered_map<const PageCache *, unsigned> cacheIds_;
+
+  unsigned nextCacheId_;
+
+  unsigned lastPageId_;
+};
+
+/**
+ * Read every event of a trace written by `TraceRecorder`.
+ * @param path Path of the trace file.
+ * @param events Receives the events in recording order.
+ * @return False if the file cannot be read or is not a complete trace.
+ */
+bool readTrace(const std::string &path, std::vector<TraceEvent> &events);
+
+#endif
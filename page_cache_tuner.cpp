@@ -0,0 +1,175 @@
+#include "page_cache_tuner.hpp"
+#include "page_cache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+#include <unistd.h>
+
+namespace {
+
+/** Fetches between two decisions while autotuning is disabled. */
+constexpr unsigned kDefaultNumFetchesPerDecision = 4096;
+
+/** Ratio between two capacities tried while searching the curve. */
+constexpr double kKneeSearchFactor = 1.0442737824274138; // 2^(1/16)
+
+std::mutex tuningMutex;
+
+PageCacheTuning tuning;
+
+std::atomic<bool> tuningEnabled(false);
+
+/**
+ * Read the resident set size of the process.
+ * @return Size in bytes, or zero if it cannot be read.
+ */
+std::size_t getProcessRss() {
+  auto file = std::fopen("/proc/self/statm", "r");
+  if (file == nullptr) {
+    return 0;
+  }
+  unsigned long numVirtualPages = 0;
+  unsigned long numResidentPages = 0;
+  auto numRead =
+      std::fscanf(file, "%lu %lu", &numVirtualPages, &numResidentPages);
+  std::fclose(file);
+  if (numRead != 2) {
+    return 0;
+  }
+  return (std::size_t)numResidentPages * (std::size_t)sysconf(_SC_PAGESIZE);
+}
+
+} // namespace
+
+void PageCacheTuner::enable(const PageCacheTuning &newTuning) {
+  std::lock_guard<std::mutex> lock(tuningMutex);
+  tuning = newTuning;
+  tuningEnabled = true;
+}
+
+void PageCacheTuner::disable() { tuningEnabled = false; }
+
+bool PageCacheTuner::isEnabled() { return tuningEnabled; }
+
+PageCacheTuner::PageCacheTuner()
+    : requestedMaxNumPages_(0), maxNumPages_(0), targetMaxNumPages_(0),
+      numPagesPerShrinkStep_(1),
+      numFetchesUntilDecision_(kDefaultNumFetchesPerDecision) {}
+
+void PageCacheTuner::setRequestedMaxNumPages(PageCache &pageCache,
+                                             int maxNumPages) {
+  requestedMaxNumPages_ = maxNumPages;
+  maxNumPages_ = maxNumPages;
+  targetMaxNumPages_ = maxNumPages;
+  pageCache.setMaxNumPages(maxNumPages);
+}
+
+int PageCacheTuner::getTargetMaxNumPages() const { return targetMaxNumPages_; }
+
+void PageCacheTuner::decide(PageCache &pageCache) {
+  if (!tuningEnabled) {
+    numFetchesUntilDecision_ = kDefaultNumFetchesPerDecision;
+    return;
+  }
+  PageCacheTuning settings;
+  {
+    std::lock_guard<std::mutex> lock(tuningMutex);
+    settings = tuning;
+  }
+  numFetchesUntilDecision_ = std::max(settings.numFetchesPerDecision, 1u);
+  numPagesPerShrinkStep_ = std::max(settings.numPagesPerShrinkStep, 1);
+  if (requestedMaxNumPages_ <= 0) {
+    return;
+  }
+  auto minMaxNumPages =
+      std::max((int)(settings.minScale * requestedMaxNumPages_), 1);
+  auto maxMaxNumPages = std::max(
+      (int)(settings.maxScale * requestedMaxNumPages_), minMaxNumPages);
+  auto statistics = pageCache.getStatistics();
+  auto numBytesPerSlot = std::max(pageCache.getNumBytesPerSlot(),
+                                  (std::size_t)1);
+  auto numCacheBytes = (std::size_t)pageCache.getNumPages() * numBytesPerSlot;
+  std::size_t numBytes;
+  if (settings.budgetIsProcessRss) {
+    numBytes = getProcessRss();
+  }
+  else if (auto pagePool = pageCache.getPagePool()) {
+    numBytes = pagePool->getNumBytes();
+  }
+  else {
+    numBytes = numCacheBytes;
+  }
+  // Every cache of the page pool compares the same total with the budget, so
+  // each takes the part of the excess or of the spare memory in proportion to
+  // the memory of its own pages, and together they shed or fill it once.
+  double share = 1;
+  if (auto pagePool = pageCache.getPagePool()) {
+    auto numPoolBytes = pagePool->getNumBytes();
+    if (numPoolBytes > numCacheBytes) {
+      share = (double)numCacheBytes / (double)numPoolBytes;
+    }
+  }
+  auto target = std::clamp(targetMaxNumPages_, minMaxNumPages, maxMaxNumPages);
+  auto budget = settings.memoryBudget;
+  const auto &reuseDistances = statistics.reuseDistances;
+  if (budget != 0 && numBytes > budget) {
+    auto numExcessPages = (int)std::min(
+        std::ceil((double)(numBytes - budget) * share /
+                  (double)numBytesPerSlot),
+        (double)target);
+    target -= std::clamp(numExcessPages, 1, std::max(target / 4, 1));
+  }
+  else if (reuseDistances.numAccesses <
+           (unsigned long long)numFetchesUntilDecision_ *
+               ReuseDistanceHistogram::kAccessWeight) {
+    // Too few fetches sampled to read the curve, so settle on the cache size
+    // SQLite set if it fits
+    if (target < requestedMaxNumPages_ &&
+        (budget == 0 ||
+         (double)(requestedMaxNumPages_ - target) * (double)numBytesPerSlot <=
+             (double)(budget - numBytes) * share)) {
+      target = std::min(requestedMaxNumPages_, maxMaxNumPages);
+    }
+  }
+  else {
+    // Largest capacity within the budget, counting the pages the cache does
+    // not have yet
+    auto largest = maxMaxNumPages;
+    if (budget != 0) {
+      auto numSparePages = (std::size_t)((double)(budget - numBytes) * share /
+                                         (double)numBytesPerSlot);
+      auto numPages = (std::size_t)pageCache.getNumPages();
+      largest = (int)std::min((std::size_t)largest, numPages + numSparePages);
+      largest = std::max(largest, minMaxNumPages);
+    }
+    // Smallest capacity, in steps of a sixteenth of an octave, whose hit
+    // ratio is close enough to that of the largest
+    auto bestHitRatio = reuseDistances.estimateHitRatio(largest);
+    auto knee = largest;
+    for (double numPages = minMaxNumPages; numPages < largest;
+         numPages *= kKneeSearchFactor) {
+      if (bestHitRatio - reuseDistances.estimateHitRatio(numPages) <
+          settings.minHitRatioGain) {
+        knee = (int)numPages;
+        break;
+      }
+    }
+    if (knee > target + target / 8 || knee < target - target / 8) {
+      target = knee;
+    }
+  }
+  targetMaxNumPages_ = std::max(target, minMaxNumPages);
+  if (targetMaxNumPages_ > maxNumPages_) {
+    maxNumPages_ = targetMaxNumPages_;
+    pageCache.setMaxNumPages(maxNumPages_);
+  }
+}
+
+void PageCacheTuner::shrink(PageCache &pageCache) {
+  maxNumPages_ =
+      std::max(maxNumPages_ - numPagesPerShrinkStep_, targetMaxNumPages_);
+  pageCache.setMaxNumPages(maxNumPages_);
+}
@@ -0,0 +1,141 @@
+#ifndef PAGE_CACHE_TUNER_HPP
+#define PAGE_CACHE_TUNER_HPP
+
+#include <cstddef>
+
+class PageCache;
+
+/**
+ * Settings of the capacity autotuning of `PageCacheTuner`.
+ */
+struct PageCacheTuning {
+  /** Smallest capacity, relative to the cache size SQLite set. */
+  double minScale = 0.25;
+
+  /** Largest capacity, relative to the cache size SQLite set. */
+  double maxScale = 4;
+
+  /**
+   * Memory to stay within, in bytes, or zero for no budget. The caches of the
+   * page pool share it, each in proportion to the memory of its pages.
+   */
+  std::size_t memoryBudget = 0;
+
+  /**
+   * Compare the budget with the resident set size of the process rather than
+   * with the memory of the pages. Only supported on Linux.
+   */
+  bool budgetIsProcessRss = false;
+
+  /**
+   * Smallest rise in the estimated hit ratio worth the memory of more pages.
+   * The tuner picks the smallest capacity whose hit ratio is within this of
+   * the largest capacity allowed.
+   */
+  double minHitRatioGain = 0.01;
+
+  /** Fetches of a cache between two decisions. */
+  unsigned numFetchesPerDecision = 4096;
+
+  /** Largest number of pages a fetch lowers the capacity by while shrinking. */
+  int numPagesPerShrinkStep = 16;
+};
+
+/**
+ * Tunes the capacity of a cache between bounds around the cache size SQLite
+ * set, when autotuning is enabled. Every `numFetchesPerDecision` fetches, the
+ * tuner compares the memory in use with the budget. The cache owns the part of
+ * the excess or of the spare memory in proportion to its share of the memory
+ * of the page pool. Over budget, it shrinks the capacity by its part of the
+ * pages over budget, at most a quarter at a time. Within budget, it reads the
+ * cache's miss ratio curve up to the largest capacity that its part of the
+ * spare memory allows, and moves to the smallest capacity past which the
+ * hit ratio rises by less than `minHitRatioGain`, unless that is within an
+ * eighth of the current one. Growing takes effect at once. Shrinking lowers
+ * the capacity by `numPagesPerShrinkStep` pages per fetch, so that evictions
+ * are spread over many fetches rather than stalling one.
+ *
+ * The miss ratio curve needs `PAGE_CACHE_STATISTICS`. Without it, the tuner
+ * only shrinks under memory pressure, and grows back to the cache size SQLite
+ * set once within budget.
+ *
+ * The tuner is updated under the lock that serializes the calls on its cache.
+ * A cache that synchronizes itself, like `ShardedPageCache`, has no such lock
+ * and is not tuned: it keeps the cache size SQLite set.
+ */
+class PageCacheTuner {
+public:
+  /**
+   * Enable autotuning for every cache created through `PageCacheMethods`.
+   * Caches pick up new settings at their next decision.
+   * @param tuning Settings.
+   */
+  static void enable(const PageCacheTuning &tuning);
+
+  /**
+   * Disable autotuning. Caches finish shrinking to the capacity they were
+   * moving to, and keep it until SQLite sets their cache size again.
+   */
+  static void disable();
+
+  /**
+   * Whether autotuning is enabled.
+   * @return True if enabled.
+   */
+  static bool isEnabled();
+
+  PageCacheTuner();
+
+  PageCacheTuner(const PageCacheTuner &) = delete;
+  PageCacheTuner &operator=(const PageCacheTuner &) = delete;
+
+  /**
+   * Apply the cache size SQLite set. The capacity of the cache is set to it,
+   * and autotuning starts over from it.
+   * @param pageCache Cache of the tuner.
+   * @param maxNumPages Maximum number of pages.
+   */
+  void setRequestedMaxNumPages(PageCache &pageCache, int maxNumPages);
+
+  /**
+   * Count a fetch, taking a decision or a shrink step if one is due.
+   * @param pageCache Cache of the tuner.
+   */
+  void recordFetch(PageCache &pageCache) {
+    if (--numFetchesUntilDecision_ == 0) {
+      decide(pageCache);
+    }
+    else if (maxNumPages_ > targetMaxNumPages_) {
+      shrink(pageCache);
+    }
+  }
+
+  /**
+   * Get the capacity the tuner is moving the cache to.
+   * @return Maximum number of pages.
+   */
+  [[nodiscard]] int getTargetMaxNumPages() const;
+
+private:
+  /** Choose a new target capacity, growing to it at once if it is larger. */
+  void decide(PageCache &pageCache);
+
+  /** Lower the capacity by a step towards the target. */
+  void shrink(PageCache &pageCache);
+
+  /** Cache size SQLite set. */
+  int requestedMaxNumPages_;
+
+  /** Capacity the cache currently has. */
+  int maxNumPages_;
+
+  /** Capacity the cache is moving to. */
+  int targetMaxNumPages_;
+
+  /** Largest number of pages a fetch lowers the capacity by. */
+  int numPagesPerShrinkStep_;
+
+  unsigned numFetchesUntilDecision_;
+};
+
+#endif
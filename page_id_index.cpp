@@ -0,0 +1,129 @@
+#include "page_id_index.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+constexpr unsigned kBlockBits = 12;
+
+/** Index of the lowest set bit of a non-zero word. */
+unsigned lowestBit(std::uint64_t word) {
+  return (unsigned)__builtin_ctzll(word);
+}
+
+/** Mask of the bits at positions greater than or equal to `bit`. */
+std::uint64_t bitsFrom(unsigned bit) {
+  return bit < 64 ? ~std::uint64_t(0) << bit : 0;
+}
+
+} // namespace
+
+PageIdIndex::PageIdIndex() = default;
+
+PageIdIndex::~PageIdIndex() = default;
+
+void PageIdIndex::insert(unsigned pageId) {
+  auto blockIndex = pageId >> kBlockBits;
+  if (blockIndex >= blocks_.size()) {
+    blocks_.resize(blockIndex + 1);
+    blockSummary_.resize(blockIndex / 64 + 1);
+  }
+  auto &block = blocks_[blockIndex];
+  if (block == nullptr) {
+    if (!freeBlocks_.empty()) {
+      block = std::move(freeBlocks_.back());
+      freeBlocks_.pop_back();
+    }
+    else {
+      block.reset(new Block());
+    }
+    blockSummary_[blockIndex / 64] |= std::uint64_t(1) << (blockIndex % 64);
+  }
+  auto word = (pageId >> 6) & 63;
+  block->words[word] |= std::uint64_t(1) << (pageId & 63);
+  block->summary |= std::uint64_t(1) << word;
+}
+
+void PageIdIndex::erase(unsigned pageId) {
+  auto blockIndex = pageId >> kBlockBits;
+  if (blockIndex >= blocks_.size() || blocks_[blockIndex] == nullptr) {
+    return;
+  }
+  auto &block = blocks_[blockIndex];
+  auto word = (pageId >> 6) & 63;
+  block->words[word] &= ~(std::uint64_t(1) << (pageId & 63));
+  if (block->words[word] != 0) {
+    return;
+  }
+  block->summary &= ~(std::uint64_t(1) << word);
+  if (block->summary == 0) {
+    releaseBlock(blockIndex);
+  }
+}
+
+bool PageIdIndex::findFirstAtLeast(unsigned pageIdLimit,
+                                   unsigned &pageId) const {
+  std::size_t blockIndex = pageIdLimit >> kBlockBits;
+  if (blockIndex >= blocks_.size()) {
+    return false;
+  }
+  // Rest of the block holding `pageIdLimit`
+  if (const auto *block = blocks_[blockIndex].get()) {
+    auto word = (pageIdLimit >> 6) & 63;
+    auto bits = block->words[word] & bitsFrom(pageIdLimit & 63);
+    if (bits == 0) {
+      auto words = block->summary & bitsFrom(word + 1);
+      if (words != 0) {
+        word = lowestBit(words);
+        bits = block->words[word];
+      }
+    }
+    if (bits != 0) {
+      pageId = (unsigned)(blockIndex << kBlockBits) | (word << 6) |
+               lowestBit(bits);
+      return true;
+    }
+  }
+  // First non-empty block after it
+  ++blockIndex;
+  for (auto summaryWord = blockIndex / 64; summaryWord < blockSummary_.size();
+       ++summaryWord) {
+    auto blockBits = blockSummary_[summaryWord];
+    if (summaryWord == blockIndex / 64) {
+      blockBits &= bitsFrom(blockIndex % 64);
+    }
+    if (blockBits != 0) {
+      auto found = summaryWord * 64 + lowestBit(blockBits);
+      const auto *block = blocks_[found].get();
+      auto word = lowestBit(block->summary);
+      pageId = (unsigned)(found << kBlockBits) | (word << 6) |
+               lowestBit(block->words[word]);
+      return true;
+    }
+  }
+  return false;
+}
+
+void PageIdIndex::clear() {
+  for (auto &block : blocks_) {
+    if (block != nullptr) {
+      std::fill(std::begin(block->words), std::end(block->words), 0);
+      block->summary = 0;
+      freeBlocks_.push_back(std::move(block));
+    }
+  }
+  blocks_.clear();
+  blockSummary_.clear();
+}
+
+void PageIdIndex::releaseBlock(std::size_t blockIndex) {
+  freeBlocks_.push_back(std::move(blocks_[blockIndex]));
+  blockSummary_[blockIndex / 64] &= ~(std::uint64_t(1) << (blockIndex % 64));
+  // Keep the table of blocks as long as the largest page ID needs, keeping
+  // its capacity
+  while (!blocks_.empty() && blocks_.back() == nullptr) {
+    blocks_.pop_back();
+  }
+  blockSummary_.resize((blocks_.size() + 63) / 64);
+}
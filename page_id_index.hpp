@@ -0,0 +1,74 @@
+#ifndef PAGE_ID_INDEX_HPP
+#define PAGE_ID_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * Ordered set of page IDs, kept as bitmaps over blocks of 4096 consecutive
+ * page IDs. Each block has a summary word marking its non-empty words, and
+ * one bit per block marks the non-empty blocks, so finding the next page ID
+ * in the set skips empty ranges a word at a time. A block that empties goes
+ * to a pool and is reused for the next range that needs one, so the set only
+ * allocates when more blocks are in use at once than ever before, or when a
+ * page ID is larger than any it held so far. The table of blocks takes a
+ * pointer per 4096 page IDs up to the largest page ID in the set. SQLite
+ * numbers pages from one up to the size of the database file, so the blocks
+ * stay dense.
+ */
+class PageIdIndex {
+public:
+  PageIdIndex();
+
+  PageIdIndex(const PageIdIndex &) = delete;
+  PageIdIndex &operator=(const PageIdIndex &) = delete;
+
+  ~PageIdIndex();
+
+  /**
+   * Add a page ID to the set.
+   * @param pageId Page ID.
+   */
+  void insert(unsigned pageId);
+
+  /**
+   * Remove a page ID from the set, if it is there.
+   * @param pageId Page ID.
+   */
+  void erase(unsigned pageId);
+
+  /**
+   * Find the smallest page ID in the set that is greater than or equal to
+   * `pageIdLimit`.
+   * @param pageIdLimit Page ID limit.
+   * @param pageId Set to the page ID found.
+   * @return True if a page ID was found.
+   */
+  bool findFirstAtLeast(unsigned pageIdLimit, unsigned &pageId) const;
+
+  /**
+   * Remove every page ID from the set. The blocks are kept for reuse.
+   */
+  void clear();
+
+private:
+  struct Block {
+    std::uint64_t summary;
+    std::uint64_t words[64];
+  };
+
+  /** Move an empty block to the pool, and drop trailing null entries. */
+  void releaseBlock(std::size_t blockIndex);
+
+  std::vector<std::unique_ptr<Block>> blocks_;
+
+  /** One bit per entry of `blocks_`, set if the block is allocated. */
+  std::vector<std::uint64_t> blockSummary_;
+
+  /** Empty blocks, to reuse before allocating. */
+  std::vector<std::unique_ptr<Block>> freeBlocks_;
+};
+
+#endif
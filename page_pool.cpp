@@ -0,0 +1,225 @@
+#include "page_pool.hpp"
+#include "page_allocator.hpp"
+#include "page_cache.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+namespace {
+
+/** Most evictions the eviction worker makes before letting go of the lock. */
+constexpr int kEvictionBatchSize = 16;
+
+std::unique_ptr<PagePool> pagePool;
+
+std::atomic<std::size_t> memoryLimit(0);
+
+std::atomic<int> evictionReserve(0);
+
+} // namespace
+
+void PagePool::initialize() {
+  if (pagePool == nullptr) {
+    pagePool.reset(new PagePool());
+    pagePool->startEvictionWorker();
+  }
+}
+
+void PagePool::shutdown() { pagePool.reset(); }
+
+PagePool *PagePool::get() { return pagePool.get(); }
+
+void PagePool::setMemoryLimit(std::size_t limit) { memoryLimit = limit; }
+
+std::size_t PagePool::getMemoryLimit() { return memoryLimit; }
+
+void PagePool::setEvictionReserve(int numPages) {
+  evictionReserve = std::max(numPages, 0);
+  if (pagePool != nullptr) {
+    pagePool->startEvictionWorker();
+  }
+}
+
+int PagePool::getEvictionReserve() { return evictionReserve; }
+
+PagePool::PagePool()
+    : clock_(0), numBytes_(0), maxSlotSize_(0), evictionWorkerWaiting_(false),
+      stopEvictionWorker_(false) {}
+
+PagePool::~PagePool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopEvictionWorker_ = true;
+  }
+  evictionWakeup_.notify_one();
+  if (evictionWorker_.joinable()) {
+    evictionWorker_.join();
+  }
+}
+
+void PagePool::attach(PageCache *pageCache) {
+  if (!pageCache->canJoinPagePool()) {
+    return;
+  }
+  auto &pageAllocator = pageAllocators_[std::make_tuple(
+      pageCache->pageSize_, pageCache->extraSize_, pageCache->pageObjectSize_)];
+  if (pageAllocator == nullptr) {
+    pageAllocator.reset(new PageAllocator(pageCache->pageSize_,
+                                          pageCache->extraSize_,
+                                          pageCache->pageObjectSize_));
+    maxSlotSize_ = std::max(maxSlotSize_, pageAllocator->getSlotSize());
+  }
+  pageCache->pageAllocator_ = pageAllocator.get();
+  pageCache->pagePool_ = this;
+  pageCache->lastPoolUse_ = ++clock_;
+  pageCaches_.push_back(pageCache);
+}
+
+void PagePool::detach(PageCache *pageCache) {
+  auto iterator = std::find(pageCaches_.begin(), pageCaches_.end(), pageCache);
+  if (iterator != pageCaches_.end()) {
+    *iterator = pageCaches_.back();
+    pageCaches_.pop_back();
+  }
+  pageCache->pagePool_ = nullptr;
+}
+
+void PagePool::touch(PageCache *pageCache) {
+  pageCache->lastPoolUse_ = ++clock_;
+  if (evictionWorkerWaiting_) {
+    int reserve = evictionReserve;
+    if (reserve != 0 &&
+        (isReserveShort(pageCache, reserve) || isPoolReserveShort(reserve))) {
+      evictionWorkerWaiting_ = false;
+      evictionWakeup_.notify_one();
+    }
+  }
+}
+
+bool PagePool::reservePage(PageCache *pageCache, bool exceedLimit) {
+  auto slotSize = pageCache->pageAllocator_->getSlotSize();
+  std::size_t limit = memoryLimit;
+  while (limit != 0 && numBytes_ + slotSize > limit) {
+    if (!evictIdlePage()) {
+      if (!exceedLimit) {
+        return false;
+      }
+      break;
+    }
+  }
+  numBytes_ += slotSize;
+  return true;
+}
+
+void PagePool::releasePage(PageCache *pageCache) {
+  numBytes_ -= pageCache->pageAllocator_->getSlotSize();
+}
+
+std::size_t PagePool::getNumBytes() const { return numBytes_; }
+
+std::mutex &PagePool::getMutex() { return mutex_; }
+
+PageCache *PagePool::evictIdlePage() {
+  // Every cache has a distinct last use, so the caches can be tried in order
+  // of last use without sorting them.
+  unsigned long long triedUpTo = 0;
+  while (true) {
+    PageCache *idlest = nullptr;
+    for (auto pageCache : pageCaches_) {
+      if (pageCache->lastPoolUse_ > triedUpTo &&
+          (idlest == nullptr ||
+           pageCache->lastPoolUse_ < idlest->lastPoolUse_)) {
+        idlest = pageCache;
+      }
+    }
+    if (idlest == nullptr) {
+      return nullptr;
+    }
+    if (idlest->evictPage()) {
+      return idlest;
+    }
+    triedUpTo = idlest->lastPoolUse_;
+  }
+}
+
+void PagePool::startEvictionWorker() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (evictionReserve == 0) {
+    return;
+  }
+  if (!evictionWorker_.joinable()) {
+    evictionWorker_ = std::thread([this] { runEvictionWorker(); });
+  }
+  else if (evictionWorkerWaiting_) {
+    evictionWorkerWaiting_ = false;
+    evictionWakeup_.notify_one();
+  }
+}
+
+void PagePool::runEvictionWorker() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopEvictionWorker_) {
+    int numEvictions = 0;
+    while (numEvictions < kEvictionBatchSize && evictForReserve()) {
+      ++numEvictions;
+    }
+    if (numEvictions != 0) {
+      // Let the threads of the caches in between batches
+      lock.unlock();
+      std::this_thread::yield();
+      lock.lock();
+    }
+    else {
+      // Every call on a cache touches the pool, which wakes the worker once
+      // a reserve runs short, so there is nothing to check until then
+      evictionWorkerWaiting_ = true;
+      evictionWakeup_.wait(lock);
+      evictionWorkerWaiting_ = false;
+    }
+  }
+}
+
+bool PagePool::evictForReserve() {
+  int reserve = evictionReserve;
+  if (reserve == 0) {
+    return false;
+  }
+  for (auto pageCache : pageCaches_) {
+    if (isReserveShort(pageCache, reserve) && pageCache->evictPage()) {
+      pageCache->getCounters().recordBackgroundEviction();
+      return true;
+    }
+  }
+  if (isPoolReserveShort(reserve)) {
+    if (auto pageCache = evictIdlePage()) {
+      pageCache->getCounters().recordBackgroundEviction();
+      return true;
+    }
+  }
+  return false;
+}
+
+bool PagePool::isReserveShort(PageCache *pageCache, int reserve) const {
+  auto maxNumPages = pageCache->maxNumPages_;
+  return pageCache->getNumPages() >
+         maxNumPages - std::min(reserve, maxNumPages / 4);
+}
+
+bool PagePool::isPoolReserveShort(int reserve) const {
+  std::size_t limit = memoryLimit;
+  return limit != 0 && numBytes_ + (std::size_t)reserve * maxSlotSize_ > limit;
+}
+
+PagePoolLock::PagePoolLock(PageCache *pageCache)
+    : pagePool_(pageCache->getPagePool()) {
+  if (pagePool_ != nullptr) {
+    pagePool_->getMutex().lock();
+    pagePool_->touch(pageCache);
+  }
+}
+
+PagePoolLock::~PagePoolLock() {
+  if (pagePool_ != nullptr) {
+    pagePool_->getMutex().unlock();
+  }
+}
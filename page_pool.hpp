@@ -0,0 +1,227 @@
+#ifndef PAGE_POOL_HPP
+#define PAGE_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+class PageAllocator;
+class PageCache;
+
+/**
+ * Process-wide pool shared by the purgeable caches created through
+ * `PageCacheMethods`, much like the page group of SQLite's pcache1. Caches
+ * with the same page geometry allocate from one shared `PageAllocator`, so a
+ * slot freed by one cache is recycled by the others. When a memory limit is
+ * set, allocating a page that would exceed it first evicts unpinned pages from
+ * the caches that were used least recently.
+ *
+ * With an eviction reserve, a background thread evicts the least recently
+ * used unpinned pages of a cache ahead of time. It keeps the cache that many
+ * pages below its maximum, or a quarter of the maximum for small caches, and
+ * keeps the pool as many slots of the largest size below its memory limit.
+ * A miss then takes a free slot from the allocator instead of evicting on the
+ * thread of the query. Once the reserve runs dry, the cache evicts inline as
+ * it does without the worker. The worker only serves caches in the pool, so
+ * not the caches that synchronize themselves, like the sharded ones.
+ *
+ * Every call on a cache that joined the pool must hold the pool's mutex, see
+ * `PagePoolLock`. The eviction worker holds it too, for one eviction at a
+ * time, so pins and page ID changes never race with it.
+ */
+class PagePool {
+public:
+  /**
+   * Create the process-wide pool if it does not exist yet. Called by
+   * `PageCacheMethods::xInit`.
+   */
+  static void initialize();
+
+  /**
+   * Destroy the process-wide pool, stopping its eviction worker. Called by
+   * `PageCacheMethods::xShutdown`, after SQLite has destroyed every cache.
+   */
+  static void shutdown();
+
+  /**
+   * Get the process-wide pool.
+   * @return Pointer to the pool, or null if it is not initialized.
+   */
+  static PagePool *get();
+
+  /**
+   * Set the process-wide memory limit for pages in the pool. Takes effect on
+   * the next allocation.
+   * @param memoryLimit Limit in bytes, or zero for no limit.
+   */
+  static void setMemoryLimit(std::size_t memoryLimit);
+
+  /**
+   * Get the process-wide memory limit for pages in the pool.
+   * @return Limit in bytes, or zero for no limit.
+   */
+  static std::size_t getMemoryLimit();
+
+  /**
+   * Set the number of free slots the eviction worker keeps for each cache in
+   * the pool. The worker starts with the pool, or right away if the pool
+   * exists, and runs until `shutdown`. Off by default.
+   * @param numPages Number of slots, or zero to keep no reserve.
+   */
+  static void setEvictionReserve(int numPages);
+
+  /**
+   * Get the number of free slots the eviction worker keeps for each cache.
+   * @return Number of slots, or zero if there is no reserve.
+   */
+  static int getEvictionReserve();
+
+  PagePool(const PagePool &) = delete;
+  PagePool &operator=(const PagePool &) = delete;
+
+  /**
+   * Destroy the pool, stopping the eviction worker.
+   */
+  ~PagePool();
+
+  /**
+   * Make a cache allocate its pages from the pool. Must be called before the
+   * cache allocates any page. Does nothing for caches that do not support
+   * the pool.
+   * @param pageCache Pointer to a cache.
+   */
+  void attach(PageCache *pageCache);
+
+  /**
+   * Remove a cache from the pool. Called when the cache is destroyed, after
+   * all of its pages have been released.
+   * @param pageCache Pointer to a cache in the pool.
+   */
+  void detach(PageCache *pageCache);
+
+  /**
+   * Mark a cache as the most recently used one, and wake the eviction worker
+   * if the reserve of the cache or of the pool is short.
+   * @param pageCache Pointer to a cache in the pool.
+   */
+  void touch(PageCache *pageCache);
+
+  /**
+   * Account for a new page of a cache, evicting unpinned pages from the least
+   * recently used caches while the memory limit would be exceeded.
+   * @param pageCache Pointer to the cache allocating the page.
+   * @param exceedLimit Account for the page even if the limit is exceeded
+   * once no cache has an unpinned page left.
+   * @return True if the page was accounted for, false if the limit would be
+   * exceeded and no cache has an unpinned page left.
+   */
+  bool reservePage(PageCache *pageCache, bool exceedLimit);
+
+  /**
+   * Account for a page of a cache being destroyed.
+   * @param pageCache Pointer to the cache destroying the page.
+   */
+  void releasePage(PageCache *pageCache);
+
+  /**
+   * Get the number of bytes of pages currently allocated from the pool.
+   * @return Number of bytes.
+   */
+  [[nodiscard]] std::size_t getNumBytes() const;
+
+  /**
+   * Get the mutex guarding the pool and the caches in it.
+   * @return Mutex of the pool.
+   */
+  std::mutex &getMutex();
+
+private:
+  PagePool();
+
+  /**
+   * Evict one unpinned page from the least recently used cache that has one.
+   * @return Pointer to the cache the page was evicted from, or null if no
+   * cache has an unpinned page.
+   */
+  PageCache *evictIdlePage();
+
+  /**
+   * Start the eviction worker if there is a reserve and it is not running,
+   * or wake it to check the new reserve.
+   */
+  void startEvictionWorker();
+
+  /** Refill the reserves until the pool is destroyed. */
+  void runEvictionWorker();
+
+  /**
+   * Evict one page from a cache or the pool whose reserve is short.
+   * @return True if a page was evicted.
+   */
+  bool evictForReserve();
+
+  /** Whether a cache has fewer free slots below its maximum than reserved. */
+  bool isReserveShort(PageCache *pageCache, int reserve) const;
+
+  /** Whether the pool has fewer free slots below its limit than reserved. */
+  bool isPoolReserveShort(int reserve) const;
+
+  std::mutex mutex_;
+
+  /** Shared allocators, keyed by page size, extra size and page object size. */
+  std::map<std::tuple<int, int, std::size_t>, std::unique_ptr<PageAllocator>>
+      pageAllocators_;
+
+  /** Caches in the pool. */
+  std::vector<PageCache *> pageCaches_;
+
+  /** Clock ordering uses of the caches in the pool. */
+  unsigned long long clock_;
+
+  /** Number of bytes of pages allocated from the pool. */
+  std::size_t numBytes_;
+
+  /** Largest slot size of the allocators, for the reserve of the pool. */
+  std::size_t maxSlotSize_;
+
+  std::thread evictionWorker_;
+
+  /**
+   * Wakes the eviction worker when a reserve runs short or changes, or to
+   * stop it. The worker waits on it without a timeout.
+   */
+  std::condition_variable evictionWakeup_;
+
+  /** Whether the eviction worker waits for `evictionWakeup_`. */
+  bool evictionWorkerWaiting_;
+
+  bool stopEvictionWorker_;
+};
+
+/**
+ * Scoped lock on the pool of a cache. Locks nothing if the cache is not in a
+ * pool. Marks the cache as the most recently used one.
+ */
+class PagePoolLock {
+public:
+  /**
+   * Lock the pool of a cache.
+   * @param pageCache Pointer to a cache.
+   */
+  explicit PagePoolLock(PageCache *pageCache);
+
+  PagePoolLock(const PagePoolLock &) = delete;
+  PagePoolLock &operator=(const PagePoolLock &) = delete;
+
+  ~PagePoolLock();
+
+private:
+  PagePool *pagePool_;
+};
+
+#endif
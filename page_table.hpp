@@ -0,0 +1,209 @@
+#ifndef PAGE_TABLE_HPP
+#define PAGE_TABLE_HPP
+
+#include "page_id_index.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Flat open-addressing hash table from page IDs to pages. Keys are stored
+ * inline next to the page pointers and collisions are resolved by linear
+ * probing, so a lookup usually touches a single cache line. Erasing uses
+ * backward shift deletion, so no tombstones build up. The page IDs are also
+ * kept in an ordered index, so the pages at or above a page ID can be erased
+ * without scanning the whole table. Inserting or erasing only allocates when
+ * the table grows, or when the index needs more blocks than it has held so
+ * far.
+ */
+template <typename PageType> class PageTable {
+public:
+  PageTable() : entries_(kMinCapacity), mask_(kMinCapacity - 1),
+                shift_(32 - kMinCapacityBits), size_(0) {}
+
+  /**
+   * Find the page with the given page ID.
+   * @param pageId Page ID.
+   * @return Pointer to the page, or null if it is not in the table.
+   */
+  [[nodiscard]] PageType *find(unsigned pageId) const {
+    for (auto index = home(pageId);; index = (index + 1) & mask_) {
+      const auto &entry = entries_[index];
+      if (entry.page == nullptr || entry.pageId == pageId) {
+        return entry.page;
+      }
+    }
+  }
+
+  /**
+   * Insert a page. The page ID must not already be in the table.
+   * @param pageId Page ID.
+   * @param page Pointer to the page. Must not be null.
+   */
+  void insert(unsigned pageId, PageType *page) {
+    if ((size_ + 1) * 2 > entries_.size()) {
+      grow();
+    }
+    place(pageId, page);
+    index_.insert(pageId);
+    ++size_;
+  }
+
+  /**
+   * Erase the page with the given page ID, if there is one.
+   * @param pageId Page ID.
+   */
+  void erase(unsigned pageId) {
+    for (auto index = home(pageId);; index = (index + 1) & mask_) {
+      if (entries_[index].page == nullptr) {
+        return;
+      }
+      if (entries_[index].pageId == pageId) {
+        eraseAt(index);
+        return;
+      }
+    }
+  }
+
+  /**
+   * Erase every page for which `predicate(pageId, page)` returns true. The
+   * predicate may destroy the page before returning true.
+   * @param predicate Callable deciding whether to erase an entry.
+   */
+  template <typename Predicate> void eraseIf(Predicate predicate) {
+    for (std::size_t index = 0; index < entries_.size();) {
+      auto &entry = entries_[index];
+      // Backward shift may move another entry into this slot, so only advance
+      // once the slot holds an entry that is kept.
+      if (entry.page != nullptr && predicate(entry.pageId, entry.page)) {
+        eraseAt(index);
+      }
+      else {
+        ++index;
+      }
+    }
+  }
+
+  /**
+   * Erase every page whose page ID is greater than or equal to `pageIdLimit`,
+   * in increasing page ID order, calling `function(pageId, page)` after each
+   * page is erased. The function may destroy the page and may erase other
+   * pages. Takes time proportional to the number of pages erased.
+   * @param pageIdLimit Page ID limit.
+   * @param function Callable invoked for every erased entry.
+   */
+  template <typename Function>
+  void eraseFrom(unsigned pageIdLimit, Function function) {
+    unsigned pageId;
+    while (index_.findFirstAtLeast(pageIdLimit, pageId)) {
+      auto page = find(pageId);
+      erase(pageId);
+      function(pageId, page);
+      if (pageId == ~0u) {
+        break;
+      }
+      pageIdLimit = pageId + 1;
+    }
+  }
+
+  /**
+   * Call `function(pageId, page)` for every page in the table.
+   * @param function Callable invoked for every entry.
+   */
+  template <typename Function> void forEach(Function function) const {
+    for (const auto &entry : entries_) {
+      if (entry.page != nullptr) {
+        function(entry.pageId, entry.page);
+      }
+    }
+  }
+
+  /**
+   * Erase every page. The capacity is kept.
+   */
+  void clear() {
+    for (auto &entry : entries_) {
+      entry.page = nullptr;
+    }
+    index_.clear();
+    size_ = 0;
+  }
+
+  /**
+   * Get the number of pages in the table.
+   * @return Number of pages in the table.
+   */
+  [[nodiscard]] std::size_t size() const { return size_; }
+
+private:
+  struct Entry {
+    unsigned pageId;
+    PageType *page;
+  };
+
+  static constexpr unsigned kMinCapacityBits = 4;
+
+  static constexpr std::size_t kMinCapacity = std::size_t(1) << kMinCapacityBits;
+
+  /**
+   * Fibonacci hashing. Multiplying by 2^32 / phi spreads consecutive page IDs,
+   * which SQLite fetches a lot, evenly over the table instead of clustering.
+   */
+  [[nodiscard]] std::size_t home(unsigned pageId) const {
+    return (std::uint32_t)(pageId * 2654435769u) >> shift_;
+  }
+
+  void place(unsigned pageId, PageType *page) {
+    auto index = home(pageId);
+    while (entries_[index].page != nullptr) {
+      index = (index + 1) & mask_;
+    }
+    entries_[index] = {pageId, page};
+  }
+
+  void eraseAt(std::size_t hole) {
+    index_.erase(entries_[hole].pageId);
+    for (auto index = (hole + 1) & mask_;; index = (index + 1) & mask_) {
+      auto &entry = entries_[index];
+      if (entry.page == nullptr) {
+        break;
+      }
+      // Move the entry into the hole unless its home lies between the hole and
+      // its current slot, in which case moving it would make it unreachable.
+      auto distanceFromHome = (index - home(entry.pageId)) & mask_;
+      auto distanceFromHole = (index - hole) & mask_;
+      if (distanceFromHome >= distanceFromHole) {
+        entries_[hole] = entry;
+        hole = index;
+      }
+    }
+    entries_[hole].page = nullptr;
+    --size_;
+  }
+
+  void grow() {
+    std::vector<Entry> oldEntries(entries_.size() * 2);
+    oldEntries.swap(entries_);
+    mask_ = entries_.size() - 1;
+    --shift_;
+    for (const auto &entry : oldEntries) {
+      if (entry.page != nullptr) {
+        place(entry.pageId, entry.page);
+      }
+    }
+  }
+
+  std::vector<Entry> entries_;
+
+  std::size_t mask_;
+
+  /** 32 minus the base-2 logarithm of the capacity. */
+  unsigned shift_;
+
+  std::size_t size_;
+
+  PageIdIndex index_;
+};
+
+#endif
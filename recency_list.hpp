@@ -0,0 +1,65 @@
+#ifndef RECENCY_LIST_HPP
+#define RECENCY_LIST_HPP
+
+/**
+ * Intrusive doubly linked list ordered from least to most recently used.
+ * Nodes carry their own `prev` and `next` pointers, so linking and unlinking
+ * never allocate.
+ */
+template <typename Node> struct RecencyList {
+  /**
+   * Append a node to the most recently used end of the list.
+   * @param node Pointer to a node that is not in the list.
+   */
+  void pushMostRecent(Node *node) {
+    node->prev = mostRecent;
+    node->next = nullptr;
+    if (mostRecent != nullptr) {
+      mostRecent->next = node;
+    }
+    else {
+      leastRecent = node;
+    }
+    mostRecent = node;
+    ++size;
+  }
+
+  /**
+   * Remove a node from the list.
+   * @param node Pointer to a node that is in the list.
+   */
+  void remove(Node *node) {
+    if (node->prev != nullptr) {
+      node->prev->next = node->next;
+    }
+    else {
+      leastRecent = node->next;
+    }
+    if (node->next != nullptr) {
+      node->next->prev = node->prev;
+    }
+    else {
+      mostRecent = node->prev;
+    }
+    node->prev = nullptr;
+    node->next = nullptr;
+    --size;
+  }
+
+  /**
+   * Move a node to the most recently used end of the list.
+   * @param node Pointer to a node that is in the list.
+   */
+  void moveToMostRecent(Node *node) {
+    if (node != mostRecent) {
+      remove(node);
+      pushMostRecent(node);
+    }
+  }
+
+  Node *leastRecent = nullptr;
+  Node *mostRecent = nullptr;
+  int size = 0;
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include "victim_search.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VICTIM_SEARCH_X86 1
+#include <immintrin.h>
+#else
+#define VICTIM_SEARCH_X86 0
+#endif
+
+namespace {
+
+/** Index of the first slot at or after `start` whose stamp is `stamp`. */
+std::size_t findStamp(const std::uint32_t *stamps, std::size_t start,
+                      std::size_t numSlots, std::uint32_t stamp) {
+  while (start < numSlots && stamps[start] != stamp) {
+    ++start;
+  }
+  return start;
+}
+
+std::size_t findOldestSlotScalar(const std::uint32_t *stamps,
+                                 std::size_t numSlots) {
+  std::size_t oldest = numSlots;
+  auto oldestStamp = kPinnedStamp;
+  for (std::size_t slot = 0; slot < numSlots; ++slot) {
+    if (stamps[slot] < oldestStamp) {
+      oldestStamp = stamps[slot];
+      oldest = slot;
+    }
+  }
+  return oldest;
+}
+
+#if VICTIM_SEARCH_X86
+
+// The vector kernels take the minimum of every stamp, 32 or 16 at a time in
+// independent accumulators, then look for the first slot holding it. Stamps
+// of unpinned pages are distinct, so that slot is the only one.
+
+__attribute__((target("avx2"))) std::size_t
+findOldestSlotAvx2(const std::uint32_t *stamps, std::size_t numSlots) {
+  auto minimum0 = _mm256_set1_epi32(-1);
+  auto minimum1 = minimum0;
+  auto minimum2 = minimum0;
+  auto minimum3 = minimum0;
+  std::size_t slot = 0;
+  for (; slot + 32 <= numSlots; slot += 32) {
+    auto block = (const __m256i *)(stamps + slot);
+    minimum0 = _mm256_min_epu32(minimum0, _mm256_loadu_si256(block));
+    minimum1 = _mm256_min_epu32(minimum1, _mm256_loadu_si256(block + 1));
+    minimum2 = _mm256_min_epu32(minimum2, _mm256_loadu_si256(block + 2));
+    minimum3 = _mm256_min_epu32(minimum3, _mm256_loadu_si256(block + 3));
+  }
+  auto minimum = _mm256_min_epu32(_mm256_min_epu32(minimum0, minimum1),
+                                  _mm256_min_epu32(minimum2, minimum3));
+  auto half = _mm_min_epu32(_mm256_castsi256_si128(minimum),
+                            _mm256_extracti128_si256(minimum, 1));
+  half = _mm_min_epu32(half, _mm_shuffle_epi32(half, 0x4e));
+  half = _mm_min_epu32(half, _mm_shuffle_epi32(half, 0xb1));
+  auto oldestStamp = (std::uint32_t)_mm_cvtsi128_si32(half);
+  for (; slot < numSlots; ++slot) {
+    if (stamps[slot] < oldestStamp) {
+      oldestStamp = stamps[slot];
+    }
+  }
+  if (oldestStamp == kPinnedStamp) {
+    return numSlots;
+  }
+  auto target = _mm256_set1_epi32((int)oldestStamp);
+  for (slot = 0; slot + 8 <= numSlots; slot += 8) {
+    auto equal = _mm256_cmpeq_epi32(
+        _mm256_loadu_si256((const __m256i *)(stamps + slot)), target);
+    auto mask = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(equal));
+    if (mask != 0) {
+      return slot + (std::size_t)__builtin_ctz(mask);
+    }
+  }
+  return findStamp(stamps, slot, numSlots, oldestStamp);
+}
+
+__attribute__((target("sse4.1"))) std::size_t
+findOldestSlotSse41(const std::uint32_t *stamps, std::size_t numSlots) {
+  auto minimum0 = _mm_set1_epi32(-1);
+  auto minimum1 = minimum0;
+  auto minimum2 = minimum0;
+  auto minimum3 = minimum0;
+  std::size_t slot = 0;
+  for (; slot + 16 <= numSlots; slot += 16) {
+    auto block = (const __m128i *)(stamps + slot);
+    minimum0 = _mm_min_epu32(minimum0, _mm_loadu_si128(block));
+    minimum1 = _mm_min_epu32(minimum1, _mm_loadu_si128(block + 1));
+    minimum2 = _mm_min_epu32(minimum2, _mm_loadu_si128(block + 2));
+    minimum3 = _mm_min_epu32(minimum3, _mm_loadu_si128(block + 3));
+  }
+  auto minimum = _mm_min_epu32(_mm_min_epu32(minimum0, minimum1),
+                               _mm_min_epu32(minimum2, minimum3));
+  minimum = _mm_min_epu32(minimum, _mm_shuffle_epi32(minimum, 0x4e));
+  minimum = _mm_min_epu32(minimum, _mm_shuffle_epi32(minimum, 0xb1));
+  auto oldestStamp = (std::uint32_t)_mm_cvtsi128_si32(minimum);
+  for (; slot < numSlots; ++slot) {
+    if (stamps[slot] < oldestStamp) {
+      oldestStamp = stamps[slot];
+    }
+  }
+  if (oldestStamp == kPinnedStamp) {
+    return numSlots;
+  }
+  auto target = _mm_set1_epi32((int)oldestStamp);
+  for (slot = 0; slot + 4 <= numSlots; slot += 4) {
+    auto equal = _mm_cmpeq_epi32(
+        _mm_loadu_si128((const __m128i *)(stamps + slot)), target);
+    auto mask = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(equal));
+    if (mask != 0) {
+      return slot + (std::size_t)__builtin_ctz(mask);
+    }
+  }
+  return findStamp(stamps, slot, numSlots, oldestStamp);
+}
+
+#endif
+
+std::vector<VictimSearchImplementation> makeImplementations() {
+  std::vector<VictimSearchImplementation> implementations;
+#if VICTIM_SEARCH_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    implementations.push_back({"avx2", findOldestSlotAvx2});
+  }
+  if (__builtin_cpu_supports("sse4.1")) {
+    implementations.push_back({"sse4.1", findOldestSlotSse41});
+  }
+#endif
+  implementations.push_back({"scalar", findOldestSlotScalar});
+  return implementations;
+}
+
+const std::vector<VictimSearchImplementation> &getImplementations() {
+  static const auto implementations = makeImplementations();
+  return implementations;
+}
+
+} // namespace
+
+std::vector<VictimSearchImplementation> getVictimSearchImplementations() {
+  return getImplementations();
+}
+
+std::size_t findOldestSlot(const std::uint32_t *stamps, std::size_t numSlots) {
+  static const auto kernel = getImplementations().front().kernel;
+  return kernel(stamps, numSlots);
+}
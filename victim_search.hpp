@@ -0,0 +1,52 @@
+#ifndef VICTIM_SEARCH_HPP
+#define VICTIM_SEARCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Stamp of a slot whose page is pinned. It is larger than any other stamp,
+ * so a search for the smallest stamp skips pinned pages without a separate
+ * test.
+ */
+constexpr std::uint32_t kPinnedStamp = 0xffffffff;
+
+/**
+ * Find the slot with the smallest stamp in a dense array of stamps.
+ * @param stamps Stamps, one per slot.
+ * @param numSlots Number of slots.
+ * @return Index of the first slot with the smallest stamp, or `numSlots` if
+ * every slot is pinned.
+ */
+using VictimSearchKernel = std::size_t (*)(const std::uint32_t *stamps,
+                                           std::size_t numSlots);
+
+/**
+ * A kernel of the victim search, under the name of the instruction set it
+ * uses.
+ */
+struct VictimSearchImplementation {
+  const char *name;
+  VictimSearchKernel kernel;
+};
+
+/**
+ * Get the kernels the processor can run: AVX2 and SSE4.1 on x86 processors
+ * that have them, compiled for those instruction sets whatever the flags of
+ * the build, and a scalar loop everywhere.
+ * @return Kernels, fastest first.
+ */
+std::vector<VictimSearchImplementation> getVictimSearchImplementations();
+
+/**
+ * Find the slot with the smallest stamp with the fastest kernel the
+ * processor can run.
+ * @param stamps Stamps, one per slot.
+ * @param numSlots Number of slots.
+ * @return Index of the first slot with the smallest stamp, or `numSlots` if
+ * every slot is pinned.
+ */
+std::size_t findOldestSlot(const std::uint32_t *stamps, std::size_t numSlots);
+
+#endif
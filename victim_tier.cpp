@@ -0,0 +1,294 @@
+#include "victim_tier.hpp"
+#include "page_allocator.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+/** Shortest match worth an offset. */
+constexpr std::size_t kMinMatchLength = 4;
+
+/** Farthest match, the largest offset two bytes hold. */
+constexpr std::size_t kMaxOffset = 0xffff;
+
+constexpr int kHashBits = 12;
+
+/** Lengths up to this fit in the four bits of a token. */
+constexpr std::size_t kMaxTokenLength = 15;
+
+std::atomic<std::size_t> tierBudget(0);
+
+std::uint32_t read32(const unsigned char *bytes) {
+  std::uint32_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+unsigned hash32(std::uint32_t value) {
+  return (value * 2654435761u) >> (32 - kHashBits);
+}
+
+/**
+ * Write the part of a length that does not fit in its token.
+ * @return Position after the length, or null if it does not fit.
+ */
+unsigned char *putLength(unsigned char *out, const unsigned char *outEnd,
+                         std::size_t length) {
+  if (length < kMaxTokenLength) {
+    return out;
+  }
+  length -= kMaxTokenLength;
+  for (;;) {
+    if (out == outEnd) {
+      return nullptr;
+    }
+    if (length < 255) {
+      *out++ = (unsigned char)length;
+      return out;
+    }
+    *out++ = 255;
+    length -= 255;
+  }
+}
+
+/**
+ * Read the part of a length that does not fit in its token.
+ * @return Position after the length, or null if the input ends first.
+ */
+const unsigned char *getLength(const unsigned char *in,
+                               const unsigned char *inEnd,
+                               std::size_t &length) {
+  if (length < kMaxTokenLength) {
+    return in;
+  }
+  for (;;) {
+    if (in == inEnd) {
+      return nullptr;
+    }
+    auto byte = *in++;
+    length += byte;
+    if (byte != 255) {
+      return in;
+    }
+  }
+}
+
+/**
+ * Write a sequence: literals, then a match unless `matchLength` is zero.
+ * @return Position after the sequence, or null if it does not fit.
+ */
+unsigned char *putSequence(unsigned char *out, const unsigned char *outEnd,
+                           const unsigned char *literals,
+                           std::size_t numLiterals, std::size_t offset,
+                           std::size_t matchLength) {
+  if (out == outEnd) {
+    return nullptr;
+  }
+  auto token = out++;
+  auto matchCode = matchLength == 0 ? 0 : matchLength - kMinMatchLength;
+  *token = (unsigned char)(std::min(numLiterals, kMaxTokenLength) << 4 |
+                           std::min(matchCode, kMaxTokenLength));
+  out = putLength(out, outEnd, numLiterals);
+  if (out == nullptr || (std::size_t)(outEnd - out) < numLiterals) {
+    return nullptr;
+  }
+  std::memcpy(out, literals, numLiterals);
+  out += numLiterals;
+  if (matchLength == 0) {
+    return out;
+  }
+  if (outEnd - out < 2) {
+    return nullptr;
+  }
+  *out++ = (unsigned char)offset;
+  *out++ = (unsigned char)(offset >> 8);
+  return putLength(out, outEnd, matchCode);
+}
+
+/**
+ * Compress bytes with LZ77 in the manner of LZ4: each sequence is a token of
+ * two four-bit lengths, the literals, and a two-byte offset back to a match
+ * of at least four bytes. The last sequence has literals only. Runs of equal
+ * bytes, like the free space of a B-tree page, become one match.
+ * @return Size of the compressed bytes, or zero if they exceed `capacity`.
+ */
+std::size_t compress(const unsigned char *in, std::size_t size,
+                     unsigned char *out, std::size_t capacity) {
+  std::uint16_t positions[1 << kHashBits] = {};
+  auto outStart = out;
+  auto outEnd = out + capacity;
+  std::size_t anchor = 0;
+  std::size_t position = 0;
+  std::size_t numMisses = 0;
+  while (size >= kMinMatchLength && position <= size - kMinMatchLength) {
+    auto value = read32(in + position);
+    auto &slot = positions[hash32(value)];
+    std::size_t candidate = slot;
+    slot = (std::uint16_t)position;
+    if (candidate >= position || position - candidate > kMaxOffset ||
+        read32(in + candidate) != value) {
+      // Step faster through data that does not compress
+      position += 1 + (numMisses++ >> 5);
+      continue;
+    }
+    numMisses = 0;
+    auto matchLength = kMinMatchLength;
+    while (position + matchLength < size &&
+           in[candidate + matchLength] == in[position + matchLength]) {
+      ++matchLength;
+    }
+    out = putSequence(out, outEnd, in + anchor, position - anchor,
+                      position - candidate, matchLength);
+    if (out == nullptr) {
+      return 0;
+    }
+    position += matchLength;
+    anchor = position;
+  }
+  out = putSequence(out, outEnd, in + anchor, size - anchor, 0, 0);
+  return out == nullptr ? 0 : (std::size_t)(out - outStart);
+}
+
+/**
+ * Decompress the output of `compress`.
+ * @return True if the bytes decompress to exactly `size` bytes.
+ */
+bool decompress(const unsigned char *in, std::size_t inSize,
+                unsigned char *out, std::size_t size) {
+  auto inEnd = in + inSize;
+  auto outStart = out;
+  auto outEnd = out + size;
+  while (in < inEnd) {
+    auto token = *in++;
+    std::size_t numLiterals = token >> 4;
+    in = getLength(in, inEnd, numLiterals);
+    if (in == nullptr || (std::size_t)(inEnd - in) < numLiterals ||
+        (std::size_t)(outEnd - out) < numLiterals) {
+      return false;
+    }
+    std::memcpy(out, in, numLiterals);
+    in += numLiterals;
+    out += numLiterals;
+    if (in == inEnd) {
+      break;
+    }
+    if (inEnd - in < 2) {
+      return false;
+    }
+    std::size_t offset = in[0] | (std::size_t)in[1] << 8;
+    in += 2;
+    std::size_t matchLength = token & kMaxTokenLength;
+    in = getLength(in, inEnd, matchLength);
+    matchLength += kMinMatchLength;
+    if (in == nullptr || offset == 0 ||
+        offset > (std::size_t)(out - outStart) ||
+        (std::size_t)(outEnd - out) < matchLength) {
+      return false;
+    }
+    // Byte by byte, since a match may overlap the bytes it produces
+    for (auto match = out - offset; matchLength != 0; --matchLength) {
+      *out++ = *match++;
+    }
+  }
+  return out == outEnd;
+}
+
+} // namespace
+
+void VictimTier::enable(std::size_t budget) { tierBudget = budget; }
+
+void VictimTier::disable() { tierBudget = 0; }
+
+std::size_t VictimTier::getBudget() { return tierBudget; }
+
+VictimTier::VictimTier(int pageSize)
+    : budget_(tierBudget), paused_(false), pageSize_((std::size_t)pageSize),
+      numBytes_(0) {}
+
+VictimTier::~VictimTier() = default;
+
+bool VictimTier::keep(unsigned pageId, void *pageObject,
+                      PageAllocator &allocator) {
+  if (!isEnabled() || !allocator.canReleaseBuffers()) {
+    return false;
+  }
+  scratch_.resize(pageSize_ * 3 / 4);
+  auto buffer = (const unsigned char *)allocator.getBuffer(pageObject);
+  auto imageSize =
+      compress(buffer, pageSize_, scratch_.data(), scratch_.size());
+  if (imageSize == 0 || allocator.releaseBuffer(pageObject) == 0) {
+    return false;
+  }
+  auto entry = new Entry();
+  entry->pageId = pageId;
+  entry->pageObject = pageObject;
+  entry->image.reset(new unsigned char[imageSize]);
+  std::memcpy(entry->image.get(), scratch_.data(), imageSize);
+  entry->imageSize = imageSize;
+  entry->numBytes =
+      imageSize + allocator.getSlotSize() - pageSize_ + sizeof(Entry);
+  entries_.insert(pageId, entry);
+  evictionOrder_.pushMostRecent(entry);
+  numBytes_ += entry->numBytes;
+  while (numBytes_ > budget_) {
+    drop(evictionOrder_.leastRecent, allocator);
+  }
+  return true;
+}
+
+void *VictimTier::restore(unsigned pageId, PageAllocator &allocator) {
+  auto entry = entries_.find(pageId);
+  if (entry == nullptr) {
+    return nullptr;
+  }
+  auto pageObject = entry->pageObject;
+  if (!decompress(entry->image.get(), entry->imageSize,
+                  (unsigned char *)allocator.getBuffer(pageObject),
+                  pageSize_)) {
+    // Hand the slot out as a new page, which SQLite reads again
+    *(void **)allocator.getExtra(pageObject) = nullptr;
+  }
+  remove(entry);
+  return pageObject;
+}
+
+void VictimTier::forget(unsigned pageId, PageAllocator &allocator) {
+  if (auto entry = entries_.find(pageId)) {
+    drop(entry, allocator);
+  }
+}
+
+void VictimTier::forgetFrom(unsigned pageIdLimit, PageAllocator &allocator) {
+  entries_.eraseFrom(pageIdLimit, [&](unsigned, Entry *entry) {
+    evictionOrder_.remove(entry);
+    numBytes_ -= entry->numBytes;
+    allocator.deallocate(entry->pageObject);
+    delete entry;
+  });
+}
+
+void VictimTier::clear(PageAllocator &allocator) {
+  while (evictionOrder_.leastRecent != nullptr) {
+    drop(evictionOrder_.leastRecent, allocator);
+  }
+}
+
+int VictimTier::getNumPages() const { return evictionOrder_.size; }
+
+std::size_t VictimTier::getNumBytes() const { return numBytes_; }
+
+void VictimTier::drop(Entry *entry, PageAllocator &allocator) {
+  auto pageObject = entry->pageObject;
+  remove(entry);
+  allocator.deallocate(pageObject);
+}
+
+void VictimTier::remove(Entry *entry) {
+  entries_.erase(entry->pageId);
+  evictionOrder_.remove(entry);
+  numBytes_ -= entry->numBytes;
+  delete entry;
+}
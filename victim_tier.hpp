@@ -0,0 +1,165 @@
+#ifndef VICTIM_TIER_HPP
+#define VICTIM_TIER_HPP
+
+#include "page_table.hpp"
+#include "recency_list.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+class PageAllocator;
+
+/**
+ * Second tier of a cache, holding compressed images of the pages its policy
+ * evicted, within a budget in bytes. A page in the tier keeps its slot, with
+ * the page object and the extra space SQLite set up, while the memory of its
+ * buffer goes back to the operating system. Fetching the page again
+ * decompresses it into the same buffer and hands out the same slot, so SQLite
+ * finds the page as it left it and does not read it again. Only unpinned
+ * pages are evicted, and SQLite keeps dirty pages pinned, so the images are
+ * always clean.
+ *
+ * The tier needs page buffers that `PageAllocator` can release, which is the
+ * case for page sizes that are a multiple of the page size of the system,
+ * without huge pages. Otherwise it keeps nothing. Images larger than three
+ * quarters of a page are not kept either. When the tier is over budget, it
+ * frees the slots of its least recently evicted pages.
+ */
+class VictimTier {
+public:
+  /**
+   * Give every cache created afterwards a victim tier.
+   * @param budget Memory each cache's tier may take, in bytes: the images and
+   * the slots without their buffers.
+   */
+  static void enable(std::size_t budget);
+
+  /** Create caches without a victim tier from now on. */
+  static void disable();
+
+  /**
+   * Get the budget of the tiers of caches created now.
+   * @return Number of bytes, or zero if victim tiers are disabled.
+   */
+  static std::size_t getBudget();
+
+  /**
+   * Construct a VictimTier with the budget set by `enable`.
+   * @param pageSize Page size in bytes.
+   */
+  explicit VictimTier(int pageSize);
+
+  VictimTier(const VictimTier &) = delete;
+  VictimTier &operator=(const VictimTier &) = delete;
+
+  /**
+   * Destroy the VictimTier. Its slots must have been freed with `clear`.
+   */
+  ~VictimTier();
+
+  /**
+   * Whether the tier may keep pages.
+   * @return True if the tier has a budget and is not paused.
+   */
+  [[nodiscard]] bool isEnabled() const { return budget_ != 0 && !paused_; }
+
+  /**
+   * Stop or resume keeping pages, as while the cache empties itself.
+   * @param paused True to stop keeping pages.
+   */
+  void setPaused(bool paused) { paused_ = paused; }
+
+  /**
+   * Keep the slot of an evicted page, whose page object has been destroyed.
+   * If the page does not compress well enough or its buffer cannot be
+   * released, the tier keeps nothing.
+   * @param pageId Page ID of the page.
+   * @param pageObject Slot of the page.
+   * @param allocator Allocator of the cache.
+   * @return True if the tier took the slot, which it may free at any time,
+   * false if the caller must free it.
+   */
+  bool keep(unsigned pageId, void *pageObject, PageAllocator &allocator);
+
+  /**
+   * Take the slot of a page out of the tier, with its buffer as it was when
+   * the page was evicted.
+   * @param pageId Page ID.
+   * @param allocator Allocator of the cache.
+   * @return Slot of the page, or null if the tier does not have it.
+   */
+  void *restore(unsigned pageId, PageAllocator &allocator);
+
+  /**
+   * Free the slot of a page whose image is no longer valid, if the tier has
+   * it.
+   * @param pageId Page ID.
+   * @param allocator Allocator of the cache.
+   */
+  void forget(unsigned pageId, PageAllocator &allocator);
+
+  /**
+   * Free the slots of the pages with page IDs greater than or equal to
+   * `pageIdLimit`.
+   * @param pageIdLimit Page ID limit.
+   * @param allocator Allocator of the cache.
+   */
+  void forgetFrom(unsigned pageIdLimit, PageAllocator &allocator);
+
+  /**
+   * Free every slot of the tier.
+   * @param allocator Allocator of the cache.
+   */
+  void clear(PageAllocator &allocator);
+
+  /**
+   * Get the number of pages in the tier.
+   * @return Number of pages.
+   */
+  [[nodiscard]] int getNumPages() const;
+
+  /**
+   * Get the memory the tier takes, as counted against its budget.
+   * @return Number of bytes.
+   */
+  [[nodiscard]] std::size_t getNumBytes() const;
+
+private:
+  struct Entry {
+    unsigned pageId;
+    void *pageObject;
+    std::unique_ptr<unsigned char[]> image;
+    std::size_t imageSize;
+
+    /** Memory counted against the budget. */
+    std::size_t numBytes;
+
+    Entry *prev;
+    Entry *next;
+  };
+
+  /** Remove an entry and free its slot. */
+  void drop(Entry *entry, PageAllocator &allocator);
+
+  /** Remove an entry, leaving its slot to the caller. */
+  void remove(Entry *entry);
+
+  std::size_t budget_;
+
+  bool paused_;
+
+  std::size_t pageSize_;
+
+  std::size_t numBytes_;
+
+  PageTable<Entry> entries_;
+
+  /** Entries from the least to the most recently evicted. */
+  RecencyList<Entry> evictionOrder_;
+
+  /** Room to compress a page before its image is copied to its own size. */
+  std::vector<unsigned char> scratch_;
+};
+
+#endif